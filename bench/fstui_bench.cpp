@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ftxui/component/event.hpp"
+#include "ftxui/dom/elements.hpp"
+#include "ftxui/screen/screen.hpp"
+
+#include "BinaryPreset.hpp"
+#include "DirTree.hpp"
+#include "DirTreeBase.hpp"
+#include "PresetIO.hpp"
+#include "stringtoolbox.hpp"
+
+using namespace ftxui;
+using namespace fstui;
+namespace str = stringtoolbox;
+
+namespace {
+  struct Shape {
+    size_t entries;
+    short maxDepth;
+    size_t labels;
+  };
+
+  struct Result {
+    std::string name;
+    Shape shape;
+    size_t iterations;
+    double nsPerOp;
+    double bytesPerOp;// 0 unless the benchmark moves file data
+  };
+
+  // random walk over depths, a label set on about a third of the rows
+  PresetData Synthetic(const Shape &shape, uint32_t seed) {
+    std::mt19937 rng(seed);
+    PresetData data;
+    for (size_t l = 0; l < shape.labels; l++) data.labels.push_back("label" + std::to_string(l));
+    data.labelChecked.Reset(shape.labels, 0);
+    int depth = 0;
+    for (size_t i = 0; i < shape.entries; i++) {
+      depth = std::max(0, std::min<int>(depth + int(rng() % 3) - 1, shape.maxDepth));
+      data.entries.push_back(data.names->Add("entry_" + std::to_string(i)));
+      data.depths.push_back(depth);
+      data.labelChecked.PushRow();
+      if (shape.labels > 0 && rng() % 3 == 0) data.labelChecked.Set(i, rng() % shape.labels, true);
+    }
+    return data;
+  }
+
+  // repeats run until it took minSeconds and at least minIterations, returns the count and ns per run
+  template<typename F>
+  std::pair<size_t, double> Measure(F &&run, double minSeconds = 0.2, size_t minIterations = 3) {
+    using clock = std::chrono::steady_clock;
+    size_t iterations = 0;
+    auto start = clock::now();
+    double elapsed = 0;
+    while (iterations < minIterations || elapsed < minSeconds) {
+      run();
+      iterations++;
+      elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+    return {iterations, elapsed * 1e9 / iterations};
+  }
+
+  std::string Json(const std::vector<Result> &results) {
+    std::ostringstream out;
+    out << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+      auto &r = results[i];
+      out << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", \"entries\": " << r.shape.entries
+          << ", \"max_depth\": " << r.shape.maxDepth << ", \"labels\": " << r.shape.labels
+          << ", \"iterations\": " << r.iterations << ", \"ns_per_op\": " << r.nsPerOp;
+      if (r.bytesPerOp > 0) out << ", \"mb_per_s\": " << r.bytesPerOp / r.nsPerOp * 1e9 / (1 << 20);
+      out << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+  }
+
+  void Run(const Shape &shape, const fs::path &dir, std::vector<Result> &results) {
+    auto report = [&](const std::string &name, std::pair<size_t, double> timing, double bytes = 0) {
+      results.push_back({name, shape, timing.first, timing.second, bytes});
+      std::fprintf(stderr, "%-12s %8zu entries depth %2d labels %zu: %12.0f ns/op\n",
+                   name.c_str(), shape.entries, shape.maxDepth, shape.labels, timing.second);
+    };
+    PresetData data = Synthetic(shape, 42);
+    std::mt19937 rng(7);
+
+    // MODEL
+    DirTree tree;
+    report("assign", Measure([&] {
+             PresetData copy = data;
+             tree.Assign(std::move(copy));
+           }));
+
+    // RENDER, the visible window with its prefixes into an offscreen screen
+    int selected = 0;
+    std::vector<ConstStringRef> labels;
+    for (auto &l : data.labels) labels.push_back({l});
+    auto base = std::make_shared<DirTreeBase>(tree, selected, labels, "Directory Tree");
+    auto screen = Screen::Create(Dimension::Fixed(120), Dimension::Fixed(50));
+    report("render", Measure([&] {
+             selected = rng() % tree.Size();
+             ftxui::Render(screen, base->Render());
+           }));
+
+    // EDITS through the component, as the keys drive them.
+    // as many leaves are removed as were added, so every shape keeps its size.
+    size_t edits = std::min<size_t>(tree.Size(), 20000);
+    report("add_entry", Measure([&] {
+             selected = rng() % tree.Size();
+             base->OnEvent(Event::Return);// new child below, in edit mode
+             base->OnEvent(Event::Escape);
+           }, 0, edits));
+    report("remove_entry", Measure([&] {
+             selected = rng() % tree.Size();
+             while (tree.SubtreeEnd(selected) != size_t(selected) + 1) selected++;
+             base->OnEvent(Event::Delete);
+           }, 0, edits));
+    report("move_entry", Measure([&] {
+             selected = rng() % tree.Size();
+             base->OnEvent(Event::Character(' '));
+             base->OnEvent(rng() % 2 ? Event::ArrowDown : Event::ArrowUp);
+             base->OnEvent(Event::Character(' '));
+           }));
+
+    // PRESET I/O
+    fs::path preset = dir / ("bench_" + std::to_string(shape.entries) + ".df");
+    PresetData exported;
+    tree.Export(exported);
+    auto saving = Measure([&] { SavePreset(preset, exported); });
+    size_t dfBytes = fs::file_size(preset);
+    report("save_df", saving, dfBytes);
+    fs::path sidecar = BinaryPreset::SidecarPath(preset);
+    size_t dfbBytes = fs::file_size(sidecar);
+    report("load_dfb", Measure([&] {
+             DirTree loaded;
+             loaded.Assign(BinaryPreset::For(preset));
+           }),
+           dfbBytes);
+    fs::remove(sidecar);
+    report("load_df", Measure([&] {
+             PresetData loaded;
+             LoadPreset(preset, loaded);
+           }),
+           dfBytes);
+    fs::remove(preset);
+  }
+
+  int Usage() {
+    std::cerr << "usage: fstui_bench [--sizes N,N,..] [--depths D,D,..] [--labels L,L,..] [--out file.json]\n";
+    return 2;
+  }
+
+  std::vector<size_t> Numbers(const std::string &list) {
+    std::vector<size_t> out;
+    for (auto n : str::splitView(list, ',')) out.push_back(std::stoul(std::string(n)));
+    return out;
+  }
+}// namespace
+
+int main(int argc, const char *argv[]) {
+  std::vector<size_t> sizes{1000, 10000, 100000, 1000000};
+  std::vector<size_t> depths{4, 32};
+  std::vector<size_t> labels{0, 8};
+  std::string out;
+  try {
+    for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+      if (i + 1 >= argc) return Usage();
+      if (arg == "--sizes") sizes = Numbers(argv[++i]);
+      else if (arg == "--depths") depths = Numbers(argv[++i]);
+      else if (arg == "--labels") labels = Numbers(argv[++i]);
+      else if (arg == "--out") out = argv[++i];
+      else return Usage();
+    }
+  } catch (const std::exception &) {
+    return Usage();
+  }
+
+  fs::path dir = fs::temp_directory_path() / "fstui_bench";
+  fs::create_directories(dir);
+  std::vector<Result> results;
+  for (size_t n : sizes) {
+    for (size_t d : depths) {
+      for (size_t l : labels) Run({n, short(std::min<size_t>(d, DirTree::kMaxDepth)), l}, dir, results);
+    }
+  }
+  fs::remove_all(dir);
+
+  std::string json = Json(results);
+  if (out.empty()) {
+    std::cout << json;
+  } else {
+    std::ofstream(out) << json;
+  }
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "stringtoolbox.hpp"
+
+namespace str = stringtoolbox;
+
+namespace {
+  // a .df body as main.cpp writes it: tabs for depth, a name and a label column
+  std::string SyntheticPreset(size_t lines, size_t labels) {
+    std::mt19937 rng(42);
+    std::string out = "|";
+    for (size_t l = 0; l < labels; l++) out += "label" + std::to_string(l) + "|";
+    out += '\n';
+    int depth = 0;
+    for (size_t i = 0; i < lines; i++) {
+      depth = std::max(0, std::min(depth + int(rng() % 3) - 1, 12));
+      out.append(depth, '\t');
+      out += "entry_" + std::to_string(i) + "_" + std::string(rng() % 24, 'x');
+      out += " |";
+      for (size_t l = 0; l < labels; l++) out += rng() % 2 ? '1' : '0';
+      out += "|\n";
+    }
+    return out;
+  }
+
+  template<typename F>
+  double Best(int runs, F &&run) {
+    double best = 1e300;
+    for (int r = 0; r < runs; r++) {
+      auto start = std::chrono::steady_clock::now();
+      run();
+      best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+  }
+
+  volatile size_t sink;
+}// namespace
+
+int main(int argc, char *argv[]) {
+  size_t lines = argc > 1 ? std::stoul(argv[1]) : 1000000;
+  std::string preset = SyntheticPreset(lines, 8);
+  std::printf("%zu lines, %.1f MiB\n", lines, preset.size() / 1048576.0);
+
+  // what the loader did per line: split the file, count tabs, ltrim a copy, substr the fields
+  double copies = Best(5, [&] {
+    size_t checksum = 0;
+    for (auto &line : str::split(preset, '\n')) {
+      checksum += std::count(line.begin(), line.end(), '\t');
+      str::ltrim(line);
+      auto labelPos = line.find(" |");
+      if (labelPos != std::string::npos) checksum += line.substr(0, labelPos).size() + line.substr(labelPos + 2).size();
+    }
+    sink = checksum;
+  });
+
+  // the same through views into the buffer
+  double views = Best(5, [&] {
+    size_t checksum = 0;
+    for (auto line : str::splitView(preset, '\n')) {
+      checksum += str::countChar(line, '\t');
+      line = str::ltrimView(line);
+      auto labelPos = line.find(" |");
+      if (labelPos != std::string_view::npos) checksum += line.substr(0, labelPos).size() + line.substr(labelPos + 2).size();
+    }
+    sink = checksum;
+  });
+
+  double scalarCount = Best(5, [&] {
+    sink = str::detail::countCharScalar(preset.data(), preset.data() + preset.size(), '\t');
+  });
+  double simdCount = Best(5, [&] { sink = str::countChar(preset, '\t'); });
+
+  std::printf("tokenize  split/ltrim %8.2f ms   splitView/ltrimView %8.2f ms   %.1fx\n", copies, views, copies / views);
+  std::printf("count tab scalar      %8.2f ms   countChar           %8.2f ms   %.1fx\n", scalarCount, simdCount, scalarCount / simdCount);
+  return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef FSTUI_ARCHIVEEXPORTER_HPP
+#define FSTUI_ARCHIVEEXPORTER_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+#include "LabelActions.hpp"
+#include "TaskRunner.hpp"
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  struct ExportStats {
+    size_t nodes = 0;
+    size_t dirs = 0;
+    size_t files = 0;// seeded by label actions
+    size_t failed = 0;
+    uint64_t bytes = 0;// of the archive
+    bool cancelled = false;
+    double seconds = 0;
+    std::string firstError;
+
+    double BytesPerSecond() const { return seconds > 0 ? bytes / seconds : 0; }
+    std::wstring Summary() const;
+  };
+
+  // writes the entries/depths model as an archive instead of creating it, what extracting it gives is what
+  // materializing would: the directories, and the files and modes of their label actions.
+  // one pass over the expanded rows into a single sequential buffered writer, nothing is created on disk but
+  // the archive. templates of a MiB or more go through copy_file_range when the archive is a regular file.
+  //   TAR   POSIX ustar, with a pax header for paths that do not fit it and files past 8 GiB
+  //   CPIO  SVR4 newc, files are limited to 4 GiB
+  class ArchiveExporter {
+public:
+    enum Format { TAR,
+                  CPIO };
+
+    explicit ArchiveExporter(Format format = TAR);
+
+    // "tar" or "cpio", else from the extension of path with tar as default
+    static bool ParseFormat(std::string_view name, Format &format);
+    static Format FormatFor(const fs::path &path);
+
+    // into archive through archive.part, renamed once complete. "-" writes to stdout
+    ExportStats Run(const std::vector<std::string_view> &entries,
+                    const std::vector<short> &depths,
+                    const fs::path &archive,
+                    TaskProgress *progress = nullptr,
+                    const LabelActions *actions = nullptr);
+
+private:
+    struct Writer;
+
+    const Format format_;
+
+    void Directory(Writer &out, const std::string &path, mode_t mode) const;
+    void File(Writer &out, const std::string &path, int fd, off_t size, mode_t mode) const;
+    void Header(Writer &out, const std::string &path, mode_t type, mode_t mode, uint64_t size) const;
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef FSTUI_BATCHAPPLY_HPP
+#define FSTUI_BATCHAPPLY_HPP
+
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "PresetGraph.hpp"
+#include "Reconciler.hpp"
+#include "WorkerPool.hpp"
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  struct ApplyJob {
+    fs::path preset;
+    fs::path root;
+  };
+
+  struct BatchOptions {
+    unsigned jobs = 0; // concurrent jobs, 0 -> hardware concurrency
+    unsigned perFs = 4;// concurrent jobs on one filesystem
+    bool reconcile = false;// look before creating, see Reconciler
+    ReconcileOptions reconcileOptions;
+  };
+
+  // headless "apply": materializes many preset/root pairs without the tui.
+  // each preset is parsed and its includes resolved once, jobs are spread over cores but never exceed perFs
+  // on one device.
+  class BatchApply {
+public:
+    BatchApply(WorkerPool &pool, BatchOptions options);
+
+    // "<preset.df>\t<root>" per line, '#' comments
+    static bool ReadJobFile(const fs::path &path, std::vector<ApplyJob> &jobs, std::string &error);
+    // returns the number of failed jobs
+    size_t Run(const std::vector<ApplyJob> &jobs, std::ostream &log);
+
+private:
+    WorkerPool &pool_;
+    const BatchOptions options_;
+    PresetGraph graph_;
+  };
+}// namespace fstui
+
+#endif
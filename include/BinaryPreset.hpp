@@ -0,0 +1,64 @@
+#ifndef FSTUI_BINARYPRESET_HPP
+#define FSTUI_BINARYPRESET_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LabelStore.hpp"
+#include "PresetIO.hpp"
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  // .dfb: binary copy of a .df kept next to it, mmap'ed and read in place.
+  // an offset table into one UTF-8 name blob, a depth byte per entry and the label columns as LabelStore packs them.
+  class BinaryPreset {
+public:
+    BinaryPreset() = default;
+    ~BinaryPreset();
+    BinaryPreset(const BinaryPreset &) = delete;
+    BinaryPreset &operator=(const BinaryPreset &) = delete;
+
+    // the .dfb of a .df if it was written from the .df as it is now, else null
+    static std::shared_ptr<BinaryPreset> For(const fs::path &preset);
+    static fs::path SidecarPath(const fs::path &preset);
+    // for the .df at preset, which must be written already
+    static bool Write(const fs::path &preset,
+                      const std::vector<std::string> &labels,
+                      const std::vector<std::string_view> &entries,
+                      const std::vector<short> &depths,
+                      const LabelStore &labelChecked);
+
+    bool Open(const fs::path &file);
+    void Close();
+
+    size_t Size() const;
+    const std::vector<std::string> &Labels() const { return labels_; }
+    std::string_view Name(size_t row) const {
+      return std::string_view(names_ + offsets_[row], offsets_[row + 1] - offsets_[row]);
+    }
+    short Depth(size_t row) const { return depths_[row]; }
+    // ceil(Size() / 64) words per label
+    const uint64_t *LabelBits() const { return labelBits_; }
+    // copy, names into data's arena
+    void Read(PresetData &data) const;
+
+private:
+    struct Header;
+
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    const Header *header_ = nullptr;
+    const uint32_t *offsets_ = nullptr;
+    const char *names_ = nullptr;
+    const uint8_t *depths_ = nullptr;
+    const uint64_t *labelBits_ = nullptr;
+    std::vector<std::string> labels_;
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
@@ -0,0 +1,120 @@
+#ifndef FSTUI_COWVECTOR_HPP
+#define FSTUI_COWVECTOR_HPP
+
+#include <algorithm>// for min
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace fstui {
+
+  // vector in fixed chunks shared between copies. copying costs a pointer per chunk,
+  // a write through a copy clones only the chunk it lands in.
+  // chunks never move, so references stay valid across push_back and the writes of other elements.
+  template<typename T, size_t kChunkBits = 6>
+  class CowVector {
+public:
+    static const size_t kChunk = size_t(1) << kChunkBits;
+
+    CowVector() = default;
+    CowVector(const CowVector &other) : chunks_(other.chunks_), owned_(other.chunks_.size(), 0), size_(other.size_), clones_(other.clones_) {
+      other.Share();
+    }
+    CowVector(CowVector &&other) noexcept
+        : chunks_(std::move(other.chunks_)), owned_(std::move(other.owned_)), size_(other.size_), clones_(other.clones_) {
+      other.clear();
+    }
+    CowVector &operator=(const CowVector &other) {
+      if (this == &other) return *this;
+      chunks_ = other.chunks_;
+      owned_.assign(chunks_.size(), 0);
+      size_ = other.size_;
+      clones_ = other.clones_;
+      other.Share();
+      return *this;
+    }
+    CowVector &operator=(CowVector &&other) noexcept {
+      if (this == &other) return *this;
+      chunks_ = std::move(other.chunks_);
+      owned_ = std::move(other.owned_);
+      size_ = other.size_;
+      clones_ = other.clones_;
+      other.clear();
+      return *this;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const T &operator[](size_t i) const { return (*chunks_[i >> kChunkBits])[i & (kChunk - 1)]; }
+    T &operator[](size_t i) { return (*Own(i >> kChunkBits))[i & (kChunk - 1)]; }
+
+    const T &back() const { return (*this)[size_ - 1]; }
+    void pop_back() { size_--; }
+
+    void push_back(T value) {
+      if ((size_ & (kChunk - 1)) == 0) {
+        chunks_.push_back(std::make_shared<Chunk>());
+        owned_.push_back(1);
+      }
+      (*this)[size_++] = std::move(value);
+    }
+
+    // new elements are value-initialized, dropped ones keep their chunk until it goes
+    void resize(size_t n) {
+      size_t chunks = (n + kChunk - 1) >> kChunkBits;
+      for (size_t i = n; i < std::min(size_, chunks << kChunkBits); i++) (*this)[i] = T();
+      chunks_.resize(chunks);
+      owned_.resize(chunks, 1);
+      for (auto &chunk : chunks_) {
+        if (!chunk) chunk = std::make_shared<Chunk>();
+      }
+      size_ = n;
+    }
+
+    void assign(size_t n, const T &value) {
+      clear();
+      resize(n);
+      for (auto &chunk : chunks_) chunk->fill(value);
+    }
+
+    void clear() {
+      chunks_.clear();
+      owned_.clear();
+      size_ = 0;
+    }
+
+    size_t Chunks() const { return chunks_.size(); }
+    // chunks cloned on write so far, the memory a copy taken before them holds on its own
+    size_t Clones() const { return clones_; }
+    static constexpr size_t ChunkBytes() { return sizeof(Chunk); }
+
+private:
+    using Chunk = std::array<T, kChunk>;
+
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    // chunks known to be referenced from here only, which saves asking the shared count on every write.
+    // a copy clears them on both sides.
+    mutable std::vector<uint8_t> owned_;
+    size_t size_ = 0;
+    size_t clones_ = 0;
+
+    void Share() const { std::fill(owned_.begin(), owned_.end(), 0); }
+
+    Chunk *Own(size_t chunk) {
+      auto &p = chunks_[chunk];
+      if (!owned_[chunk]) {
+        if (p.use_count() > 1) {
+          p = std::make_shared<Chunk>(*p);
+          clones_++;
+        }
+        owned_[chunk] = 1;
+      }
+      return p.get();
+    }
+  };
+}// namespace fstui
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef FSTUI_DIRTREE_HPP
+#define FSTUI_DIRTREE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "BinaryPreset.hpp"
+#include "CowVector.hpp"
+#include "LabelStore.hpp"
+#include "NameArena.hpp"
+#include "PresetIO.hpp"
+
+namespace fstui {
+
+  // directory tree as an implicit treap over its pre-order rows.
+  // node ids stay put while a node lives, rows are found through the treap parents.
+  // a subtree is a contiguous row range, so moving, indenting or removing one is a split and a merge.
+  // storage is shared between copies chunk by chunk, a copy is a snapshot that only pays for what changes after it.
+  class DirTree {
+public:
+    using NodeId = uint32_t;
+    static const NodeId kNone = UINT32_MAX;
+    static const size_t npos = SIZE_MAX;
+    // prefix masks hold one bit per level
+    static const short kMaxDepth = 63;
+
+    DirTree();
+
+    // rows become ids 0..n-1, depths are clamped into a valid tree. the names stay in data's arena.
+    // the children of ranges stay collapsed in source until expanded.
+    void Assign(PresetData &&data,
+                std::shared_ptr<const PresetSource> source = nullptr,
+                const std::vector<PresetRange> &ranges = {});
+    // names are read from the mapped file until edited
+    void Assign(std::shared_ptr<const BinaryPreset> preset);
+    // entries, depths and labelChecked in row order, collapsed children included.
+    // entries point into the tree's names, which data keeps alive.
+    // false if collapsed children could not be read because the preset changed on disk, they are left out
+    bool Export(PresetData &data) const;
+    void Clear();
+    // heap held by the tree, roughly; mapped files not counted
+    size_t Bytes() const;
+    // what a copy costs by itself, the chunk tables
+    size_t SnapshotBytes() const;
+    // grows by what each write had to copy away from the snapshots sharing it
+    size_t CopiedBytes() const;
+
+    size_t Size() const { return Count(root_); }
+    bool Empty() const { return root_ == kNone; }
+    NodeId At(size_t row) const;
+    size_t Row(NodeId id) const;
+    short Depth(NodeId id) const;
+    short DepthAt(size_t row) const;
+    // UTF-8, valid while the tree or a copy of it lives
+    std::string_view Name(NodeId id) const;
+    void SetName(NodeId id, std::string_view name);
+
+    // LABELS, a bit column per label over node ids, shared with snapshots chunk by chunk like the nodes
+    size_t LabelCount() const { return labels_.size(); }
+    bool Label(NodeId id, size_t label) const { return labels_[label][id >> 6] >> (id & 63) & 1; }
+    void SetLabel(NodeId id, size_t label, bool value);
+    void ToggleLabel(NodeId id, size_t label);
+    // labels empty columns, dropping every label set
+    void ResetLabels(size_t labels);
+
+    // NAVIGATION, rows or npos
+    size_t SubtreeEnd(size_t row) const;
+    size_t Parent(size_t row) const;
+    size_t PrevSibling(size_t row) const;
+    size_t NextSibling(size_t row) const;
+    // whether level depth goes on below row
+    bool Continues(size_t row, short depth) const;
+    // ids and depths of rows [from, from + count)
+    void Window(size_t from, size_t count, std::vector<NodeId> &ids, std::vector<short> &depths) const;
+
+    // EDITS, O(log n) in the tree size. depths are clamped to keep the tree valid.
+    NodeId Insert(size_t row, short depth, std::string_view name = {});
+    // with descendants, freeing their ids
+    void Remove(size_t row);
+    // subtree of row in front of row before (current numbering, outside the subtree), returns its new row
+    size_t Move(size_t row, size_t before, short depth);
+    // past the previous sibling, or in front of the parent
+    size_t MoveUp(size_t row);
+    // past the next sibling, or out of the parent
+    size_t MoveDown(size_t row);
+    bool Indent(size_t row, int delta);
+
+    // COLLAPSE, collapsed children leave the rows and travel with their parent
+    bool Collapsed(NodeId id) const { return nodes_[id].hidden > 0; }
+    void Collapse(size_t row);
+    // false, leaving row collapsed, if its children are still in a preset that changed on disk
+    bool Expand(size_t row);
+
+private:
+    struct Node {
+      NodeId left, right, parent;
+      uint32_t prio, size;
+      short depth, minDepth, maxDepth;
+      short add;   // pending for the children
+      short hidden;// deepest collapsed level, relative, 0 if expanded
+    };
+
+    using StashMap = std::unordered_map<NodeId, NodeId>;
+    using LazyMap = std::unordered_map<NodeId, PresetRange>;
+
+    CowVector<Node> nodes_;
+    CowVector<std::string_view> names_;
+    // holds the bytes of names_, shared with copies and only ever added to
+    std::shared_ptr<NameArena> arena_;
+    CowVector<NodeId> free_;
+    NodeId root_;
+    // collapsed id -> treap of its children, depths relative to it
+    std::shared_ptr<StashMap> stash_;
+    // collapsed id -> its children, never loaded from source_
+    std::shared_ptr<LazyMap> lazy_;
+    std::shared_ptr<const PresetSource> source_;
+    // ids below ownName_.size() are named by their entry in binary_ until they get a name of their own,
+    // names_ only grows as far as those
+    std::shared_ptr<const BinaryPreset> binary_;
+    CowVector<bool> ownName_;
+    // words of 64 ids, as many as cover nodes_
+    std::vector<CowVector<uint64_t>> labels_;
+    uint32_t seed_;
+
+    size_t Count(NodeId x) const { return x == kNone ? 0 : nodes_[x].size; }
+    // unshared from snapshots for writing
+    StashMap &Stash();
+    LazyMap &Lazy();
+    uint32_t Random();
+    // n nodes in row order, not linked yet
+    void ResetNodes(size_t n, const std::vector<short> &depths);
+    NodeId Allocate(short depth, std::string_view name);
+    // columns of stride words each, clipped to the nodes
+    void LoadLabels(size_t labels, const uint64_t *columns, size_t stride);
+    // treap over ids in row order, linear in their count
+    NodeId Link(const std::vector<NodeId> &ids);
+    void Free(NodeId x);
+    void Pull(NodeId x);
+    void Push(NodeId x);
+    void Shift(NodeId x, int delta);
+    void Split(NodeId x, size_t k, NodeId &a, NodeId &b);
+    NodeId Merge(NodeId a, NodeId b);
+    // first row >= from / last row < before with a depth <= depth
+    size_t FirstAtMost(size_t from, short depth) const;
+    size_t LastAtMost(size_t before, short depth) const;
+    size_t FindFirst(NodeId x, size_t base, int offset, size_t from, short depth) const;
+    size_t FindLast(NodeId x, size_t base, int offset, size_t before, short depth) const;
+    void Collect(NodeId x, size_t base, int offset, size_t from, size_t to,
+                 std::vector<NodeId> &ids, std::vector<short> &depths) const;
+    bool Append(NodeId x, int offset, PresetData &data) const;
+    // nearest depth for a subtree spanning span levels inserted at row, false if none keeps the tree valid
+    bool Fit(size_t row, short span, short &depth) const;
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
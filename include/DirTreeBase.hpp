@@ -1,24 +1,28 @@
 #ifndef FSTUI_DIRTREEBASE_HPP
 #define FSTUI_DIRTREEBASE_HPP
 
+#include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <functional>
 
 #include "ftxui/component/component_base.hpp"   // for component base
 #include "ftxui/component/component_options.hpp"// for MenuOption
 #include "ftxui/component/screen_interactive.hpp"
 #include "ftxui/util/ref.hpp"// for Ref
 
+#include "DirTree.hpp"
+#include "FuzzyFilter.hpp"
+
 namespace fstui {
   using namespace ftxui;
   namespace fs = std::filesystem;
 
   class DirTreeBase : public ComponentBase {
 public:
-    DirTreeBase(std::vector<std::wstring> &entries,
-                std::vector<short> &depths,
+    DirTreeBase(DirTree &tree,
                 int &selected,
                 std::vector<ConstStringRef> &labels,
-                std::vector<std::vector<bool>> &labelChecks,
                 std::string windowName,
                 Ref<MenuOption> menuOption = {},
                 Ref<CheckboxOption> checkboxOption = {});
@@ -26,28 +30,55 @@ public:
     Element Render() override;
     bool OnEvent(Event event) override;
     void Init();
+    // undo keeps at most depth steps, older ones go first once their snapshots hold more than bytes
+    void SetHistoryLimits(size_t depth, size_t bytes);
 
 private:
     // STATES
     enum States { FOCUSED,
                   SELECTED,
-                  EDITING };
+                  EDITING,
+                  FILTERING };
     States state_;
     bool isLabelsFocused_;
     const std::wstring windowName_;
 
     // DIR TREE
-    std::vector<std::wstring> &entries_;
-    std::vector<short> &depths_;
+    DirTree &tree_;
     int &focused_;
-    std::vector<std::wstring> prefixs_;
-    std::vector<Box> treeBoxes_;
+    // only the rows inside treeBox_ are rendered
+    Box treeBox_;
+    int scrollTop_;
+    std::vector<DirTree::NodeId> windowIds_;
+    std::vector<short> windowDepths_;
+    // bit j: level j continues below this row, expanded to glyphs only when drawn
+    std::vector<uint64_t> prefixMasks_;
     std::wstring inputString_;
     int inputPosition_;
+    // shown under the tree until the next key
+    std::wstring notice_;
+
+    // FILTER, typed after '/': the rows shown are filter_'s view while its query is not empty
+    FuzzyFilter filter_;
+    int filterFocused_;
+    // focused_ before filtering, back on Esc
+    int filterOrigin_;
+
+    // UNDO, snapshots of the whole tree sharing everything an edit left alone
+    struct Snapshot {
+      DirTree tree;
+      int focused;
+      size_t bytes;// held by this snapshot alone, roughly
+    };
+    std::deque<Snapshot> undo_;
+    std::deque<Snapshot> redo_;
+    size_t historyDepth_;
+    size_t historyBytes_;
+    // tree_.CopiedBytes() when undo_.back() was taken
+    size_t copiedMark_;
 
     // LABEL CHECKBOXES
     std::vector<ConstStringRef> &labels_;
-    std::vector<std::vector<bool>> &labelChecked_;
     std::vector<Box> labelBoxes_;
     int labelFocused_;
     Ref<CheckboxOption> checkboxOption_;
@@ -57,14 +88,33 @@ private:
     void TransitState(States targetState);
     bool OnMouseEvent(Event event);
 
+    // before every edit
+    void Checkpoint();
+    // after an edit, with the tree as it was before and its CopiedBytes() then
+    void Checkpoint(Snapshot &&before, size_t copied);
+    // runs a move of row's subtree returning its new row, checkpointed only if the subtree went anywhere
+    size_t MoveSubtree(int row, const std::function<size_t()> &move);
+    void Undo();
+    void Redo();
+    void TrimHistory();
     void ToggleLabel(int dirId, int labelId);
+    void ScrollTo(int entryId, int viewHeight);
     void MoveFocus(int dstId);
     void MoveLabelFocus(int dstId);
     void AddEntry(int dstId, short depth = 0, const std::wstring &content = L"");
     void MoveEntry(int srcId, int dstId);
     void RemoveEntry(int tgtId);
-    void MoveDepth(int entryId, short depth);
-    void UpdatePrefixsAndDepths(bool formatDepth = true);
+    void MoveDepth(int entryId, int delta);
+    void UpdateWindow(int viewHeight);
+    std::wstring Prefix(int windowRow) const;
+    bool Filtered() const { return state_ == States::FILTERING && filter_.Active(); }
+    // rows in view, the tree or the filter matches
+    int ViewSize() const { return Filtered() ? filter_.Size() : tree_.Size(); }
+    void SetFilter(const std::wstring &query);
+    void MoveFilterFocus(int dstId);
+    void EndFilter(bool keep);
+    // matched characters underlined
+    Element Highlight(const std::wstring &name) const;
   };
 }// namespace fstui
 
@@ -0,0 +1,98 @@
+#ifndef FSTUI_DIRWALKER_HPP
+#define FSTUI_DIRWALKER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "NameArena.hpp"
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  struct WalkDir;
+
+  struct WalkEntry {
+    std::string name;
+    WalkDir *dir;// null for non-directories
+  };
+
+  struct WalkDir {
+    WalkDir *parent;
+    std::string name;
+    short depth;// of its children
+    int64_t mtime;
+    std::vector<WalkEntry> children;
+    int fd;// only while queued
+  };
+
+  struct WalkOptions {
+    int maxDepth = -1;// deepest depth kept, -1 -> unlimited
+    std::vector<std::string> excludes;// globs on the name, or on the relative path if they contain '/'
+    bool includeFiles = false;
+    unsigned threads = 0;
+  };
+
+  // parallel directory walker on getdents64/openat.
+  // every worker owns a deque and steals from the others when its own runs dry.
+  class DirWalker {
+public:
+    explicit DirWalker(WalkOptions options = {});
+
+    bool Walk(const fs::path &root);
+    const WalkDir &Root() const { return *root_; }
+    size_t DirCount() const { return dirCount_; }
+    size_t EntryCount() const { return entryCount_; }
+    size_t ErrorCount() const { return errorCount_; }
+    const std::string &FirstError() const { return firstError_; }
+
+    // pre-order with children sorted by name, the layout DirTreeBase expects. names go to arena
+    void Linearize(NameArena &arena, std::vector<std::string_view> &entries, std::vector<short> &depths) const;
+
+    // getdents64 over an open dir fd without "." and "..", returns 0 or errno
+    static int ReadDir(int fd, const std::function<void(const char *name, bool isDir)> &onEntry);
+
+private:
+    struct Worker {
+      std::mutex mutex;
+      std::deque<WalkDir *> queue;
+      std::deque<WalkDir> storage;
+    };
+
+    const WalkOptions options_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    WalkDir *root_;
+    int rootFd_;
+    std::atomic<size_t> pending_;
+    // idle workers wait here until directories are queued or pending_ reaches 0
+    std::mutex parkMutex_;
+    std::condition_variable parked_;
+    // bumped under parkMutex_ after each push to a queue
+    std::atomic<size_t> pushes_;
+    std::atomic<long> openFds_;
+    long fdBudget_;
+    std::atomic<size_t> dirCount_;
+    std::atomic<size_t> entryCount_;
+    std::atomic<size_t> errorCount_;
+    std::mutex errorMutex_;
+    std::string firstError_;
+    bool pathExcludes_;
+
+    void Run(size_t self);
+    WalkDir *Next(size_t self);
+    void Scan(size_t self, WalkDir *dir);
+    bool Excluded(const WalkDir *parent, const std::string &name) const;
+    std::string RelativePath(const WalkDir *dir) const;
+    void Fail(const WalkDir *dir, int err);
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef FSTUI_ENCODING_HPP
+#define FSTUI_ENCODING_HPP
+
+#include <string>
+#include <string_view>
+
+namespace fstui {
+
+  // wchar_t holds a full code point on linux
+  inline std::string ToUtf8(const std::wstring &str) {
+    std::string out;
+    out.reserve(str.size());
+    for (wchar_t wc : str) {
+      auto c = static_cast<unsigned long>(wc);
+      if (c < 0x80) {
+        out.push_back(static_cast<char>(c));
+      } else if (c < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+      } else if (c < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+      } else {
+        out.push_back(static_cast<char>(0xF0 | ((c >> 18) & 0x07)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+      }
+    }
+    return out;
+  }
+
+  // invalid sequences fall back to one code point per byte
+  inline std::wstring FromUtf8(const char *str, size_t size) {
+    std::wstring out;
+    out.reserve(size);
+    auto bytes = reinterpret_cast<const unsigned char *>(str);
+    for (size_t i = 0; i < size;) {
+      unsigned char c = bytes[i];
+      size_t len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+      bool valid = len > 0 && i + len <= size;
+      for (size_t k = 1; valid && k < len; k++) valid = (bytes[i + k] & 0xC0) == 0x80;
+      if (!valid) {
+        out.push_back(static_cast<wchar_t>(c));
+        i++;
+        continue;
+      }
+      unsigned long cp = len == 1 ? c : len == 2 ? c & 0x1F : len == 3 ? c & 0x0F : c & 0x07;
+      for (size_t k = 1; k < len; k++) cp = (cp << 6) | (bytes[i + k] & 0x3F);
+      out.push_back(static_cast<wchar_t>(cp));
+      i += len;
+    }
+    return out;
+  }
+
+  inline std::wstring FromUtf8(std::string_view str) {
+    return FromUtf8(str.data(), str.size());
+  }
+}// namespace fstui
+
+#endif
\ No newline at end of file
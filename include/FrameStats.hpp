@@ -0,0 +1,82 @@
+#ifndef FSTUI_FRAMESTATS_HPP
+#define FSTUI_FRAMESTATS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ftxui/component/component_base.hpp"// for ComponentBase, Component
+#include "ftxui/dom/elements.hpp"            // for Element
+
+namespace fstui {
+  using namespace ftxui;
+
+  // heap allocations made by the calling thread so far. only counted when built with FSTUI_COUNT_ALLOCS,
+  // where main.cpp replaces operator new to bump threadAllocations, 0 otherwise.
+  extern thread_local size_t threadAllocations;
+  inline size_t ThreadAllocations() { return threadAllocations; }
+
+  // frame and event timings for the HUD, UI thread only.
+  // a timed call costs two clock reads and two counter reads, whether the HUD is shown or not.
+  class FrameStats {
+public:
+    using Clock = std::chrono::steady_clock;
+    // samples kept per series
+    static const size_t kWindow = 256;
+
+    // the last kWindow samples
+    class Series {
+  public:
+      void Add(uint64_t value);
+      size_t Count() const { return count_; }
+      uint64_t Last() const;
+      // q in [0, 1]
+      uint64_t Percentile(double q) const;
+      template<typename F>
+      void ForEach(F &&f) const {
+        for (size_t i = 0; i < count_; i++) f(samples_[i]);
+      }
+
+  private:
+      std::array<uint64_t, kWindow> samples_{};
+      size_t next_ = 0, count_ = 0;
+    };
+
+    explicit FrameStats(bool shown = false);
+
+    // times Render and OnEvent of child, listed under name
+    Component Wrap(Component child, const std::string &name);
+    // the top component: whole frames, event to frame latency, and the HUD under child while shown.
+    // Ctrl+P toggles it.
+    Component Root(Component child);
+    void SetEntries(std::function<size_t()> entries) { entries_ = std::move(entries); }
+
+    void Toggle() { shown_ = !shown_; }
+    bool Shown() const { return shown_; }
+    Element Render() const;
+
+private:
+    struct Part {
+      std::wstring name;
+      Series render, event;
+    };
+    class Timed;
+    class Top;
+
+    bool shown_;
+    // wrappers point into these
+    std::vector<std::unique_ptr<Part>> parts_;
+    Series frame_, frameAllocs_, event_, eventAllocs_;
+    // from the first input event not drawn yet to the end of the frame drawing it
+    Series latency_;
+    bool pending_;
+    Clock::time_point eventAt_;
+    std::function<size_t()> entries_;
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
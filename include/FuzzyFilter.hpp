@@ -0,0 +1,78 @@
+#ifndef FSTUI_FUZZYFILTER_HPP
+#define FSTUI_FUZZYFILTER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DirTree.hpp"
+
+namespace fstui {
+
+  // type-to-filter over the rows of a tree: entries whose name holds the query as a subsequence,
+  // case-insensitive for ASCII, shown with their ancestors in tree order.
+  // each query character narrows the matches of the one before, and backspace drops back to them.
+  // the first character is found through a 64-bit character bloom per row, compared 4 rows at a time with avx2.
+  class FuzzyFilter {
+public:
+    static const size_t npos = SIZE_MAX;
+
+    // the rows of tree as they are now, collapsed children left out. O(n), the filter does not follow edits.
+    void Build(const DirTree &tree);
+    void Clear();
+    bool Active() const { return !query_.empty(); }
+    const std::wstring &Query() const { return query_; }
+    void SetQuery(const std::wstring &query);
+
+    // VIEW, the matches and their ancestors
+    size_t Size() const { return rows_.size(); }
+    // row in the tree
+    size_t Row(size_t i) const { return rows_[i]; }
+    short Depth(size_t i) const { return depths_[rows_[i]]; }
+    // whether level depth goes on below i in the view
+    bool Continues(size_t i, short depth) const;
+    // false for ancestors shown only to place a match
+    bool Matched(size_t i) const { return marks_[rows_[i]] == generation_ + 1; }
+    size_t Matches() const { return levels_.empty() ? 0 : levels_.back().size(); }
+    // view index of the best scoring match, npos without matches
+    size_t Best() const { return best_; }
+
+    // characters of name matched by query, as the filter matches them
+    static std::vector<size_t> Positions(const std::wstring &name, const std::wstring &query);
+
+private:
+    struct Candidate {
+      uint32_t row;
+      uint32_t end;// past the last matched byte
+      int32_t score;
+    };
+
+    std::wstring query_;
+    // levels_[k]: matches of the first k + 1 query characters
+    std::vector<std::vector<Candidate>> levels_;
+    // dropped levels, kept for their memory
+    std::vector<std::vector<Candidate>> spare_;
+
+    // ROWS, names folded and UTF-8 encoded back to back
+    std::string names_;
+    std::vector<uint32_t> offsets_;
+    std::vector<uint8_t> depths_;
+    std::vector<uint32_t> parents_;
+    std::vector<uint64_t> blooms_;
+    // rows through the bloom test, reused
+    std::vector<uint32_t> selected_;
+
+    // VIEW
+    // rows in the view are marked generation_ as ancestors, generation_ + 1 as matches
+    std::vector<uint32_t> marks_;
+    uint32_t generation_ = 0;
+    std::vector<uint32_t> rows_;
+    size_t best_ = npos;
+
+    // matches the next query character after the top level
+    void Narrow(wchar_t c);
+    void UpdateView();
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef FSTUI_LABELACTIONS_HPP
+#define FSTUI_LABELACTIONS_HPP
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#include "LabelStore.hpp"
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  struct ActionStats {
+    std::atomic<size_t> files{0}; // written into entries
+    std::atomic<size_t> cloned{0};// of those, shared with the template through a reflink
+    std::atomic<size_t> existed{0};
+  };
+
+  // what materializing does to an entry for each of its labels, read from a labels.actions file:
+  //   <label> copy <template> [name]   the template file, relative to the actions file, as name in the entry
+  //   <label> touch <name>             an empty file, e.g. .gitkeep
+  //   <label> mode <octal>             the entry's permissions, set once everything under it exists
+  // files already in the entry are left as they are.
+  // copies try FICLONE, then copy_file_range, then read/write, and stop trying a way once it failed with EXDEV or
+  // an unsupported error.
+  class LabelActions {
+public:
+    enum Kind { COPY,
+                TOUCH,
+                MODE };
+
+    LabelActions() = default;
+    LabelActions(const LabelActions &) = delete;
+    LabelActions &operator=(const LabelActions &) = delete;
+    ~LabelActions();
+
+    // "#" comments, actions of labels the preset does not have are ignored
+    bool Read(const fs::path &file, std::string &error);
+    // where the actions of the presets in presetDir are read from
+    static fs::path FileFor(const fs::path &presetDir) { return presetDir / "labels.actions"; }
+
+    // labels and checked of the preset being materialized, kept by pointer
+    void Bind(const std::vector<std::string> &labels, const LabelStore &checked);
+    bool Empty() const { return bound_.empty(); }
+    bool Has(size_t row) const;
+
+    // files of row's labels into parentFd/name, returns 0 or the first errno
+    int Seed(size_t row, int parentFd, const std::string &name, ActionStats &stats) const;
+    // permissions of row's labels on parentFd/name, the last label wins
+    int Chmod(size_t row, int parentFd, const std::string &name) const;
+
+    // what Seed and Chmod would do, for writers that do not go through a directory.
+    // fn gets each file of row's labels once, by name: the template's fd and size, or -1 and 0 for touch
+    void ForEachFile(size_t row, const std::function<void(const std::string &name, int fd, off_t size, mode_t mode)> &fn) const;
+    // false when none of row's labels sets one
+    bool ModeOf(size_t row, mode_t &mode) const;
+
+private:
+    struct Action {
+      std::string label;
+      Kind kind;
+      fs::path source;
+      std::string name;
+      mode_t mode;
+      // COPY
+      int fd = -1;
+      off_t size = 0;
+      // ways still worth trying
+      std::unique_ptr<std::atomic<bool>> clone, range;
+    };
+
+    std::vector<Action> actions_;
+    // (label column, action) pairs of the bound preset
+    std::vector<std::pair<size_t, size_t>> bound_;
+    const LabelStore *checked_ = nullptr;
+
+    int Copy(const Action &action, int dirFd, ActionStats &stats) const;
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef FSTUI_LABELSTORE_HPP
+#define FSTUI_LABELSTORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fstui {
+
+  // entry labels as one packed bit column per label.
+  // queries AND/OR whole columns and popcount them, with avx2/sse2 kernels picked at runtime.
+  class LabelStore {
+public:
+    explicit LabelStore(size_t labels = 0, size_t rows = 0);
+
+    void Reset(size_t labels, size_t rows);
+    size_t Labels() const { return labels_; }
+    size_t Rows() const { return rows_; }
+
+    bool Get(size_t row, size_t label) const {
+      return Column(label)[row >> 6] >> (row & 63) & 1;
+    }
+    void Set(size_t row, size_t label, bool value) {
+      uint64_t &word = Column(label)[row >> 6];
+      word = value ? word | uint64_t(1) << (row & 63) : word & ~(uint64_t(1) << (row & 63));
+    }
+    void Toggle(size_t row, size_t label) {
+      Column(label)[row >> 6] ^= uint64_t(1) << (row & 63);
+    }
+
+    // ROWS
+    void InsertRow(size_t row);
+    void EraseRow(size_t row);
+    void SwapRows(size_t a, size_t b);
+    void PushRow() { InsertRow(rows_); }
+    void ClearRow(size_t row) {
+      for (size_t l = 0; l < labels_; l++) Set(row, l, false);
+    }
+
+    // RAW COLUMNS, ceil(rows / 64) words each
+    const uint64_t *Bits(size_t label) const { return Column(label); }
+    void Load(size_t labels, size_t rows, const uint64_t *columns, size_t stride);
+
+    // QUERIES
+    // rows with every label of all and, if any is not empty, at least one of any. one bit per row.
+    std::vector<uint64_t> Match(const std::vector<size_t> &all, const std::vector<size_t> &any = {}) const;
+    static size_t Count(const std::vector<uint64_t> &bits);
+    static std::vector<size_t> RowsOf(const std::vector<uint64_t> &bits);
+    // entries tagged with each label
+    std::vector<size_t> CountPerLabel() const;
+
+private:
+    size_t labels_;
+    size_t rows_;
+    size_t stride_;// words per column, bits past rows_ stay zero
+    std::vector<uint64_t> bits_;
+
+    uint64_t *Column(size_t label) { return bits_.data() + label * stride_; }
+    const uint64_t *Column(size_t label) const { return bits_.data() + label * stride_; }
+    size_t Words() const { return (rows_ + 63) >> 6; }
+    void Reserve(size_t rows);
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef FSTUI_MATERIALIZER_HPP
+#define FSTUI_MATERIALIZER_HPP
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+#include "LabelActions.hpp"
+#include "TaskRunner.hpp"
+#include "WorkerPool.hpp"
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  struct MaterializeStats {
+    size_t nodes = 0;
+    size_t created = 0;
+    size_t existed = 0;
+    size_t failed = 0;
+    size_t files = 0; // seeded by label actions
+    size_t cloned = 0;// of those, reflinked
+    bool cancelled = false;
+    double seconds = 0;
+    std::string firstError;
+
+    double NodesPerSecond() const { return seconds > 0 ? nodes / seconds : 0; }
+    std::wstring Summary() const;
+  };
+
+  // turns the entries/depths model into directories under root.
+  // every depth level is created in parallel, each node relative to its parent's dir fd.
+  // with actions bound to the preset, a slab's label actions run in parallel once everything under it exists.
+  class Materializer {
+public:
+    explicit Materializer(WorkerPool &pool, mode_t mode = 0777);
+
+    MaterializeStats Run(const std::vector<std::string_view> &entries,
+                         const std::vector<short> &depths,
+                         const fs::path &root,
+                         TaskProgress *progress = nullptr,
+                         const LabelActions *actions = nullptr);
+
+private:
+    struct Context;
+
+    WorkerPool &pool_;
+    const mode_t mode_;
+
+    void RunLevel(Context &ctx, size_t level, size_t begin, size_t end, size_t hiRow);
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
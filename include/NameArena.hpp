@@ -0,0 +1,43 @@
+#ifndef FSTUI_NAMEARENA_HPP
+#define FSTUI_NAMEARENA_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fstui {
+
+  // UTF-8 entry names bump-allocated into blocks that never move, handed out as string_views.
+  // each is followed by a NUL, so the data() of a view can go to system calls.
+  // nothing is freed before the arena, so views stay valid while any holder of it lives.
+  // one thread adds at a time, views may be read from any.
+  class NameArena {
+public:
+    NameArena() = default;
+    NameArena(const NameArena &) = delete;
+    NameArena &operator=(const NameArena &) = delete;
+
+    std::string_view Add(std::string_view name);
+    // owner lives as long as the arena, for views into memory it holds
+    void Keep(std::shared_ptr<const void> owner) { kept_.push_back(std::move(owner)); }
+    // held in blocks
+    size_t Bytes() const { return bytes_; }
+
+private:
+    // blocks double from the first up to the last size, longer names get one of their own
+    static const size_t kFirstBlock = 256;
+    static const size_t kMaxBlock = size_t(1) << 16;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char *next_ = nullptr;
+    size_t left_ = 0;
+    size_t blockSize_ = kFirstBlock;
+    std::atomic<size_t> bytes_{0};
+    std::vector<std::shared_ptr<const void>> kept_;
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef FSTUI_PATTERN_HPP
+#define FSTUI_PATTERN_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fstui {
+
+  // an entry name standing for many siblings, shell brace style:
+  //   shot_{0001..5000}   numbers, zero padded to the wider bound when either has a leading zero
+  //   take_{a..e}         letters
+  //   {1..9..2}           either with a step
+  //   {red,green,blue}    a list
+  // groups multiply, the last one counting fastest. a group that parses as none of these stays literal.
+  // \{ and \} are literal braces, expanded without the backslash.
+  // the pattern is the node's name in the tree and the files, it is only expanded when iterated.
+  class Pattern {
+public:
+    explicit Pattern(std::string_view name);
+    // name with its braces escaped, for names that are not meant as patterns
+    static std::string Escape(std::string_view name);
+
+    bool IsPattern() const { return !groups_.empty(); }
+    // 1 for a plain name, SIZE_MAX once it overflows
+    size_t Count() const { return count_; }
+    // i < Count()
+    std::string At(size_t i) const;
+
+private:
+    struct Group {
+      enum Kind { NUMBER,
+                  LETTER,
+                  LIST };
+      Kind kind;
+      long long first;
+      long long step;
+      size_t count;
+      int width;// zero padded, with the sign
+      std::vector<std::string> items;
+    };
+
+    // literals_[k] comes before groups_[k], the last one after them all
+    std::vector<std::string> literals_;
+    std::vector<Group> groups_;
+    size_t count_;
+
+    static bool ParseRange(std::string_view body, Group &group);
+    static bool ParseList(std::string_view body, Group &group);
+    void Append(const Group &group, size_t k, std::string &out) const;
+  };
+
+  // rows with every pattern replaced by its expansions in order, each followed by a copy of the pattern's subtree.
+  // row is the entry a row comes from, name is only valid during the call. fn returns false to stop.
+  void ForEachExpanded(const std::vector<std::string_view> &entries,
+                       const std::vector<short> &depths,
+                       const std::function<bool(std::string_view name, short depth, size_t row)> &fn);
+  // rows ForEachExpanded would give, SIZE_MAX once it overflows
+  size_t ExpandedCount(const std::vector<std::string_view> &entries, const std::vector<short> &depths);
+
+  // runs refuse presets expanding to more, a typo like {0..4000000000} would fill memory or the disk
+  const size_t kMaxExpanded = size_t(1) << 24;
+  // for a count past kMaxExpanded
+  std::string ExpandedError(size_t count);
+}// namespace fstui
+
+#endif
\ No newline at end of file
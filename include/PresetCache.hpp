@@ -0,0 +1,77 @@
+#ifndef FSTUI_PRESETCACHE_HPP
+#define FSTUI_PRESETCACHE_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "DirTree.hpp"
+#include "WorkerPool.hpp"
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  // a preset as the tree shows it after loading
+  struct PresetModel {
+    std::vector<std::string> labels;
+    DirTree tree;
+  };
+
+  // parsed presets, least recently used dropped first once they hold more than budget bytes.
+  // an entry is only used while the file has the device, inode, size and mtime it was parsed from.
+  class PresetCache {
+public:
+    explicit PresetCache(WorkerPool &pool, size_t budget = size_t(256) << 20);
+    ~PresetCache();
+
+    PresetCache(const PresetCache &) = delete;
+    PresetCache &operator=(const PresetCache &) = delete;
+
+    // parsed here on a miss, null if path cannot be read
+    std::shared_ptr<const PresetModel> Get(const fs::path &path);
+    // parses path on the pool unless it is cached or already on its way
+    void Prefetch(const fs::path &path);
+    // a big .df opens with its deep levels collapsed, as ScanPreset leaves them
+    static std::shared_ptr<PresetModel> Parse(const fs::path &path);
+
+private:
+    struct Stamp {
+      uint64_t dev, ino, size;
+      int64_t mtime;
+      bool operator==(const Stamp &other) const {
+        return dev == other.dev && ino == other.ino && size == other.size && mtime == other.mtime;
+      }
+    };
+
+    struct Slot {
+      Stamp stamp;
+      std::shared_ptr<const PresetModel> model;
+      size_t bytes;
+      std::list<std::string>::iterator lru;
+    };
+
+    WorkerPool &pool_;
+    const size_t budget_;
+    std::mutex mutex_;
+    std::condition_variable parsed_;
+    // most recent first
+    std::list<std::string> lru_;
+    std::unordered_map<std::string, Slot> slots_;
+    std::unordered_set<std::string> parsing_;
+    size_t bytes_;
+
+    static bool StampOf(const fs::path &path, Stamp &stamp);
+    // with mutex_ held
+    std::shared_ptr<const PresetModel> Find(const std::string &key, const Stamp &stamp);
+    void Insert(const std::string &key, const Stamp &stamp, std::shared_ptr<const PresetModel> model);
+  };
+}// namespace fstui
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef FSTUI_PRESETCATALOG_HPP
+#define FSTUI_PRESETCATALOG_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "PresetGraph.hpp"
+#include "WorkerPool.hpp"
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  struct CatalogHit {
+    fs::path path;
+    uint64_t entries;
+    short maxDepth;
+    // labels checked on at least one entry
+    std::vector<std::string> labels;
+  };
+
+  // what the presets of a directory hold, searchable without opening them.
+  // per preset its entry count, depth, used labels and stamp, and an inverted index from entry names,
+  // parent/child name pairs and labels to the presets holding them (names ignoring ASCII case).
+  // kept in dir/.catalog as an append-only log, a preset that changed appends its new record.
+  // includes are resolved, a preset is indexed again when one it includes changes.
+  // presets are indexed on a thread of its own, the ones of one batch in parallel on the pool.
+  //
+  // a query is terms that all have to match:
+  //   final             an entry named final
+  //   renders/final     an entry final directly under an entry renders, paths may go on: a/b/c
+  //   shot_*            an entry name starting with shot_
+  //   renders/final@X   ... where final has the label X
+  //   label:X           a preset with an entry labelled X
+  class PresetCatalog {
+public:
+    // notify runs on the catalog thread whenever the index changed
+    PresetCatalog(WorkerPool &pool, fs::path dir, std::function<void()> notify = nullptr);
+    ~PresetCatalog();
+
+    PresetCatalog(const PresetCatalog &) = delete;
+    PresetCatalog &operator=(const PresetCatalog &) = delete;
+
+    static fs::path FileFor(const fs::path &dir) { return dir / ".catalog"; }
+
+    // indexed again unless the file is as it was when last indexed
+    void Refresh(const fs::path &path);
+    void Forget(const fs::path &path);
+    // forgets every preset whose path is not in present, for presets removed while nothing watched
+    void Retain(std::unordered_set<std::string> present);
+    // returns once everything asked for so far is indexed
+    void Wait();
+
+    // by file name, at most limit hits (0 for all)
+    std::vector<CatalogHit> Query(const std::string &query, size_t limit = 0) const;
+    // changes whenever the index did
+    size_t Generation() const { return generation_; }
+    size_t Size() const;
+
+private:
+    struct Stamp {
+      uint64_t ino = 0, size = 0;
+      int64_t mtime = 0;
+      bool operator==(const Stamp &other) const { return ino == other.ino && size == other.size && mtime == other.mtime; }
+    };
+
+    // a preset as read from its file, terms sorted and unique
+    struct Scan {
+      std::string name;
+      bool present = false;
+      Stamp stamp;
+      // the files its includes were resolved from
+      std::vector<PresetGraph::Stamp> includes;
+      uint64_t entries = 0;
+      short maxDepth = 0;
+      std::vector<std::string> labels;
+      std::vector<std::string> terms;
+    };
+
+    struct Record {
+      std::string name;
+      Stamp stamp;
+      std::vector<PresetGraph::Stamp> includes;
+      uint64_t entries = 0;
+      short maxDepth = 0;
+      std::vector<std::string> labels;
+      std::vector<uint32_t> terms;
+    };
+
+    struct Op {
+      enum Kind { REFRESH,
+                  FORGET,
+                  RETAIN } kind;
+      std::string name;
+      std::unordered_set<std::string> present;
+    };
+
+    WorkerPool &pool_;
+    const fs::path dir_;
+    const std::function<void()> notify_;
+
+    // the index, written by the catalog thread only
+    mutable std::mutex mutex_;
+    std::vector<Record> records_;
+    std::vector<uint32_t> free_;
+    std::unordered_map<std::string, uint32_t> byName_;
+    // terms by id, ids of dropped terms are reused
+    std::unordered_map<std::string, uint32_t> termIds_;
+    std::vector<const std::string *> terms_;
+    std::vector<std::vector<uint32_t>> postings_;
+    std::vector<uint32_t> freeTerms_;
+    // name terms in order, for prefixes
+    std::set<std::string_view> names_;
+    std::atomic<size_t> generation_;
+    // records in the file, superseded ones included
+    size_t logged_ = 0;
+
+    // asked for, not yet done
+    std::mutex queueMutex_;
+    std::condition_variable queued_, idle_;
+    std::vector<Op> queue_;
+    bool busy_;
+    bool stop_;
+    std::thread thread_;
+
+    void Run();
+    void Apply(std::vector<Op> &ops);
+    // graph resolves includes, once for all presets of a batch including them
+    static Scan Read(PresetGraph &graph, const fs::path &path, const std::string &name);
+
+    // with mutex_ held
+    void Put(Scan &scan);
+    void Drop(const std::string &name);
+
+    // LOG
+    void Load();
+    void Compact();
+    void Append(const std::vector<Scan> &scans);
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef FSTUI_PRESETGRAPH_HPP
+#define FSTUI_PRESETGRAPH_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "PresetIO.hpp"
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  // an entry named "@include <preset.df>" mounts that preset's entries in its place, at its depth:
+  //   project
+  //   	@include common/src.df
+  // puts the top level entries of common/src.df under project. the path is relative to the including preset.
+  // labels checked on the include are checked on everything it mounts, the included preset's labels are
+  // matched by name and appended when new.
+  // presets keep their includes as written, they are resolved for materializing, indexing and the catalog.
+  class PresetGraph {
+public:
+    // a file as it was when read
+    struct Stamp {
+      std::string path;
+      uint64_t ino, size;
+      int64_t mtime;
+    };
+
+    static bool IsInclude(std::string_view name);
+    // the path an include names, as written
+    static std::string_view Target(std::string_view name);
+
+    // the preset at path with every include resolved, null with error set on an unreadable preset or a cycle.
+    // a resolved preset is kept until one of the files it was resolved from changes, presets included by
+    // many are resolved once and shared.
+    // files, if given, gets every file the result was resolved from, path itself included
+    std::shared_ptr<const PresetData> Resolve(const fs::path &path, std::string &error,
+                                              std::vector<Stamp> *files = nullptr);
+    // data as it would be saved to path
+    std::shared_ptr<const PresetData> Resolve(std::shared_ptr<const PresetData> data, const fs::path &path,
+                                              std::string &error);
+    size_t Cached() const;
+
+    // the path files are known by, includes reaching a file by different paths share it
+    static std::string Key(const fs::path &path);
+    static bool StampOf(const std::string &path, Stamp &stamp);
+    // whether none of files changed since stamped
+    static bool Fresh(const std::vector<Stamp> &files);
+
+private:
+    struct Node {
+      std::shared_ptr<const PresetData> data;
+      // the preset and everything it includes, directly or not
+      std::vector<Stamp> files;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Node> nodes_;
+
+    // with mutex_ held. stack holds the keys being resolved, files collects what the result depends on
+    std::shared_ptr<const PresetData> ResolveFile(const std::string &key, std::vector<std::string> &stack,
+                                                  std::vector<Stamp> &files, std::string &error);
+    std::shared_ptr<const PresetData> Splice(std::shared_ptr<const PresetData> data, const fs::path &dir,
+                                             std::vector<std::string> &stack, std::vector<Stamp> &files,
+                                             std::string &error);
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef FSTUI_PRESETIO_HPP
+#define FSTUI_PRESETIO_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LabelStore.hpp"
+#include "NameArena.hpp"
+#include "TaskRunner.hpp"
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  struct PresetData {
+    std::vector<std::string> labels;
+    // UTF-8, entries point into names
+    std::shared_ptr<NameArena> names = std::make_shared<NameArena>();
+    std::vector<std::string_view> entries;
+    std::vector<short> depths;
+    LabelStore labelChecked;
+  };
+
+  // .df: optional "|label|label|" header, then one tab-indented entry per line with " |0101|" label flags
+  bool LoadPreset(const fs::path &path, PresetData &data);
+  bool SavePreset(const fs::path &path,
+                  const std::vector<std::string> &labels,
+                  const std::vector<std::string_view> &entries,
+                  const std::vector<short> &depths,
+                  const LabelStore &labelChecked,
+                  TaskProgress *progress = nullptr);
+  // a cancelled save leaves the old file as it was
+  bool SavePreset(const fs::path &path, const PresetData &data, TaskProgress *progress = nullptr);
+
+  // a preset file held open, read a range at a time.
+  // reads fail once the file is no longer as it was when opened, e.g. rewritten in place by another tool;
+  // one replaced through a rename, as SavePreset does, stays readable.
+  class PresetSource {
+public:
+    PresetSource() = default;
+    PresetSource(const PresetSource &) = delete;
+    PresetSource &operator=(const PresetSource &) = delete;
+    ~PresetSource();
+
+    bool Open(const fs::path &path);
+    size_t Size() const { return size_; }
+    // bytes [begin, end) into bytes
+    bool Read(size_t begin, size_t end, std::string &bytes) const;
+    bool Changed() const;
+
+private:
+    int fd_ = -1;
+    size_t size_ = 0;
+    int64_t mtime_ = 0;
+  };
+
+  // children of row left in the source: bytes [begin, end)
+  struct PresetRange {
+    size_t row;
+    size_t begin, end;
+    short depth;// of row in the file
+    short span; // deepest level below row, relative
+  };
+
+  // entries read at once from a large preset
+  const size_t kScanBudget = 50000;
+
+  // like LoadPreset, but a file with more than budget entries is only read down to the deepest level that fits.
+  // the children of that level stay in the source as ranges.
+  // these fail, reading nothing, once the source changed.
+  bool ScanPreset(const PresetSource &source, size_t budget, PresetData &data, std::vector<PresetRange> &ranges);
+  // the same within a range, appending to data. rows of the new ranges index data.
+  bool ScanPresetRange(const PresetSource &source, const PresetRange &range, size_t budget,
+                       PresetData &data, std::vector<PresetRange> &ranges);
+  // appends every entry of a range, depths as in the file
+  bool LoadPresetRange(const PresetSource &source, const PresetRange &range, PresetData &data);
+}// namespace fstui
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef FSTUI_PRESETWATCHER_HPP
+#define FSTUI_PRESETWATCHER_HPP
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  // lists the presets of a directory on its own thread, then follows it with inotify.
+  // changes queue up until the UI thread takes them.
+  class PresetWatcher {
+public:
+    struct Change {
+      bool added;// or written again, else removed
+      fs::path path;
+    };
+
+    // notify runs on the watcher thread whenever changes start queueing
+    PresetWatcher(fs::path dir, std::string ext, std::function<void()> notify);
+    ~PresetWatcher();
+
+    PresetWatcher(const PresetWatcher &) = delete;
+    PresetWatcher &operator=(const PresetWatcher &) = delete;
+
+    // oldest first
+    std::vector<Change> Take();
+    // the first listing is queued completely
+    bool Listed() const { return listed_; }
+
+private:
+    const fs::path dir_;
+    const std::string ext_;
+    const std::function<void()> notify_;
+    int inotify_;
+    int wake_;// eventfd, ends the thread
+    std::atomic<bool> stop_;
+    std::atomic<bool> listed_;
+    std::mutex mutex_;
+    std::vector<Change> pending_;
+    // presets on disk as far as reported, watcher thread only
+    std::unordered_set<std::string> present_;
+    std::thread thread_;
+
+    void Run();
+    // diffs a fresh listing against present_
+    void List();
+    void Report(bool added, const fs::path &path);
+    void OnEvents();
+  };
+}// namespace fstui
+
+#endif
@@ -2,11 +2,17 @@
 #define FSTUI_PRESETSBASE_HPP
 
 #include <filesystem>
+#include <memory>
+#include <unordered_set>
 
 #include "ftxui/component/component_base.hpp"   // for component base
 #include "ftxui/component/component_options.hpp"// for MenuOption
 #include "ftxui/component/screen_interactive.hpp"
 
+#include "PresetCatalog.hpp"
+#include "PresetWatcher.hpp"
+#include "TaskRunner.hpp"
+
 namespace fstui {
   using namespace ftxui;
   namespace fs = std::filesystem;
@@ -18,16 +24,27 @@ public:
                 const std::string &windowName,
                 std::function<void(fs::path&)> onSave,
                 std::function<void(fs::path&)> onLoad,
-                std::function<void(fs::path&)> onAction);
+                std::function<void(fs::path&)> onAction,
+                std::function<void()> onIndexChange = nullptr,
+                std::function<void(fs::path&)> onPrefetch = nullptr);
 
     Element Render() override;
     bool OnEvent(Event event) override;
+    void SetStatus(const std::wstring &status);
+    // shows a gauge while tasks runs something
+    void SetTasks(const TaskRunner *tasks) { tasks_ = tasks; }
+    // kept up to date with the directory, and searched from the query box
+    void SetCatalog(PresetCatalog *catalog) { catalog_ = catalog; }
+    // a second button right of the action one, run on the selected preset like it
+    void SetExport(std::string exportName, std::function<void(fs::path &)> onExport);
 
 private:
     enum States { PRESETS,
                   SAVENAME,
                   EDITSAVENAME,
-                  ACTIONBTN};
+                  ACTIONBTN,
+                  EXPORTBTN,
+                  QUERY};
     States state_;
 
     // presets menu
@@ -35,11 +52,25 @@ private:
     const std::string presetDir_;
     std::vector<std::wstring> presetEntries_;
     std::vector<fs::path> presetPaths_;
+    std::unordered_set<std::string> knownPaths_;
+    // fills the menu in the background and keeps it in sync with the directory
+    std::unique_ptr<PresetWatcher> watcher_;
+    bool loaded_;
     int focused_;
     int selected_;
     std::vector<Box>  presetBoxes_;
     MenuOption menuOption_;
 
+    // query box, the menu shows only the presets the catalog matched
+    PresetCatalog *catalog_ = nullptr;
+    bool retained_ = false;
+    std::wstring query_;
+    size_t queryGeneration_ = 0;
+    // preset indices in menu order and what the catalog knows of them
+    std::vector<int> shown_;
+    std::vector<std::wstring> shownInfo_;
+    double queryMs_ = 0;
+
     // save name
     std::wstring inputString_;
     int inputPosition_;
@@ -48,14 +79,35 @@ private:
     // action btn
     Box actionbtnBox_;
     const std::wstring actionName_;
+    Box exportbtnBox_;
+    std::wstring exportName_;
+    std::wstring status_;
+    const TaskRunner *tasks_ = nullptr;
 
     const std::function<void(fs::path&)> onSave_;
     const std::function<void(fs::path&)> onLoad_;
     const std::function<void(fs::path&)> onAction_;
+    std::function<void(fs::path&)> onExport_;
+    // told about the presets around focused_, which are likely to be loaded next
+    const std::function<void(fs::path&)> onPrefetch_;
 
     const std::wstring windowName_;
 
     bool OnMouseEvent(Event event);
+    // applies what the watcher found since the last call
+    void Sync();
+    void AddPreset(size_t at, const fs::path &path);
+    void RemovePreset(const fs::path &path);
+    void Load(size_t index);
+    void Prefetch();
+    // QUERY
+    bool Querying() const { return !query_.empty(); }
+    int ShownSize() const { return Querying() ? shown_.size() : presetEntries_.size(); }
+    int ShownAt(int row) const { return Querying() ? shown_[row] : row; }
+    // the shown preset delta rows from index, -1 past either end
+    int Step(int index, int delta) const;
+    void SetQuery(const std::wstring &query);
+    void RunQuery();
   };
 }// namespace fstui
 
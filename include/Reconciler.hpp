@@ -0,0 +1,72 @@
+#ifndef FSTUI_RECONCILER_HPP
+#define FSTUI_RECONCILER_HPP
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+#include "LabelActions.hpp"
+#include "TaskRunner.hpp"
+#include "WorkerPool.hpp"
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  struct ReconcileOptions {
+    // list directories under root the preset does not have
+    bool extras = false;
+    // remove extras that hold nothing but directories, implies extras
+    bool prune = false;
+  };
+
+  struct ReconcileStats {
+    size_t nodes = 0;
+    size_t present = 0;
+    size_t created = 0;
+    size_t failed = 0;
+    size_t pruned = 0;
+    size_t files = 0; // seeded by label actions
+    size_t cloned = 0;// of those, reflinked
+    // relative to root, sorted. pruned ones included
+    std::vector<std::string> extras;
+    bool cancelled = false;
+    double seconds = 0;
+    std::string firstError;
+
+    double NodesPerSecond() const { return seconds > 0 ? nodes / seconds : 0; }
+    std::wstring Summary() const;
+  };
+
+  // brings an existing root in line with the entries/depths model, touching only what differs.
+  // a level at a time and in parallel: entries under an existing directory are looked up,
+  // entries under a directory this run created are known missing and made without a lookup.
+  // lookups go through a per-run cache, a listing of the parent when extras are wanted, an fstatat otherwise.
+  // label actions run as Materializer runs them, on present and created entries alike, once every level is done
+  // and deepest first, so files missing from existing entries are seeded too and a mode never locks out a child.
+  class Reconciler {
+public:
+    explicit Reconciler(WorkerPool &pool, mode_t mode = 0777);
+
+    ReconcileStats Run(const std::vector<std::string_view> &entries,
+                       const std::vector<short> &depths,
+                       const fs::path &root,
+                       ReconcileOptions options = {},
+                       TaskProgress *progress = nullptr,
+                       const LabelActions *actions = nullptr);
+
+private:
+    struct Context;
+
+    WorkerPool &pool_;
+    const mode_t mode_;
+
+    void RunLevel(Context &ctx, size_t level);
+    void RunActions(Context &ctx, size_t level);
+    // compares the listing of dir row (-1 -> root) with its children in the model, which are on childLevel
+    void Extras(Context &ctx, int row, size_t childLevel, int dirFd);
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef FSTUI_TASKRUNNER_HPP
+#define FSTUI_TASKRUNNER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fstui {
+
+  // shared by a running task and the UI drawing it
+  class TaskProgress {
+public:
+    void SetTotal(size_t total) { total_ = total; }
+    // asks for a redraw at most once a frame
+    void Advance(size_t n = 1);
+    bool Cancelled() const { return cancelled_; }
+    // done / total, negative while the total is unknown
+    float Fraction() const;
+
+private:
+    friend class TaskRunner;
+
+    std::atomic<size_t> done_{0};
+    std::atomic<size_t> total_{0};
+    std::atomic<bool> cancelled_{false};
+    std::atomic<int64_t> lastPost_{0};
+    std::function<void()> post_;
+  };
+
+  // runs load/save/action work on its own thread, one task after the other in submission order.
+  // ParallelFor inside a task still fans out to a WorkerPool.
+  // completions wait until the UI thread calls Poll, post wakes it up.
+  class TaskRunner {
+public:
+    explicit TaskRunner(std::function<void()> post);
+    ~TaskRunner();
+
+    TaskRunner(const TaskRunner &) = delete;
+    TaskRunner &operator=(const TaskRunner &) = delete;
+
+    // done gets whether the task was cancelled, work does not run at all if cancelled while queued
+    void Run(std::wstring name,
+             std::function<void(TaskProgress &)> work,
+             std::function<void(bool cancelled)> done = nullptr);
+    // the running task and everything queued behind it, which may rely on it
+    void Cancel();
+    // runs the done callbacks of finished tasks, UI thread only
+    void Poll();
+
+    bool Busy() const;
+    // of the running task
+    std::wstring Name() const;
+    float Fraction() const;
+
+private:
+    struct Task {
+      std::wstring name;
+      std::function<void(TaskProgress &)> work;
+      std::function<void(bool)> done;
+      std::shared_ptr<TaskProgress> progress;
+    };
+
+    const std::function<void()> post_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Task> queue_;
+    std::unique_ptr<Task> current_;
+    std::vector<std::pair<std::function<void(bool)>, bool>> finished_;
+    bool stop_;
+    std::thread thread_;
+
+    void Loop();
+  };
+}// namespace fstui
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef FSTUI_TRIGRAMINDEX_HPP
+#define FSTUI_TRIGRAMINDEX_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "WorkerPool.hpp"
+
+namespace fstui {
+  namespace fs = std::filesystem;
+
+  class DirWalker;
+
+  // entry 0 is the root, parents always come before their children
+  struct IndexEntry {
+    uint32_t parent;
+    std::string name;
+    bool dir;
+    int64_t mtime;// directories only, 0 when unknown
+  };
+
+  // persistent trigram index over file names.
+  // postings are delta/varint coded in blocks of 128 with a skip table, the file is mmap'ed.
+  class TrigramIndex {
+public:
+    TrigramIndex() = default;
+    ~TrigramIndex();
+    TrigramIndex(const TrigramIndex &) = delete;
+    TrigramIndex &operator=(const TrigramIndex &) = delete;
+
+    // BUILD
+    static void FromWalk(const DirWalker &walker, std::vector<IndexEntry> &entries);
+    static void FromPreset(const std::vector<std::string_view> &names,
+                           const std::vector<short> &depths,
+                           std::vector<IndexEntry> &entries);
+    // root is empty for presets, which cannot be updated
+    static bool Write(const fs::path &file, const std::string &root,
+                      const std::vector<IndexEntry> &entries, WorkerPool &pool, std::string &error);
+    // restat every directory, list only the ones whose mtime changed and rewrite the index
+    static bool Update(const fs::path &file, WorkerPool &pool, std::string &error, size_t *rescanned = nullptr);
+
+    // QUERY
+    bool Open(const fs::path &file);
+    void Close();
+    std::vector<uint32_t> Search(const std::string &query, bool ignoreCase, size_t limit) const;
+    std::vector<uint32_t> SearchRegex(const std::string &pattern, bool ignoreCase, size_t limit) const;
+    std::string Path(uint32_t id) const;
+    std::string Root() const;
+    size_t Size() const;
+
+private:
+    struct Header;
+    struct EntryRec;
+    struct TrigramRec;
+    class Cursor;
+
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    const Header *header_ = nullptr;
+    const EntryRec *entries_ = nullptr;
+    const TrigramRec *trigrams_ = nullptr;
+    const char *names_ = nullptr;
+    const char *postings_ = nullptr;
+
+    // the mapped file's sections and records in bounds, sets the section pointers
+    bool Valid();
+    std::string Name(uint32_t id) const;
+    const TrigramRec *Find(uint32_t key) const;
+    std::vector<uint32_t> Candidates(const std::vector<std::string> &literals, bool &all) const;
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
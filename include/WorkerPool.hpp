@@ -0,0 +1,39 @@
+#ifndef FSTUI_WORKERPOOL_HPP
+#define FSTUI_WORKERPOOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fstui {
+
+  class WorkerPool {
+public:
+    // 0 -> hardware concurrency
+    explicit WorkerPool(unsigned threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    void Submit(std::function<void()> task);
+    // run fn(i) for i in [begin, end), the calling thread helps and returns when all indices are done.
+    // safe to call from inside a pool task.
+    void ParallelFor(size_t begin, size_t end, const std::function<void(size_t)> &fn, size_t grain = 64);
+    unsigned Size() const { return workers_.size(); }
+
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+
+    void Run();
+  };
+}// namespace fstui
+
+#endif
\ No newline at end of file
@@ -26,9 +26,18 @@
 #define STRINGTOOLBOX_HPP
 
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STRINGTOOLBOX_X86 1
+#endif
+
 namespace stringtoolbox {
 
 /**
@@ -91,6 +100,202 @@ inline std::vector<std::string> split(const std::string &str,
   return retVal;
 }
 
+/*
+ * The views below never allocate; they point into the string they were made
+ * from, which has to outlive them.
+ */
+
+/**
+ * @return std::string_view without trailing whitespace characters.
+ */
+inline std::string_view rtrimView(std::string_view str) noexcept {
+  auto pos = str.find_last_not_of(" \t");
+  return str.substr(0, pos == std::string_view::npos ? 0 : pos + 1);
+}
+
+/**
+ * @return std::string_view without leading whitespace characters.
+ */
+inline std::string_view ltrimView(std::string_view str) noexcept {
+  auto pos = str.find_first_not_of(" \t");
+  return str.substr(pos == std::string_view::npos ? str.size() : pos);
+}
+
+/**
+ * @return std::string_view without leading and trailing whitespace characters.
+ */
+inline std::string_view trimView(std::string_view str) noexcept {
+  return ltrimView(rtrimView(str));
+}
+
+namespace detail {
+
+inline const char *findCharScalar(const char *begin, const char *end, char c) noexcept {
+  auto *hit = static_cast<const char *>(std::memchr(begin, c, end - begin));
+  return hit ? hit : end;
+}
+
+inline size_t countCharScalar(const char *begin, const char *end, char c) noexcept {
+  size_t count = 0;
+  for (; begin < end; begin++) count += *begin == c;
+  return count;
+}
+
+#ifdef STRINGTOOLBOX_X86
+__attribute__((target("sse2"))) inline const char *findCharSse2(const char *begin, const char *end, char c) noexcept {
+  auto needle = _mm_set1_epi8(c);
+  for (; begin + 16 <= end; begin += 16) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+    if (mask) return begin + __builtin_ctz(mask);
+  }
+  return findCharScalar(begin, end, c);
+}
+
+__attribute__((target("avx2"))) inline const char *findCharAvx2(const char *begin, const char *end, char c) noexcept {
+  auto needle = _mm256_set1_epi8(c);
+  for (; begin + 32 <= end; begin += 32) {
+    auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+    unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+    if (mask) return begin + __builtin_ctz(mask);
+  }
+  return findCharScalar(begin, end, c);
+}
+
+__attribute__((target("sse2,popcnt"))) inline size_t countCharSse2(const char *begin, const char *end, char c) noexcept {
+  auto needle = _mm_set1_epi8(c);
+  size_t count = 0;
+  for (; begin + 16 <= end; begin += 16) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+    count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+  }
+  return count + countCharScalar(begin, end, c);
+}
+
+__attribute__((target("avx2,popcnt"))) inline size_t countCharAvx2(const char *begin, const char *end, char c) noexcept {
+  auto needle = _mm256_set1_epi8(c);
+  size_t count = 0;
+  for (; begin + 32 <= end; begin += 32) {
+    auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+    count += __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle))));
+  }
+  return count + countCharScalar(begin, end, c);
+}
+#endif
+
+struct Scanner {
+  const char *(*find)(const char *, const char *, char) noexcept = findCharScalar;
+  size_t (*count)(const char *, const char *, char) noexcept = countCharScalar;
+
+  Scanner() noexcept {
+#ifdef STRINGTOOLBOX_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+      find = findCharAvx2;
+      count = countCharAvx2;
+    } else if (__builtin_cpu_supports("sse2") && __builtin_cpu_supports("popcnt")) {
+      find = findCharSse2;
+      count = countCharSse2;
+    }
+#endif
+  }
+};
+
+inline const Scanner &scanner() noexcept {
+  static const Scanner instance;
+  return instance;
+}
+
+} // namespace detail
+
+/**
+ * @return Position of the first c in str, or std::string_view::npos.
+ */
+inline size_t findChar(std::string_view str, char c) noexcept {
+  const char *end = str.data() + str.size();
+  const char *hit = detail::scanner().find(str.data(), end, c);
+  return hit == end ? std::string_view::npos : static_cast<size_t>(hit - str.data());
+}
+
+/**
+ * @return Number of occurrences of c in str.
+ */
+inline size_t countChar(std::string_view str, char c) noexcept {
+  return detail::scanner().count(str.data(), str.data() + str.size(), c);
+}
+
+/**
+ * Lazy counterpart of split: yields the same fields as views, one at a time.
+ */
+class SplitView {
+ public:
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view *;
+    using reference = const std::string_view &;
+
+    iterator() noexcept = default;
+    iterator(std::string_view str, char delimiter) noexcept
+        : rest_{str}, delimiter_{delimiter}, done_{str.empty()} {
+      next();
+    }
+
+    reference operator*() const noexcept { return field_; }
+    pointer operator->() const noexcept { return &field_; }
+    iterator &operator++() noexcept {
+      next();
+      return *this;
+    }
+    iterator operator++(int) noexcept {
+      iterator old{*this};
+      next();
+      return old;
+    }
+    bool operator==(const iterator &other) const noexcept {
+      return end_ == other.end_ && (end_ || field_.data() == other.field_.data());
+    }
+    bool operator!=(const iterator &other) const noexcept { return !(*this == other); }
+
+   private:
+    std::string_view rest_{};
+    std::string_view field_{};
+    char delimiter_{'\0'};
+    bool done_{true};
+    bool end_{true};
+
+    void next() noexcept {
+      end_ = done_;
+      if (done_) return;
+      auto pos = findChar(rest_, delimiter_);
+      if (pos == std::string_view::npos) {
+        field_ = rest_;
+        done_ = true;
+      } else {
+        field_ = rest_.substr(0, pos);
+        rest_ = rest_.substr(pos + 1);
+      }
+    }
+  };
+
+  SplitView(std::string_view str, char delimiter) noexcept : str_{str}, delimiter_{delimiter} {}
+  iterator begin() const noexcept { return iterator(str_, delimiter_); }
+  iterator end() const noexcept { return iterator(); }
+
+ private:
+  std::string_view str_;
+  char delimiter_;
+};
+
+/**
+ * @return SplitView over the fields of str along delimiter.
+ */
+inline SplitView splitView(std::string_view str, char delimiter) noexcept {
+  return SplitView(str, delimiter);
+}
+
 } // namespace stringtoolbox
 
 #endif
@@ -0,0 +1,360 @@
+#include <algorithm>// for min
+#include <cerrno>
+#include <chrono>
+#include <cstdio>  // for snprintf, rename
+#include <cstring> // for memcpy, memset, strerror
+#include <ctime>
+#include <fcntl.h>
+#include <iomanip>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ArchiveExporter.hpp"
+#include "Pattern.hpp"
+
+namespace fstui {
+
+  namespace {
+    constexpr size_t kBuffer = 1 << 20;
+    // templates this large skip the buffer
+    constexpr off_t kDirect = 1 << 20;
+    constexpr size_t kBlock = 512;
+    // tar readers expect whole records of 20 blocks
+    constexpr size_t kRecord = 20 * kBlock;
+    // what mkdir and creat would leave of 0777 and 0666 under the usual umask
+    constexpr mode_t kDirMode = 0755;
+    constexpr mode_t kUmask = 022;
+
+    bool ValidName(std::string_view name) {
+      return !name.empty() && name != "." && name != ".." &&
+             name.find('/') == std::string_view::npos && name.find('\0') == std::string_view::npos;
+    }
+
+    // errors after which copy_file_range is not tried again
+    bool Unsupported(int err) {
+      return err == EXDEV || err == EINVAL || err == ENOSYS || err == EOPNOTSUPP || err == EBADF;
+    }
+
+    // "<length> key=value\n", the length counting itself
+    void PaxRecord(std::string &out, const std::string &key, const std::string &value) {
+      size_t body = key.size() + value.size() + 3;
+      size_t length = body + std::to_string(body).size();
+      if (std::to_string(length).size() != std::to_string(body).size()) length++;
+      out += std::to_string(length) + " " + key + "=" + value + "\n";
+    }
+
+    // width - 1 octal digits and a NUL, false if value needs more
+    bool Octal(char *field, size_t width, uint64_t value) {
+      if (width < 22 && value >> (3 * (width - 1)) != 0) return false;
+      snprintf(field, width, "%0*llo", int(width - 1), (unsigned long long) value);
+      return true;
+    }
+  }// namespace
+
+  struct ArchiveExporter::Writer {
+    int fd = -1;
+    std::vector<char> buffer;
+    size_t used = 0;
+    uint64_t bytes = 0;
+    // of the archive, ends the export
+    int err = 0;
+    // copy_file_range still worth trying
+    bool range = true;
+    uint32_t ino = 0;
+    uid_t uid = getuid();
+    gid_t gid = getgid();
+    int64_t mtime = time(nullptr);
+
+    size_t failed = 0;
+    std::string firstError;
+
+    void Fail(std::string_view name, int e) {
+      failed++;
+      if (firstError.empty()) firstError = std::string(name) + ": " + std::strerror(e);
+    }
+
+    void Flush() {
+      for (size_t done = 0; done < used && !err;) {
+        ssize_t w = write(fd, buffer.data() + done, used - done);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0) err = errno;
+        else done += w;
+      }
+      used = 0;
+    }
+
+    void Put(const char *data, size_t n) {
+      bytes += n;
+      while (n > 0 && !err) {
+        if (used == buffer.size()) Flush();
+        size_t k = std::min(n, buffer.size() - used);
+        memcpy(buffer.data() + used, data, k);
+        used += k;
+        data += k;
+        n -= k;
+      }
+    }
+
+    void Zeros(size_t n) {
+      bytes += n;
+      while (n > 0 && !err) {
+        if (used == buffer.size()) Flush();
+        size_t k = std::min(n, buffer.size() - used);
+        memset(buffer.data() + used, 0, k);
+        used += k;
+        n -= k;
+      }
+    }
+
+    // up to a multiple of align
+    void Pad(size_t align) {
+      if (bytes % align) Zeros(align - bytes % align);
+    }
+
+    // size bytes of src, zeros for what could not be read. returns 0 or the read error
+    int Copy(int src, off_t size) {
+      off_t offset = 0;
+      int readErr = 0;
+      if (size >= kDirect && range) {
+        Flush();
+        while (offset < size && !err) {
+          off64_t in = offset;
+          ssize_t n = copy_file_range(src, &in, fd, nullptr, size - offset, 0);
+          if (n > 0) {
+            offset += n;
+            bytes += n;
+          } else if (n == 0) {
+            readErr = EIO;// template shrank
+            break;
+          } else if (errno != EINTR) {
+            if (Unsupported(errno)) range = false;
+            else err = errno;
+            break;
+          }
+        }
+      }
+      while (offset < size && !err && !readErr) {
+        if (used == buffer.size()) Flush();
+        size_t want = std::min<uint64_t>(buffer.size() - used, size - offset);
+        ssize_t n = pread(src, buffer.data() + used, want, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+          readErr = n < 0 ? errno : EIO;
+          break;
+        }
+        used += n;
+        bytes += n;
+        offset += n;
+      }
+      // the header promised size bytes
+      if (offset < size) Zeros(size - offset);
+      return readErr;
+    }
+  };
+
+  std::wstring ExportStats::Summary() const {
+    std::wostringstream ss;
+    if (cancelled) ss << L"cancelled, ";
+    ss << dirs << L" dirs, " << files << L" files, " << failed << L" failed, "
+       << std::fixed << std::setprecision(1) << bytes / 1048576.0 << L" MiB in "
+       << std::setprecision(2) << seconds << L"s ("
+       << std::setprecision(0) << BytesPerSecond() / 1048576.0 << L" MiB/s)";
+    return ss.str();
+  }
+
+  ArchiveExporter::ArchiveExporter(Format format) : format_(format) {}
+
+  bool ArchiveExporter::ParseFormat(std::string_view name, Format &format) {
+    if (name == "tar") format = TAR;
+    else if (name == "cpio") format = CPIO;
+    else return false;
+    return true;
+  }
+
+  ArchiveExporter::Format ArchiveExporter::FormatFor(const fs::path &path) {
+    return path.extension() == ".cpio" ? CPIO : TAR;
+  }
+
+  ExportStats ArchiveExporter::Run(const std::vector<std::string_view> &entries,
+                                   const std::vector<short> &depths,
+                                   const fs::path &archive,
+                                   TaskProgress *progress,
+                                   const LabelActions *actions) {
+    auto start = std::chrono::steady_clock::now();
+    ExportStats stats;
+    size_t n = ExpandedCount(entries, depths);
+    if (n > kMaxExpanded) {
+      stats.failed = 1;
+      stats.firstError = ExpandedError(n);
+      return stats;
+    }
+    if (progress) progress->SetTotal(n);
+    if (actions && actions->Empty()) actions = nullptr;
+
+    Writer out;
+    bool toStdout = archive == "-";
+    fs::path part = archive.string() + ".part";
+    out.fd = toStdout ? STDOUT_FILENO : open(part.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (out.fd < 0) {
+      stats.firstError = part.string() + ": " + std::strerror(errno);
+      stats.failed = 1;
+      return stats;
+    }
+    out.buffer.resize(kBuffer);
+
+    // path of the row and where each of its ancestors' paths ends in it
+    std::string path;
+    std::vector<size_t> ends;
+    // depth of an invalid entry, its subtree is left out
+    short skip = -1;
+    ForEachExpanded(entries, depths, [&](std::string_view name, short d, size_t source) {
+      stats.nodes++;
+      if (progress) progress->Advance();
+      if (skip >= 0 && d > skip) {
+        out.failed++;// parent missing
+        return true;
+      }
+      skip = -1;
+      // unnormalized depths are clamped to parent + 1
+      size_t depth = std::min<size_t>(d > 0 ? d : 0, ends.size());
+      ends.resize(depth);
+      if (!ValidName(name)) {
+        out.Fail(name, EINVAL);
+        skip = short(depth);
+        return true;
+      }
+      path.resize(depth > 0 ? ends.back() : 0);
+      if (depth > 0) path += '/';
+      path += name;
+      ends.push_back(path.size());
+
+      bool seeded = actions && actions->Has(source);
+      mode_t mode = kDirMode;
+      if (seeded) actions->ModeOf(source, mode);
+      Directory(out, path, mode);
+      stats.dirs++;
+      if (seeded) {
+        actions->ForEachFile(source, [&](const std::string &file, int fd, off_t size, mode_t fileMode) {
+          File(out, path + "/" + file, fd, size, fileMode & ~kUmask);
+        });
+      }
+      return !out.err && !(progress && progress->Cancelled());
+    });
+    stats.cancelled = progress && progress->Cancelled();
+
+    if (!stats.cancelled) {
+      if (format_ == TAR) {
+        out.Zeros(2 * kBlock);
+        out.Pad(kRecord);
+      } else {
+        Header(out, "TRAILER!!!", 0, 0, 0);
+        out.Pad(kBlock);
+      }
+    }
+    out.Flush();
+    if (!toStdout) {
+      if (close(out.fd) != 0 && !out.err) out.err = errno;
+      if (!out.err && !stats.cancelled && std::rename(part.c_str(), archive.c_str()) != 0) out.err = errno;
+      if (out.err || stats.cancelled) unlink(part.c_str());
+    }
+
+    stats.files = out.ino - stats.dirs;
+    stats.failed = out.failed;
+    stats.firstError = out.firstError;
+    if (out.err) {
+      stats.failed++;
+      stats.firstError = (toStdout ? std::string("stdout") : archive.string()) + ": " + std::strerror(out.err);
+    }
+    stats.bytes = out.bytes;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+  }
+
+  void ArchiveExporter::Directory(Writer &out, const std::string &path, mode_t mode) const {
+    Header(out, format_ == TAR ? path + "/" : path, S_IFDIR, mode, 0);
+  }
+
+  void ArchiveExporter::File(Writer &out, const std::string &path, int fd, off_t size, mode_t mode) const {
+    if (format_ == CPIO && uint64_t(size) > 0xffffffffu) {
+      out.Fail(path, EFBIG);
+      return;
+    }
+    Header(out, path, S_IFREG, mode, size);
+    int err = fd >= 0 ? out.Copy(fd, size) : 0;
+    if (err) out.Fail(path, err);
+    out.Pad(format_ == TAR ? kBlock : 4);
+  }
+
+  void ArchiveExporter::Header(Writer &out, const std::string &path, mode_t type, mode_t mode, uint64_t size) const {
+    // the trailer has type 0 and takes no inode
+    uint32_t ino = type ? ++out.ino : 0;
+    if (format_ == CPIO) {
+      char header[111];
+      snprintf(header, sizeof header, "070701%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X",
+               ino, unsigned(type | mode), unsigned(out.uid), unsigned(out.gid), type == S_IFDIR ? 2u : 1u,
+               unsigned(out.mtime), unsigned(size), 0u, 0u, 0u, 0u, unsigned(path.size() + 1), 0u);
+      out.Put(header, 110);
+      out.Put(path.c_str(), path.size() + 1);
+      out.Pad(4);
+      return;
+    }
+
+    // name, or prefix '/' name, or the whole path in a pax header
+    std::string pax;
+    size_t cut = std::string::npos;
+    if (path.size() > 100) {
+      cut = path.find('/', path.size() > 101 ? path.size() - 101 : 0);
+      if (cut == 0 || cut > 155 || cut + 1 >= path.size()) cut = std::string::npos;
+      if (cut == std::string::npos) PaxRecord(pax, "path", path);
+    }
+    bool sizeFits = size < (uint64_t(1) << 33);
+    if (!sizeFits) PaxRecord(pax, "size", std::to_string(size));
+    uid_t uid = out.uid;
+    gid_t gid = out.gid;
+    if (uid > 07777777) {
+      PaxRecord(pax, "uid", std::to_string(uid));
+      uid = 0;
+    }
+    if (gid > 07777777) {
+      PaxRecord(pax, "gid", std::to_string(gid));
+      gid = 0;
+    }
+
+    char block[kBlock] = {};
+    auto put = [&](char flag, mode_t fieldMode, uint64_t fieldSize) {
+      Octal(block + 100, 8, fieldMode);
+      Octal(block + 108, 8, uid);
+      Octal(block + 116, 8, gid);
+      Octal(block + 124, 12, fieldSize);
+      Octal(block + 136, 12, out.mtime);
+      block[156] = flag;
+      memcpy(block + 257, "ustar", 6);
+      memcpy(block + 263, "00", 2);
+      // summed with its own field as spaces
+      memset(block + 148, ' ', 8);
+      unsigned sum = 0;
+      for (size_t i = 0; i < kBlock; i++) sum += (unsigned char) block[i];
+      snprintf(block + 148, 7, "%06o", sum);
+      block[155] = ' ';
+      out.Put(block, kBlock);
+      memset(block, 0, kBlock);
+    };
+
+    if (!pax.empty()) {
+      std::string name = "PaxHeaders/" + path.substr(path.find_last_of('/', path.size() - 2) + 1);
+      memcpy(block, name.data(), std::min<size_t>(name.size(), 100));
+      put('x', 0644, pax.size());
+      out.Put(pax.data(), pax.size());
+      out.Pad(kBlock);
+    }
+    if (cut != std::string::npos) {
+      memcpy(block + 345, path.data(), cut);
+      memcpy(block, path.data() + cut + 1, path.size() - cut - 1);
+    } else {
+      // cut short when the pax header holds it
+      memcpy(block, path.data(), std::min<size_t>(path.size(), 100));
+    }
+    put(type == S_IFDIR ? '5' : '0', mode, sizeFits ? size : 0);
+  }
+}// namespace fstui
\ No newline at end of file
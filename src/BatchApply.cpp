@@ -0,0 +1,190 @@
+#include <algorithm>// for min
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+
+#include "BatchApply.hpp"
+#include "Encoding.hpp"
+#include "LabelActions.hpp"
+#include "Materializer.hpp"
+#include "PresetIO.hpp"
+#include "stringtoolbox.hpp"
+
+namespace fstui {
+  namespace str = stringtoolbox;
+
+  BatchApply::BatchApply(WorkerPool &pool, BatchOptions options)
+      : pool_(pool), options_(options) {}
+
+  bool BatchApply::ReadJobFile(const fs::path &path, std::vector<ApplyJob> &jobs, std::string &error) {
+    std::ifstream file(path.string());
+    if (!file.is_open()) {
+      error = "cannot open " + path.string();
+      return false;
+    }
+    std::string line;
+    size_t lineNo = 0;
+    while (getline(file, line)) {
+      lineNo++;
+      str::trim(line);
+      if (line.empty() || line[0] == '#') continue;
+      auto sep = line.find('\t');
+      if (sep == std::string::npos) sep = line.find(' ');
+      if (sep == std::string::npos) {
+        error = path.string() + ":" + std::to_string(lineNo) + ": expected <preset> <root>";
+        return false;
+      }
+      std::string preset = line.substr(0, sep);
+      std::string root = line.substr(sep + 1);
+      jobs.push_back({str::trim(preset), str::trim(root)});
+    }
+    return true;
+  }
+
+  // device of root, or of its closest existing ancestor
+  static dev_t DeviceOf(const fs::path &root) {
+    std::error_code ec;
+    fs::path p = fs::absolute(root, ec);
+    if (ec) p = root;
+    struct stat st {};
+    for (;;) {
+      if (stat(p.c_str(), &st) == 0) return st.st_dev;
+      if (!p.has_parent_path() || p.parent_path() == p) return 0;
+      p = p.parent_path();
+    }
+  }
+
+  size_t BatchApply::Run(const std::vector<ApplyJob> &jobs, std::ostream &log) {
+    auto start = std::chrono::steady_clock::now();
+
+    // parse every distinct preset once
+    std::map<fs::path, size_t> presetIds;
+    std::vector<fs::path> presetPaths;
+    std::vector<size_t> jobPreset(jobs.size());
+    for (size_t i = 0; i < jobs.size(); i++) {
+      auto it = presetIds.emplace(jobs[i].preset, presetPaths.size());
+      if (it.second) presetPaths.push_back(jobs[i].preset);
+      jobPreset[i] = it.first->second;
+    }
+    std::vector<std::shared_ptr<const PresetData>> presets(presetPaths.size());
+    std::vector<std::string> loadErrors(presetPaths.size());
+    // label actions from next to the preset
+    std::vector<std::unique_ptr<LabelActions>> actions(presetPaths.size());
+    std::vector<std::string> actionErrors(presetPaths.size());
+    pool_.ParallelFor(0, presetPaths.size(), [&](size_t i) {
+      presets[i] = graph_.Resolve(presetPaths[i], loadErrors[i]);
+      auto file = LabelActions::FileFor(presetPaths[i].parent_path());
+      std::error_code ec;
+      if (!presets[i] || !fs::exists(file, ec)) return;
+      actions[i] = std::make_unique<LabelActions>();
+      if (actions[i]->Read(file, actionErrors[i])) actions[i]->Bind(presets[i]->labels, presets[i]->labelChecked);
+    }, 1);
+
+    // one queue per filesystem
+    std::vector<dev_t> jobDevice(jobs.size());
+    pool_.ParallelFor(0, jobs.size(), [&](size_t i) { jobDevice[i] = DeviceOf(jobs[i].root); }, 16);
+    struct Device {
+      std::vector<size_t> queue;
+      size_t next = 0;
+      unsigned active = 0;
+    };
+    std::map<dev_t, size_t> deviceIds;
+    std::vector<Device> devices;
+    for (size_t i = 0; i < jobs.size(); i++) {
+      auto it = deviceIds.emplace(jobDevice[i], devices.size());
+      if (it.second) devices.emplace_back();
+      devices[it.first->second].queue.push_back(i);
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t queued = jobs.size();
+    size_t cursor = 0;
+    size_t failedJobs = 0;
+    size_t totalNodes = 0;
+    unsigned perFs = std::max(1u, options_.perFs);
+
+    // round-robin over devices that still have a free slot
+    auto worker = [&]() {
+      Materializer materializer(pool_);
+      Reconciler reconciler(pool_);
+      for (;;) {
+        size_t job = 0, device = 0;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          bool found = false;
+          cv.wait(lock, [&] {
+            if (queued == 0) return true;
+            for (size_t k = 0; k < devices.size(); k++) {
+              device = (cursor + k) % devices.size();
+              auto &d = devices[device];
+              if (d.next < d.queue.size() && d.active < perFs) {
+                found = true;
+                return true;
+              }
+            }
+            return false;
+          });
+          if (!found) return;
+          auto &d = devices[device];
+          job = d.queue[d.next++];
+          d.active++;
+          queued--;
+          cursor = device + 1;
+        }
+
+        size_t preset = jobPreset[job];
+        size_t nodes = 0;
+        std::string summary, error;
+        std::vector<std::string> extras;
+        if (!presets[preset]) {
+          error = loadErrors[preset];
+        } else if (!actionErrors[preset].empty()) {
+          error = actionErrors[preset];
+        } else if (options_.reconcile) {
+          auto stats = reconciler.Run(presets[preset]->entries, presets[preset]->depths, jobs[job].root,
+                                      options_.reconcileOptions, nullptr, actions[preset].get());
+          nodes = stats.nodes;
+          summary = ToUtf8(stats.Summary());
+          extras = std::move(stats.extras);
+          if (stats.failed > 0) error = stats.firstError;
+        } else {
+          auto stats = materializer.Run(presets[preset]->entries, presets[preset]->depths, jobs[job].root, nullptr, actions[preset].get());
+          nodes = stats.nodes;
+          summary = ToUtf8(stats.Summary());
+          if (stats.failed > 0) error = stats.firstError;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        devices[device].active--;
+        totalNodes += nodes;
+        for (auto &extra : extras) log << "extra " << (jobs[job].root / extra).string() << "\n";
+        if (error.empty()) {
+          log << "ok   " << jobs[job].root.string() << ": " << summary << "\n";
+        } else {
+          failedJobs++;
+          log << "FAIL " << jobs[job].root.string() << ": " << error << "\n";
+        }
+        cv.notify_all();
+      }
+    };
+
+    unsigned threads = options_.jobs ? options_.jobs : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<size_t>(threads, std::max<size_t>(1, jobs.size()));
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threads; i++) workers.emplace_back(worker);
+    for (auto &w : workers) w.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    log << jobs.size() << " jobs, " << failedJobs << " failed, " << totalNodes << " nodes in "
+        << std::fixed << std::setprecision(2) << seconds << "s ("
+        << std::setprecision(0) << (seconds > 0 ? totalNodes / seconds : 0) << " nodes/s)" << std::endl;
+    return failedJobs;
+  }
+}// namespace fstui
@@ -0,0 +1,221 @@
+#include <algorithm>// for min
+#include <cstring>  // for memcmp, memcpy
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BinaryPreset.hpp"
+
+namespace fstui {
+
+  namespace {
+    constexpr char kMagic[8] = {'F', 'S', 'T', 'U', 'I', 'D', 'F', 'B'};
+    constexpr uint32_t kVersion = 2;
+
+    int64_t Mtime(const struct stat &st) {
+      return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    }
+
+    // changes on every write, a rewrite keeping size and mtime included
+    int64_t Ctime(const struct stat &st) {
+      return int64_t(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec;
+    }
+  }// namespace
+
+  // sections follow the header, each 8-byte aligned
+  struct BinaryPreset::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t labelCount;
+    uint64_t count;
+    // the .df this was written from
+    uint64_t sourceIno;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    int64_t sourceCtime;
+    uint64_t labelNamesOff, labelNamesSize;// '\0' terminated
+    uint64_t offsetsOff;                   // count + 1 uint32 into the name blob
+    uint64_t namesOff, namesSize;
+    uint64_t depthsOff;// a byte per entry
+    uint64_t labelsOff;// labelCount columns of ceil(count / 64) words
+  };
+
+  BinaryPreset::~BinaryPreset() {
+    Close();
+  }
+
+  fs::path BinaryPreset::SidecarPath(const fs::path &preset) {
+    fs::path sidecar = preset;
+    return sidecar.replace_extension(".dfb");
+  }
+
+  std::shared_ptr<BinaryPreset> BinaryPreset::For(const fs::path &preset) {
+    struct stat st {};
+    if (stat(preset.c_str(), &st) != 0) return nullptr;
+    auto binary = std::make_shared<BinaryPreset>();
+    if (!binary->Open(SidecarPath(preset))) return nullptr;
+    const Header &h = *binary->header_;
+    if (h.sourceIno != uint64_t(st.st_ino) || h.sourceSize != uint64_t(st.st_size) ||
+        h.sourceMtime != Mtime(st) || h.sourceCtime != Ctime(st)) return nullptr;
+    return binary;
+  }
+
+  bool BinaryPreset::Write(const fs::path &preset,
+                           const std::vector<std::string> &labels,
+                           const std::vector<std::string_view> &entries,
+                           const std::vector<short> &depths,
+                           const LabelStore &labelChecked) {
+    struct stat st {};
+    if (stat(preset.c_str(), &st) != 0) return false;
+
+    // layout
+    std::string labelNames;
+    for (auto &l : labels) labelNames.append(l).push_back('\0');
+    std::string names;
+    std::vector<uint32_t> offsets{0};
+    offsets.reserve(entries.size() + 1);
+    for (auto &e : entries) {
+      names += e;
+      if (names.size() > UINT32_MAX) return false;
+      offsets.push_back(names.size());
+    }
+    size_t words = (entries.size() + 63) / 64;
+
+    auto align = [](uint64_t off) { return (off + 7) & ~uint64_t(7); };
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.labelCount = labels.size();
+    header.count = entries.size();
+    header.sourceIno = st.st_ino;
+    header.sourceSize = st.st_size;
+    header.sourceMtime = Mtime(st);
+    header.sourceCtime = Ctime(st);
+    header.labelNamesOff = align(sizeof(Header));
+    header.labelNamesSize = labelNames.size();
+    header.offsetsOff = align(header.labelNamesOff + labelNames.size());
+    header.namesOff = align(header.offsetsOff + offsets.size() * sizeof(uint32_t));
+    header.namesSize = names.size();
+    header.depthsOff = align(header.namesOff + names.size());
+    header.labelsOff = align(header.depthsOff + entries.size());
+
+    std::vector<uint8_t> depthBytes(entries.size(), 0);
+    for (size_t i = 0; i < entries.size() && i < depths.size(); i++) depthBytes[i] = std::min<short>(depths[i], 255);
+
+    fs::path file = SidecarPath(preset), tmp = file;
+    tmp += ".tmp";
+    std::ofstream out(tmp, std::ios::binary);
+    if (!out.is_open()) return false;
+    uint64_t pos = 0;
+    auto put = [&out, &pos](uint64_t off, const void *data, size_t size) {
+      static const char zeros[8] = {};
+      out.write(zeros, off - pos);
+      out.write(static_cast<const char *>(data), size);
+      pos = off + size;
+    };
+    put(0, &header, sizeof(header));
+    put(header.labelNamesOff, labelNames.data(), labelNames.size());
+    put(header.offsetsOff, offsets.data(), offsets.size() * sizeof(uint32_t));
+    put(header.namesOff, names.data(), names.size());
+    put(header.depthsOff, depthBytes.data(), depthBytes.size());
+    std::vector<uint64_t> column(words, 0);
+    for (size_t l = 0; l < labels.size(); l++) {
+      if (l < labelChecked.Labels() && labelChecked.Rows() >= entries.size()) {
+        std::copy(labelChecked.Bits(l), labelChecked.Bits(l) + words, column.begin());
+        if (entries.size() & 63) column[words - 1] &= (uint64_t(1) << (entries.size() & 63)) - 1;
+      } else {
+        std::fill(column.begin(), column.end(), 0);
+      }
+      put(header.labelsOff + l * words * 8, column.data(), words * 8);
+    }
+    out.close();
+
+    std::error_code ec;
+    if (!out.fail()) fs::rename(tmp, file, ec);
+    if (out.fail() || ec) {
+      fs::remove(tmp, ec);
+      return false;
+    }
+    return true;
+  }
+
+  bool BinaryPreset::Open(const fs::path &file) {
+    Close();
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+      close(fd);
+      return false;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    data_ = static_cast<const char *>(map);
+    size_ = st.st_size;
+    header_ = reinterpret_cast<const Header *>(data_);
+
+    const Header &h = *header_;
+    // sections are checked without sums that could wrap, counts are bounded by the file first
+    auto fits = [this](uint64_t off, uint64_t size) { return off <= size_ && size <= size_ - off; };
+    uint64_t words = (h.count + 63) / 64;
+    bool ok = std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 && h.version == kVersion &&
+              h.count < size_ && h.labelCount < size_ &&
+              fits(h.labelNamesOff, h.labelNamesSize) &&
+              fits(h.offsetsOff, (h.count + 1) * sizeof(uint32_t)) &&
+              fits(h.namesOff, h.namesSize) &&
+              fits(h.depthsOff, h.count) &&
+              (h.labelCount == 0 || words == 0 || (h.labelCount <= size_ / 8 / words && fits(h.labelsOff, h.labelCount * words * 8))) &&// aligned past the end without labels
+              h.offsetsOff % alignof(uint32_t) == 0 && h.labelsOff % alignof(uint64_t) == 0;
+    if (!ok) {
+      Close();
+      return false;
+    }
+    offsets_ = reinterpret_cast<const uint32_t *>(data_ + h.offsetsOff);
+    names_ = data_ + h.namesOff;
+    depths_ = reinterpret_cast<const uint8_t *>(data_ + h.depthsOff);
+    labelBits_ = reinterpret_cast<const uint64_t *>(data_ + h.labelsOff);
+    // names are offsets_[i]..offsets_[i + 1], a decreasing pair would read before the names or wrap
+    bool sorted = offsets_[h.count] <= h.namesSize;
+    for (uint64_t i = 0; sorted && i < h.count; i++) sorted = offsets_[i] <= offsets_[i + 1];
+    if (!sorted) {
+      Close();
+      return false;
+    }
+    for (const char *p = data_ + h.labelNamesOff, *end = p + h.labelNamesSize; p < end;) {
+      size_t len = strnlen(p, end - p);
+      labels_.emplace_back(p, len);
+      p += len + 1;
+    }
+    madvise(map, size_, MADV_WILLNEED);
+    return true;
+  }
+
+  void BinaryPreset::Close() {
+    if (data_) munmap(const_cast<char *>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+    header_ = nullptr;
+    labels_.clear();
+  }
+
+  size_t BinaryPreset::Size() const {
+    return header_ ? header_->count : 0;
+  }
+
+  void BinaryPreset::Read(PresetData &data) const {
+    data = PresetData();
+    size_t n = Size();
+    data.labels = labels_;
+    data.entries.reserve(n);
+    data.depths.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+      auto name = Name(i);
+      data.entries.push_back(data.names->Add(name));
+      data.depths.push_back(depths_[i]);
+    }
+    data.labelChecked.Load(labels_.size(), n, labelBits_, (n + 63) / 64);
+  }
+}// namespace fstui
\ No newline at end of file
@@ -0,0 +1,613 @@
+#include <algorithm>// for min, max, reverse
+
+#include "DirTree.hpp"
+
+namespace fstui {
+
+  DirTree::DirTree()
+      : arena_(std::make_shared<NameArena>()), root_(kNone), stash_(std::make_shared<StashMap>()), lazy_(std::make_shared<LazyMap>()),
+        seed_(0x9e3779b9) {}
+
+  void DirTree::SetLabel(NodeId id, size_t label, bool value) {
+    // reading first leaves shared chunks alone when nothing changes
+    if (Label(id, label) == value) return;
+    labels_[label][id >> 6] ^= uint64_t(1) << (id & 63);
+  }
+
+  void DirTree::ToggleLabel(NodeId id, size_t label) {
+    labels_[label][id >> 6] ^= uint64_t(1) << (id & 63);
+  }
+
+  void DirTree::ResetLabels(size_t labels) {
+    labels_.assign(labels, {});
+    for (auto &column : labels_) column.resize((nodes_.size() + 63) >> 6);
+  }
+
+  void DirTree::LoadLabels(size_t labels, const uint64_t *columns, size_t stride) {
+    ResetLabels(labels);
+    size_t n = nodes_.size();
+    for (size_t l = 0; l < labels; l++) {
+      auto &column = labels_[l];
+      for (size_t w = 0; w < column.size() && w < stride; w++) {
+        uint64_t word = columns[l * stride + w];
+        if (w == column.size() - 1 && (n & 63)) word &= (uint64_t(1) << (n & 63)) - 1;
+        if (word) column[w] = word;
+      }
+    }
+  }
+
+  DirTree::StashMap &DirTree::Stash() {
+    if (stash_.use_count() > 1) stash_ = std::make_shared<StashMap>(*stash_);
+    return *stash_;
+  }
+
+  DirTree::LazyMap &DirTree::Lazy() {
+    if (lazy_.use_count() > 1) lazy_ = std::make_shared<LazyMap>(*lazy_);
+    return *lazy_;
+  }
+
+  size_t DirTree::SnapshotBytes() const {
+    size_t chunks = nodes_.Chunks() + names_.Chunks() + ownName_.Chunks() + free_.Chunks();
+    for (auto &column : labels_) chunks += column.Chunks();
+    return sizeof(DirTree) + chunks * (sizeof(std::shared_ptr<void>) + 1);
+  }
+
+  size_t DirTree::CopiedBytes() const {
+    size_t bytes = nodes_.Clones() * nodes_.ChunkBytes() + names_.Clones() * names_.ChunkBytes() +
+                   ownName_.Clones() * ownName_.ChunkBytes() + free_.Clones() * free_.ChunkBytes();
+    for (auto &column : labels_) bytes += column.Clones() * column.ChunkBytes();
+    return bytes;
+  }
+
+  uint32_t DirTree::Random() {
+    // xorshift32, treap priorities only need to be well spread
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+    return seed_;
+  }
+
+  void DirTree::Clear() {
+    nodes_.clear();
+    names_.clear();
+    arena_ = std::make_shared<NameArena>();
+    free_.clear();
+    root_ = kNone;
+    stash_ = std::make_shared<StashMap>();
+    lazy_ = std::make_shared<LazyMap>();
+    source_.reset();
+    binary_.reset();
+    ownName_.clear();
+    ResetLabels(labels_.size());
+  }
+
+  size_t DirTree::Bytes() const {
+    size_t bytes = nodes_.Chunks() * nodes_.ChunkBytes() + free_.Chunks() * free_.ChunkBytes() +
+                   ownName_.Chunks() * ownName_.ChunkBytes() + names_.Chunks() * names_.ChunkBytes();
+    bytes += arena_->Bytes();
+    bytes += (stash_->size() + lazy_->size()) * (sizeof(NodeId) + sizeof(PresetRange) + 2 * sizeof(void *));
+    for (auto &column : labels_) bytes += column.Chunks() * column.ChunkBytes();
+    return bytes;
+  }
+
+  void DirTree::Assign(PresetData &&data,
+                       std::shared_ptr<const PresetSource> source,
+                       const std::vector<PresetRange> &ranges) {
+    Clear();
+    size_t n = data.entries.size();
+    if (data.names) arena_ = std::move(data.names);
+    names_.resize(n);
+    for (size_t i = 0; i < n; i++) names_[i] = data.entries[i];
+    ResetNodes(n, data.depths);
+    const LabelStore &checked = data.labelChecked;
+    if (checked.Rows() == n) {
+      std::vector<uint64_t> columns;
+      size_t stride = (n + 63) >> 6;
+      for (size_t l = 0; l < checked.Labels(); l++) columns.insert(columns.end(), checked.Bits(l), checked.Bits(l) + stride);
+      LoadLabels(checked.Labels(), columns.data(), stride);
+    } else {
+      ResetLabels(checked.Labels());
+    }
+
+    source_ = std::move(source);
+    for (auto &range : ranges) {
+      if (range.row >= n || !source_) continue;
+      nodes_[range.row].hidden = std::max<short>(1, std::min<short>(range.span, kMaxDepth - nodes_[range.row].depth));
+      (*lazy_)[range.row] = range;
+    }
+    std::vector<NodeId> ids(n);
+    for (NodeId id = 0; id < n; id++) ids[id] = id;
+    root_ = Link(ids);
+  }
+
+  void DirTree::Assign(std::shared_ptr<const BinaryPreset> preset) {
+    Clear();
+    size_t n = preset->Size();
+    std::vector<short> depths(n);
+    std::vector<NodeId> ids(n);
+    for (NodeId id = 0; id < n; id++) {
+      depths[id] = preset->Depth(id);
+      ids[id] = id;
+    }
+    ownName_.assign(n, false);
+    ResetNodes(n, depths);
+    LoadLabels(preset->Labels().size(), preset->LabelBits(), (n + 63) / 64);
+    binary_ = std::move(preset);
+    root_ = Link(ids);
+  }
+
+  void DirTree::ResetNodes(size_t n, const std::vector<short> &depths) {
+    nodes_.resize(n);
+    short prev = -1;
+    for (NodeId id = 0; id < n; id++) {
+      short depth = id < depths.size() ? depths[id] : 0;
+      depth = std::max<short>(0, std::min<short>({depth, short(prev + 1), kMaxDepth}));
+      prev = depth;
+      nodes_[id] = {kNone, kNone, kNone, Random(), 1, depth, depth, depth, 0, 0};
+    }
+  }
+
+  std::string_view DirTree::Name(NodeId id) const {
+    if (id < ownName_.size() && !ownName_[id]) return binary_->Name(id);
+    return names_[id];
+  }
+
+  void DirTree::SetName(NodeId id, std::string_view name) {
+    if (id >= names_.size()) names_.resize(id + 1);
+    names_[id] = arena_->Add(name);
+    if (id < ownName_.size()) ownName_[id] = true;
+  }
+
+  bool DirTree::Export(PresetData &data) const {
+    data.entries.clear();
+    data.depths.clear();
+    data.labelChecked.Reset(labels_.size(), 0);
+    data.names = std::make_shared<NameArena>();
+    data.names->Keep(arena_);
+    if (binary_) data.names->Keep(binary_);
+    return Append(root_, 0, data);
+  }
+
+  bool DirTree::Append(NodeId x, int offset, PresetData &data) const {
+    if (x == kNone) return true;
+    const Node &node = nodes_[x];
+    bool read = Append(node.left, offset + node.add, data);
+
+    short depth = node.depth + offset;
+    size_t row = data.entries.size();
+    data.entries.push_back(Name(x));
+    data.depths.push_back(depth);
+    data.labelChecked.PushRow();
+    for (size_t l = 0; l < labels_.size(); l++) {
+      if (Label(x, l)) data.labelChecked.Set(row, l, true);
+    }
+    auto stash = stash_->find(x);
+    if (stash != stash_->end()) read = Append(stash->second, depth, data) && read;
+    auto lazy = lazy_->find(x);
+    if (lazy != lazy_->end() && !LoadPresetRange(*source_, lazy->second, data)) {
+      read = false;
+    } else if (lazy != lazy_->end()) {
+      short prev = depth;
+      for (size_t i = row + 1; i < data.depths.size(); i++) {
+        int relative = data.depths[i] - lazy->second.depth;
+        data.depths[i] = std::max<short>(depth + 1, std::min<int>({depth + relative, prev + 1, kMaxDepth}));
+        prev = data.depths[i];
+      }
+    }
+
+    return Append(node.right, offset + node.add, data) && read;
+  }
+
+  DirTree::NodeId DirTree::At(size_t row) const {
+    NodeId x = root_;
+    while (x != kNone) {
+      size_t left = Count(nodes_[x].left);
+      if (row == left) return x;
+      if (row < left) {
+        x = nodes_[x].left;
+      } else {
+        row -= left + 1;
+        x = nodes_[x].right;
+      }
+    }
+    return kNone;
+  }
+
+  size_t DirTree::Row(NodeId id) const {
+    size_t row = Count(nodes_[id].left);
+    for (NodeId x = id; nodes_[x].parent != kNone; x = nodes_[x].parent) {
+      const Node &p = nodes_[nodes_[x].parent];
+      if (p.right == x) row += Count(p.left) + 1;
+    }
+    return row;
+  }
+
+  short DirTree::Depth(NodeId id) const {
+    int depth = nodes_[id].depth;
+    for (NodeId x = nodes_[id].parent; x != kNone; x = nodes_[x].parent) depth += nodes_[x].add;
+    return depth;
+  }
+
+  short DirTree::DepthAt(size_t row) const {
+    NodeId x = root_;
+    int offset = 0;
+    while (x != kNone) {
+      size_t left = Count(nodes_[x].left);
+      if (row == left) return nodes_[x].depth + offset;
+      offset += nodes_[x].add;
+      if (row < left) {
+        x = nodes_[x].left;
+      } else {
+        row -= left + 1;
+        x = nodes_[x].right;
+      }
+    }
+    return 0;
+  }
+
+  // NAVIGATION
+  size_t DirTree::SubtreeEnd(size_t row) const {
+    size_t end = FirstAtMost(row + 1, DepthAt(row));
+    return end == npos ? Size() : end;
+  }
+
+  size_t DirTree::Parent(size_t row) const {
+    short depth = DepthAt(row);
+    return depth == 0 ? npos : LastAtMost(row, depth - 1);
+  }
+
+  size_t DirTree::PrevSibling(size_t row) const {
+    short depth = DepthAt(row);
+    size_t prev = LastAtMost(row, depth);
+    return prev != npos && DepthAt(prev) == depth ? prev : npos;
+  }
+
+  size_t DirTree::NextSibling(size_t row) const {
+    size_t end = SubtreeEnd(row);
+    return end < Size() && DepthAt(end) == DepthAt(row) ? end : npos;
+  }
+
+  bool DirTree::Continues(size_t row, short depth) const {
+    size_t next = FirstAtMost(row + 1, depth);
+    return next != npos && DepthAt(next) == depth;
+  }
+
+  size_t DirTree::FirstAtMost(size_t from, short depth) const {
+    return FindFirst(root_, 0, 0, from, depth);
+  }
+
+  size_t DirTree::LastAtMost(size_t before, short depth) const {
+    return FindLast(root_, 0, 0, before, depth);
+  }
+
+  // subtrees out of range or deeper than depth throughout are skipped whole
+  size_t DirTree::FindFirst(NodeId x, size_t base, int offset, size_t from, short depth) const {
+    if (x == kNone || base + nodes_[x].size <= from || nodes_[x].minDepth + offset > depth) return npos;
+    const Node &node = nodes_[x];
+    size_t row = FindFirst(node.left, base, offset + node.add, from, depth);
+    if (row != npos) return row;
+    row = base + Count(node.left);
+    if (row >= from && node.depth + offset <= depth) return row;
+    return FindFirst(node.right, row + 1, offset + node.add, from, depth);
+  }
+
+  size_t DirTree::FindLast(NodeId x, size_t base, int offset, size_t before, short depth) const {
+    if (x == kNone || base >= before || nodes_[x].minDepth + offset > depth) return npos;
+    const Node &node = nodes_[x];
+    size_t mid = base + Count(node.left);
+    size_t row = FindLast(node.right, mid + 1, offset + node.add, before, depth);
+    if (row != npos) return row;
+    if (mid < before && node.depth + offset <= depth) return mid;
+    return FindLast(node.left, base, offset + node.add, before, depth);
+  }
+
+  void DirTree::Window(size_t from, size_t count, std::vector<NodeId> &ids, std::vector<short> &depths) const {
+    ids.clear();
+    depths.clear();
+    size_t to = std::min(Size(), from + count);
+    if (from >= to) return;
+    ids.reserve(to - from);
+    depths.reserve(to - from);
+    Collect(root_, 0, 0, from, to, ids, depths);
+  }
+
+  void DirTree::Collect(NodeId x, size_t base, int offset, size_t from, size_t to,
+                        std::vector<NodeId> &ids, std::vector<short> &depths) const {
+    if (x == kNone || base >= to || base + nodes_[x].size <= from) return;
+    const Node &node = nodes_[x];
+    size_t row = base + Count(node.left);
+    Collect(node.left, base, offset + node.add, from, to, ids, depths);
+    if (row >= from && row < to) {
+      ids.push_back(x);
+      depths.push_back(node.depth + offset);
+    }
+    Collect(node.right, row + 1, offset + node.add, from, to, ids, depths);
+  }
+
+  // EDITS
+  bool DirTree::Fit(size_t row, short span, short &depth) const {
+    int upper = row > 0 ? DepthAt(row - 1) + 1 : 0;
+    upper = std::min(upper, kMaxDepth - span);
+    int lower = row < Size() ? std::max(0, DepthAt(row) - 1) : 0;
+    if (lower > upper) return false;
+    depth = std::max(lower, std::min<int>(depth, upper));
+    return true;
+  }
+
+  DirTree::NodeId DirTree::Insert(size_t row, short depth, std::string_view name) {
+    row = std::min(row, Size());
+    Fit(row, 0, depth);
+    NodeId id = Allocate(depth, name);
+    NodeId a, b;
+    Split(root_, row, a, b);
+    root_ = Merge(Merge(a, id), b);
+    nodes_[root_].parent = kNone;
+    return id;
+  }
+
+  void DirTree::Remove(size_t row) {
+    if (row >= Size()) return;
+    size_t end = SubtreeEnd(row);
+    NodeId a, m, b;
+    Split(root_, row, a, b);
+    Split(b, end - row, m, b);
+    root_ = Merge(a, b);
+    if (root_ != kNone) nodes_[root_].parent = kNone;
+    Free(m);
+  }
+
+  size_t DirTree::Move(size_t row, size_t before, short depth) {
+    size_t end = SubtreeEnd(row);
+    if (before > row && before < end) return row;
+    short old = DepthAt(row);
+
+    NodeId a, m, b;
+    Split(root_, row, a, b);
+    Split(b, end - row, m, b);
+    root_ = Merge(a, b);
+
+    // nowhere valid -> back where it was
+    size_t at = before <= row ? before : before - (end - row);
+    if (!Fit(at, nodes_[m].maxDepth - old, depth)) {
+      at = row;
+      depth = old;
+    }
+    Shift(m, depth - old);
+    Split(root_, at, a, b);
+    root_ = Merge(Merge(a, m), b);
+    nodes_[root_].parent = kNone;
+    return at;
+  }
+
+  size_t DirTree::MoveUp(size_t row) {
+    short depth = DepthAt(row);
+    size_t prev = PrevSibling(row);
+    if (prev != npos) return Move(row, prev, depth);
+    if (depth > 0) return Move(row, Parent(row), depth - 1);
+    return row;
+  }
+
+  size_t DirTree::MoveDown(size_t row) {
+    short depth = DepthAt(row);
+    size_t next = NextSibling(row);
+    if (next != npos) return Move(row, SubtreeEnd(next), depth);
+    if (depth > 0) return Move(row, SubtreeEnd(row), depth - 1);
+    return row;
+  }
+
+  bool DirTree::Indent(size_t row, int delta) {
+    short depth = DepthAt(row);
+    row = Move(row, row, depth + delta);
+    return DepthAt(row) != depth;
+  }
+
+  // COLLAPSE
+  void DirTree::Collapse(size_t row) {
+    // children moved under an already collapsed node join its hidden ones
+    if (Collapsed(At(row))) Expand(row);
+    size_t end = SubtreeEnd(row);
+    if (end == row + 1) return;
+    short depth = DepthAt(row);
+
+    NodeId a, x, m, b;
+    Split(root_, row, a, b);
+    Split(b, 1, x, b);
+    Split(b, end - row - 1, m, b);
+    Shift(m, -depth);
+    Stash()[x] = m;
+    nodes_[x].hidden = nodes_[m].maxDepth;
+    Pull(x);
+    root_ = Merge(Merge(a, x), b);
+    nodes_[root_].parent = kNone;
+  }
+
+  bool DirTree::Expand(size_t row) {
+    NodeId id = At(row);
+    if (id == kNone || !Collapsed(id)) return true;
+    short depth = DepthAt(row);
+
+    // first expansion, parse the children out of the source. deep ones stay there if they are many.
+    // if the file changed under the tree, row stays collapsed and Export keeps failing until it is loaded again
+    auto lazy = lazy_->find(id);
+    PresetRange range{};
+    PresetData data;
+    std::vector<PresetRange> ranges;
+    bool fromSource = lazy != lazy_->end();
+    if (fromSource) {
+      range = lazy->second;
+      data.labelChecked.Reset(labels_.size(), 0);
+      if (!ScanPresetRange(*source_, range, kScanBudget, data, ranges)) return false;
+    }
+
+    NodeId m = kNone;
+    auto stash = stash_->find(id);
+    if (stash != stash_->end()) {
+      m = stash->second;
+      Stash().erase(id);
+    }
+    if (fromSource) {
+      Lazy().erase(id);
+      std::vector<NodeId> ids;
+      ids.reserve(data.entries.size());
+      short prev = 0;
+      for (size_t i = 0; i < data.entries.size(); i++) {
+        short child = std::max<short>(1, std::min<int>({data.depths[i] - range.depth, prev + 1, kMaxDepth - depth}));
+        prev = child;
+        NodeId childId = Allocate(child, data.entries[i]);
+        for (size_t l = 0; l < labels_.size(); l++) {
+          if (data.labelChecked.Get(i, l)) SetLabel(childId, l, true);
+        }
+        ids.push_back(childId);
+      }
+      for (auto &sub : ranges) {
+        nodes_[ids[sub.row]].hidden = std::max<short>(1, std::min<int>(sub.span, kMaxDepth - depth - nodes_[ids[sub.row]].depth));
+        Lazy()[ids[sub.row]] = sub;
+      }
+      m = Link(ids);
+    }
+    Shift(m, depth);
+
+    NodeId a, x, b;
+    Split(root_, row, a, b);
+    Split(b, 1, x, b);
+    nodes_[x].hidden = 0;
+    Pull(x);
+    root_ = Merge(Merge(Merge(a, x), m), b);
+    nodes_[root_].parent = kNone;
+    return true;
+  }
+
+  // TREAP
+  DirTree::NodeId DirTree::Allocate(short depth, std::string_view name) {
+    NodeId id;
+    if (!free_.empty()) {
+      id = free_.back();
+      free_.pop_back();
+      SetName(id, name);
+    } else {
+      id = nodes_.size();
+      nodes_.push_back(Node{});
+      SetName(id, name);
+      if (id % 64 == 0) {
+        for (auto &column : labels_) column.push_back(0);
+      }
+    }
+    nodes_[id] = {kNone, kNone, kNone, Random(), 1, depth, depth, depth, 0, 0};
+    return id;
+  }
+
+  // cartesian tree: a node's left subtree is the run of lower priorities popped before it.
+  // a node leaves the stack once its subtree is complete, which is when it gets pulled.
+  DirTree::NodeId DirTree::Link(const std::vector<NodeId> &ids) {
+    std::vector<NodeId> stack;
+    for (NodeId id : ids) {
+      NodeId last = kNone;
+      while (!stack.empty() && nodes_[stack.back()].prio < nodes_[id].prio) {
+        last = stack.back();
+        stack.pop_back();
+        Pull(last);
+      }
+      nodes_[id].left = last;
+      nodes_[id].right = kNone;
+      if (!stack.empty()) nodes_[stack.back()].right = id;
+      stack.push_back(id);
+    }
+    if (stack.empty()) return kNone;
+    NodeId root = stack.front();
+    for (auto it = stack.rbegin(); it != stack.rend(); it++) Pull(*it);
+    nodes_[root].parent = kNone;
+    return root;
+  }
+
+  // proportional to the removed subtree only
+  void DirTree::Free(NodeId x) {
+    std::vector<NodeId> stack;
+    if (x != kNone) stack.push_back(x);
+    while (!stack.empty()) {
+      x = stack.back();
+      stack.pop_back();
+      if (nodes_[x].left != kNone) stack.push_back(nodes_[x].left);
+      if (nodes_[x].right != kNone) stack.push_back(nodes_[x].right);
+      auto stash = stash_->find(x);
+      if (stash != stash_->end()) {
+        if (stash->second != kNone) stack.push_back(stash->second);
+        Stash().erase(x);
+      }
+      if (lazy_->count(x)) Lazy().erase(x);
+      if (x < names_.size() && !names_[x].empty()) names_[x] = {};
+      for (size_t l = 0; l < labels_.size(); l++) SetLabel(x, l, false);
+      free_.push_back(x);
+    }
+  }
+
+  void DirTree::Pull(NodeId x) {
+    Node &node = nodes_[x];
+    node.size = 1;
+    node.minDepth = node.depth;
+    node.maxDepth = node.depth + node.hidden;
+    for (NodeId child : {node.left, node.right}) {
+      if (child == kNone) continue;
+      const Node &c = nodes_[child];
+      node.size += c.size;
+      node.minDepth = std::min<short>(node.minDepth, c.minDepth + node.add);
+      node.maxDepth = std::max<short>(node.maxDepth, c.maxDepth + node.add);
+      nodes_[child].parent = x;
+    }
+  }
+
+  void DirTree::Push(NodeId x) {
+    Node &node = nodes_[x];
+    if (node.add == 0) return;
+    Shift(node.left, node.add);
+    Shift(node.right, node.add);
+    node.add = 0;
+  }
+
+  void DirTree::Shift(NodeId x, int delta) {
+    if (x == kNone || delta == 0) return;
+    Node &node = nodes_[x];
+    node.depth += delta;
+    node.minDepth += delta;
+    node.maxDepth += delta;
+    node.add += delta;
+  }
+
+  // first k rows to a, the rest to b
+  void DirTree::Split(NodeId x, size_t k, NodeId &a, NodeId &b) {
+    if (x == kNone) {
+      a = b = kNone;
+      return;
+    }
+    Push(x);
+    size_t left = Count(nodes_[x].left);
+    if (k <= left) {
+      NodeId l;
+      Split(nodes_[x].left, k, a, l);
+      nodes_[x].left = l;
+      b = x;
+    } else {
+      NodeId r;
+      Split(nodes_[x].right, k - left - 1, r, b);
+      nodes_[x].right = r;
+      a = x;
+    }
+    Pull(x);
+  }
+
+  DirTree::NodeId DirTree::Merge(NodeId a, NodeId b) {
+    if (a == kNone) return b;
+    if (b == kNone) return a;
+    if (nodes_[a].prio > nodes_[b].prio) {
+      Push(a);
+      NodeId r = Merge(nodes_[a].right, b);
+      nodes_[a].right = r;
+      Pull(a);
+      return a;
+    }
+    Push(b);
+    NodeId l = Merge(a, nodes_[b].left);
+    nodes_[b].left = l;
+    Pull(b);
+    return b;
+  }
+}// namespace fstui
\ No newline at end of file
@@ -15,23 +15,30 @@
 #include "ftxui/component/screen_interactive.hpp"// for Component
 #include "ftxui/dom/elements.hpp"                // for operator|, Element, reflect, text, vbox, Elements, focus, nothing, select
 #include "ftxui/screen/box.hpp"                  // for Box
+#include "ftxui/screen/terminal.hpp"             // for Terminal::Size
 #include "ftxui/util/ref.hpp"                    // for Ref
 
 #include "DirTreeBase.hpp"
+#include "Encoding.hpp"
+#include "Pattern.hpp"
 
 namespace fstui {
   using namespace ftxui;
 
-  DirTreeBase::DirTreeBase(std::vector<std::wstring> &entries,
-                           std::vector<short> &depths,
+  // rows kept between the focused entry and the window edge
+  static const int kScrollMargin = 2;
+  static const size_t kHistoryDepth = 1000;
+  static const size_t kHistoryBytes = size_t(128) << 20;
+
+  DirTreeBase::DirTreeBase(DirTree &tree,
                            int &selected,
                            std::vector<ConstStringRef> &labels,
-                           std::vector<std::vector<bool>> &labelChecks,
                            const std::string windowName,
                            Ref<MenuOption> menuOption,
                            Ref<CheckboxOption> checkboxOption)
-      : entries_(entries), depths_(depths), focused_(selected),
-        labels_(labels), labelChecked_(labelChecks), windowName_(windowName.begin(), windowName.end()),
+      : tree_(tree), focused_(selected),
+        labels_(labels), windowName_(windowName.begin(), windowName.end()),
+        historyDepth_(kHistoryDepth), historyBytes_(kHistoryBytes), copiedMark_(0),
         menuOption_(std::move(menuOption)), checkboxOption_(std::move(checkboxOption)) {
     Init();
     // force checkbox style
@@ -41,27 +48,100 @@ namespace fstui {
 
   void DirTreeBase::Init() {
     // AT LEASET ONE ELEMENT
-    if (entries_.empty()) {
-      entries_ = {L"Directory"};
-      depths_ = {0};
+    if (tree_.Empty()) {
       labels_ = std::vector<ConstStringRef>({"Option"});
+      tree_.Clear();
+      tree_.ResetLabels(labels_.size());
+      tree_.Insert(0, 0, "Directory");
       focused_ = 0;
-      labelChecked_ = std::vector<std::vector<bool>>(entries_.size(), std::vector<bool>(labels_.size(), false));
     }
-    UpdatePrefixsAndDepths();
     state_ = States::FOCUSED;
+    scrollTop_ = 0;
     isLabelsFocused_ = false;
     labelBoxes_.resize(labels_.size());
     labelFocused_ = 0;
+    filter_.Clear();
+    filterFocused_ = 0;
+    filterOrigin_ = 0;
+    // a newly loaded tree starts a new history
+    undo_.clear();
+    redo_.clear();
+  }
+
+  void DirTreeBase::SetHistoryLimits(size_t depth, size_t bytes) {
+    historyDepth_ = depth;
+    historyBytes_ = bytes;
+    TrimHistory();
+  }
+
+  // O(n / 64) pointers per snapshot, the edit after it then copies the O(log n) chunks it writes
+  void DirTreeBase::Checkpoint() {
+    Checkpoint({tree_, focused_, tree_.SnapshotBytes()}, tree_.CopiedBytes());
+  }
+
+  void DirTreeBase::Checkpoint(Snapshot &&before, size_t copied) {
+    if (!undo_.empty()) undo_.back().bytes += copied - copiedMark_;
+    copiedMark_ = copied;
+    undo_.push_back(std::move(before));
+    redo_.clear();
+    TrimHistory();
+  }
+
+  // a move with nowhere valid to go puts the subtree back and leaves no undo step
+  size_t DirTreeBase::MoveSubtree(int row, const std::function<size_t()> &move) {
+    Snapshot before{tree_, focused_, tree_.SnapshotBytes()};
+    size_t copied = tree_.CopiedBytes();
+    short depth = tree_.DepthAt(row);
+    size_t at = move();
+    if (at != size_t(row) || tree_.DepthAt(at) != depth) Checkpoint(std::move(before), copied);
+    return at;
+  }
+
+  void DirTreeBase::TrimHistory() {
+    size_t bytes = 0;
+    for (auto &s : undo_) bytes += s.bytes;
+    while (!undo_.empty() && (undo_.size() > historyDepth_ || bytes > historyBytes_)) {
+      bytes -= undo_.front().bytes;
+      undo_.pop_front();
+    }
+  }
+
+  void DirTreeBase::Undo() {
+    if (undo_.empty()) return;
+    redo_.push_back({tree_, focused_, tree_.SnapshotBytes()});
+    tree_ = std::move(undo_.back().tree);
+    focused_ = std::min(undo_.back().focused, (int) tree_.Size() - 1);
+    undo_.pop_back();
+    copiedMark_ = tree_.CopiedBytes();
+    focused_entry() = focused_;
+  }
+
+  void DirTreeBase::Redo() {
+    if (redo_.empty()) return;
+    undo_.push_back({tree_, focused_, tree_.SnapshotBytes()});
+    tree_ = std::move(redo_.back().tree);
+    focused_ = std::min(redo_.back().focused, (int) tree_.Size() - 1);
+    redo_.pop_back();
+    copiedMark_ = tree_.CopiedBytes();
+    focused_entry() = focused_;
   }
 
   Element DirTreeBase::Render() {
+    // reads only, the mutable accessors would unshare the labels from the undo snapshots
+    const DirTree &model = tree_;
     Elements elements;
     bool is_menu_focused = Focused();
-    treeBoxes_.resize(entries_.size());
-    for (int i = 0; i < entries_.size(); i++) {
+    // WINDOW
+    int viewHeight = treeBox_.y_max - treeBox_.y_min + 1;
+    if (viewHeight <= 1) viewHeight = Terminal::Size().dimy;
+    bool filtered = Filtered();
+    int viewFocused = filtered ? filterFocused_ : focused_;
+    ScrollTo(viewFocused, viewHeight);
+    UpdateWindow(viewHeight);
+    int end = scrollTop_ + windowIds_.size();
+    for (int i = scrollTop_; i < end; i++) {
       bool is_selected = (focused_entry() == int(i)) && is_menu_focused && state_ == States::SELECTED;
-      bool is_focused = (focused_ == int(i)) && is_menu_focused && !isLabelsFocused_;
+      bool is_focused = (viewFocused == int(i)) && is_menu_focused && !isLabelsFocused_;
 
       auto style = is_focused ? (is_selected ? menuOption_->style_selected_focused
                                              : menuOption_->style_selected)
@@ -77,52 +157,87 @@ namespace fstui {
         auto beforePos = inputString_.substr(0, inputPosition_);
         auto atPos = inputPosition_ < inputString_.size() ? inputString_.substr(inputPosition_, 1) : L" ";
         auto afterPos = inputPosition_ < (int) inputString_.size() - 1 ? inputString_.substr(inputPosition_ + 1) : L"";
-        elem = hbox(text(prefixs_[i] + beforePos), text(atPos) | underlined, text(afterPos)) | inverted;
+        elem = hbox(text(Prefix(i - scrollTop_) + beforePos), text(atPos) | underlined, text(afterPos)) | inverted;
       } else {
-        elem = text(prefixs_[i] + entries_.at(i));
+        auto id = windowIds_[i - scrollTop_];
+        auto prefix = Prefix(i - scrollTop_) + (tree_.Collapsed(id) ? L"▸ " : L"");
+        // names are UTF-8 in the tree, widened for visible rows only
+        auto utf8 = tree_.Name(id);
+        auto name = FromUtf8(utf8);
+        if (!filtered)
+          elem = text(prefix + name);
+        else if (filter_.Matched(i))
+          elem = hbox(text(prefix), Highlight(name));
+        else// ancestor of a match
+          elem = hbox(text(prefix), text(name) | dim);
+        // a pattern stays one row, with the number of entries it stands for
+        if (utf8.find('{') != std::string_view::npos) {
+          Pattern pattern(utf8);
+          if (pattern.IsPattern()) {
+            auto count = pattern.Count() == SIZE_MAX ? std::wstring(L"many") : std::to_wstring(pattern.Count());
+            elem = hbox(elem, text(L" ×" + count) | dim);
+          }
+        }
       }
 
-      elements.emplace_back(elem | style | focus_management | reflect(treeBoxes_[i]));
+      elements.emplace_back(elem | style | focus_management);
     }
 
     // FOCUSED -> RIGHT PANEL
     Elements labels;
     Elements arrows;
     //      if (state_ == States::FOCUSED) {
-    int padding = std::min(focused_, std::max(0, (int) (entries_.size() - labels_.size())));
+    int focusedRow = viewFocused - scrollTop_;
+    int padding = std::min(focusedRow, std::max(0, (int) (end - scrollTop_ - labels_.size())));
     // space before
     for (int i = 0; i < padding; i++) {
       labels.emplace_back(text(L""));
       arrows.emplace_back(text(L""));
     }
-    for (int i = 0; i <= focused_ - padding; i++) {
+    for (int i = 0; i <= focusedRow - padding; i++) {
       arrows.emplace_back(text(L""));
     }
     arrows.emplace_back(text(L" > "));
     // labels
+    auto focusedId = tree_.At(focused_);
     for (int i = 0; i < labels_.size(); i++) {
       bool is_focused = isLabelsFocused_ && labelFocused_ == i;
       auto style = is_focused ? checkboxOption_->style_focused : checkboxOption_->style_unfocused;
-      auto focus_management = is_focused ? focus : labelChecked_[focused_][i] ? ftxui::select
-                                                                              : ftxui::nothing;
-      labels.emplace_back(hbox(text(labelChecked_[focused_][i] ? checkboxOption_->style_checked
-                                                               : checkboxOption_->style_unchecked),
+      bool is_checked = model.Label(focusedId, i);
+      auto focus_management = is_focused ? focus : is_checked ? ftxui::select
+                                                              : ftxui::nothing;
+      labels.emplace_back(hbox(text(is_checked ? checkboxOption_->style_checked
+                                               : checkboxOption_->style_unchecked),
                                text(*labels_[i]) | style | focus_management) |
                           reflect(labelBoxes_[i]));
     }
     //      }
 
+    auto tree = border(vbox(std::move(elements)) | yflex | reflect(treeBox_));
+    if (state_ == States::FILTERING) {
+      std::wstring count = filter_.Active() ? L"  " + std::to_wstring(filter_.Matches()) + L" matches" : L"";
+      tree = vbox({tree, hbox({text(L"/" + filter_.Query()), text(L" ") | underlined, text(count) | dim})});
+    } else if (!notice_.empty()) {
+      tree = vbox({tree, text(notice_) | dim});
+    }
     if (labels_.size() > 0)
       return window(
               text(windowName_),
               hbox(
-                      {border(vbox(std::move(elements))),
+                      {tree,
                        vbox(std::move(arrows)),
                        border(vbox(std::move(labels)))}));
     else
       return window(
               text(windowName_),
-              hbox({border(vbox(std::move(elements)))}));
+              hbox({tree}));
+  }
+
+  void DirTreeBase::ScrollTo(int entryId, int viewHeight) {
+    int margin = std::min(kScrollMargin, (viewHeight - 1) / 2);
+    if (entryId < scrollTop_ + margin) scrollTop_ = entryId - margin;
+    if (entryId > scrollTop_ + viewHeight - 1 - margin) scrollTop_ = entryId - viewHeight + 1 + margin;
+    scrollTop_ = std::max(0, std::min(scrollTop_, ViewSize() - viewHeight));
   }
 
   bool DirTreeBase::OnEvent(Event event) {
@@ -132,6 +247,7 @@ namespace fstui {
       return OnMouseEvent(event);
     if (!Focused())
       return false;
+    notice_.clear();
 
     // fstui States
     switch (state_) {
@@ -163,28 +279,62 @@ namespace fstui {
             if (event == Event::Character(' ')) {
               TransitState(States::SELECTED);
             } else {
-              AddEntry(focused_ + 1, depths_.size() > 0 ? depths_.at(focused_) + 1 : 0);
+              AddEntry(focused_ + 1, tree_.DepthAt(focused_) + 1);
               MoveFocus(focused_ + 1);
               TransitState(States::EDITING);
             }
           }
         } else if (event == Event::Backspace || event == Event::Delete) {
           RemoveEntry(focused_);
+        } else if (event == Event::Character('u')) {
+          Undo();
+        } else if (event == Event::Special("\x12")) {// ctrl-r
+          Redo();
+        } else if (event == Event::Character('-') && !isLabelsFocused_) {
+          tree_.Collapse(focused_);
+        } else if ((event == Event::Character('+') || event == Event::Character('=')) && !isLabelsFocused_) {
+          if (!tree_.Expand(focused_)) notice_ = L"preset changed on disk, load it again to expand this";
+        } else if (event == Event::Character('/') && !isLabelsFocused_) {
+          filterOrigin_ = focused_;
+          filterFocused_ = 0;
+          filter_.Build(tree_);
+          TransitState(States::FILTERING);
+        } else {
+          return false;
+        }
+        break;
+      case States::FILTERING:
+        if (event == Event::Return) {
+          EndFilter(true);
+        } else if (event == Event::Escape) {
+          EndFilter(false);
+        } else if (event == Event::ArrowDown) {
+          Filtered() ? MoveFilterFocus(filterFocused_ + 1) : MoveFocus(focused_ + 1);
+        } else if (event == Event::ArrowUp) {
+          Filtered() ? MoveFilterFocus(filterFocused_ - 1) : MoveFocus(focused_ - 1);
+        } else if (event == Event::Backspace) {
+          auto query = filter_.Query();
+          if (query.empty()) {
+            EndFilter(false);
+          } else {
+            query.pop_back();
+            SetFilter(query);
+          }
+        } else if (event.is_character()) {
+          SetFilter(filter_.Query() + event.character());
         } else {
           return false;
         }
         break;
       case States::SELECTED:
         if (event == Event::ArrowDown) {
-          MoveEntry(focused_, focused_ + 1);
-          MoveFocus(focused_ + 1);
+          MoveFocus(MoveSubtree(focused_, [&] { return tree_.MoveDown(focused_); }));
         } else if (event == Event::ArrowUp) {
-          MoveEntry(focused_, focused_ - 1);
-          MoveFocus(focused_ - 1);
+          MoveFocus(MoveSubtree(focused_, [&] { return tree_.MoveUp(focused_); }));
         } else if (event == Event::ArrowRight) {
-          MoveDepth(focused_, depths_[focused_] + 1);
+          MoveDepth(focused_, 1);
         } else if (event == Event::ArrowLeft) {
-          MoveDepth(focused_, depths_[focused_] - 1);
+          MoveDepth(focused_, -1);
         } else if (event == Event::Character(' ')) {
           TransitState(States::FOCUSED);
         } else if (event == Event::Return) {
@@ -198,7 +348,11 @@ namespace fstui {
         break;
       case States::EDITING:
         if (event == Event::Return) {
-          entries_[focused_] = inputString_;
+          auto name = ToUtf8(inputString_);
+          if (name != tree_.Name(tree_.At(focused_))) {
+            Checkpoint();
+            tree_.SetName(tree_.At(focused_), name);
+          }
           TransitState(States::FOCUSED);
         } else if (event == Event::Escape) {
           TransitState(States::FOCUSED);
@@ -236,17 +390,24 @@ namespace fstui {
   bool DirTreeBase::OnMouseEvent(Event event) {
     if (!CaptureMouse(event))
       return false;
-    for (int i = 0; i < int(treeBoxes_.size()); ++i) {
-      if (!treeBoxes_[i].Contain(event.mouse().x, event.mouse().y))
-        continue;
+    // rows are one line each, hit test by arithmetic
+    if (treeBox_.Contain(event.mouse().x, event.mouse().y) &&
+        scrollTop_ + event.mouse().y - treeBox_.y_min < ViewSize()) {
+      int i = scrollTop_ + event.mouse().y - treeBox_.y_min;
 
       TakeFocus();
       isLabelsFocused_ = false;
       if (event.mouse().button == Mouse::Left &&
           event.mouse().motion == Mouse::Released) {
+        if (Filtered()) {
+          if (filterFocused_ != i) MoveFilterFocus(i);
+          return true;
+        }
         if (focused_ != i) {
-          if (state_ == States::SELECTED || state_ == States::EDITING) MoveEntry(focused_, i);
-          MoveFocus(i);
+          if (state_ == States::SELECTED || state_ == States::EDITING)
+            MoveEntry(focused_, i);
+          else
+            MoveFocus(i);
           return true;
         }
       }
@@ -262,8 +423,7 @@ namespace fstui {
         MoveLabelFocus(i);
         if (event.mouse().button == Mouse::Left &&
             event.mouse().motion == Mouse::Pressed) {
-          labelChecked_[focused_][i] = !labelChecked_[focused_][i];
-          checkboxOption_->on_change();
+          ToggleLabel(focused_, i);
           return true;
         }
       }
@@ -272,16 +432,17 @@ namespace fstui {
   }
 
   void DirTreeBase::ToggleLabel(int dirId, int labelId) {
-    labelChecked_[dirId][labelId] = !labelChecked_[dirId][labelId];
+    Checkpoint();
+    tree_.ToggleLabel(tree_.At(dirId), labelId);
     checkboxOption_->on_change();
   }
 
   void DirTreeBase::MoveFocus(int dstId) {
-    if (entries_.size() == 0) return;
+    if (tree_.Empty()) return;
 
     auto old_selected = focused_;
 
-    focused_ = (dstId + entries_.size()) % entries_.size();
+    focused_ = (dstId + tree_.Size()) % tree_.Size();
 
     if (focused_ != old_selected) {
       focused_entry() = focused_;
@@ -299,87 +460,133 @@ namespace fstui {
     }
   }
 
+  // FILTER
+  void DirTreeBase::SetFilter(const std::wstring &query) {
+    filter_.SetQuery(query);
+    if (filter_.Best() != FuzzyFilter::npos) MoveFilterFocus(filter_.Best());
+    filterFocused_ = std::min(filterFocused_, std::max(0, ViewSize() - 1));
+  }
+
+  void DirTreeBase::MoveFilterFocus(int dstId) {
+    if (filter_.Size() == 0) return;
+    filterFocused_ = (dstId + filter_.Size()) % filter_.Size();
+    MoveFocus(filter_.Row(filterFocused_));
+  }
+
+  // the focus stays on the match picked, or goes back to where it was
+  void DirTreeBase::EndFilter(bool keep) {
+    if (!keep) MoveFocus(filterOrigin_);
+    filter_.Clear();
+    TransitState(States::FOCUSED);
+  }
+
+  Element DirTreeBase::Highlight(const std::wstring &name) const {
+    auto positions = FuzzyFilter::Positions(name, filter_.Query());
+    Elements parts;
+    size_t from = 0;
+    for (size_t k = 0; k < positions.size();) {
+      // runs of matched characters
+      size_t run = 1;
+      while (k + run < positions.size() && positions[k + run] == positions[k] + run) run++;
+      if (positions[k] > from) parts.push_back(text(name.substr(from, positions[k] - from)));
+      parts.push_back(text(name.substr(positions[k], run)) | underlined | bold);
+      from = positions[k] + run;
+      k += run;
+    }
+    if (from < name.size()) parts.push_back(text(name.substr(from)));
+    return hbox(std::move(parts));
+  }
+
   void DirTreeBase::AddEntry(int dstId, short depth, const std::wstring &content) {
-    entries_.insert(entries_.begin() + dstId, content);
-    depths_.insert(depths_.begin() + dstId, depth);
-    labelChecked_.insert(labelChecked_.begin() + dstId, std::vector<bool>(labels_.size(), false));
-    UpdatePrefixsAndDepths();
+    Checkpoint();
+    tree_.Insert(dstId, depth, ToUtf8(content));
   }
 
+  // the whole subtree moves: in front of a row above, as first child of a row below with children, else after it
   void DirTreeBase::MoveEntry(int srcId, int dstId) {
-    dstId = (dstId + entries_.size()) % entries_.size();
-    // swap
-    std::iter_swap(entries_.begin() + srcId, entries_.begin() + dstId);
-    std::iter_swap(depths_.begin() + srcId, depths_.begin() + dstId);
-    std::iter_swap(prefixs_.begin() + srcId, prefixs_.begin() + dstId);
-    std::iter_swap(labelChecked_.begin() + srcId, labelChecked_.begin() + dstId);
+    dstId = (dstId + tree_.Size()) % tree_.Size();
+    if (dstId >= srcId && dstId < (int) tree_.SubtreeEnd(srcId)) return;
+    short depth = tree_.DepthAt(dstId);
+    if (dstId < srcId) {
+      MoveFocus(MoveSubtree(srcId, [&] { return tree_.Move(srcId, dstId, depth); }));
+    } else {
+      bool hasChildren = (int) tree_.SubtreeEnd(dstId) > dstId + 1;
+      MoveFocus(MoveSubtree(srcId, [&] { return tree_.Move(srcId, dstId + 1, hasChildren ? depth + 1 : depth); }));
+    }
   }
 
   void DirTreeBase::RemoveEntry(int tgtId) {
-    if (entries_.size() <= 1) return;
-    entries_.erase(entries_.begin() + tgtId);
-    depths_.erase(depths_.begin() + tgtId);
-    labelChecked_.erase(labelChecked_.begin() + tgtId);
-    UpdatePrefixsAndDepths();
+    // keep at least one row
+    if (tree_.SubtreeEnd(tgtId) - tgtId >= tree_.Size()) return;
+    Checkpoint();
+    tree_.Remove(tgtId);
 
     // selected overflow
-    if (focused_ > entries_.size() - 1) {
-      MoveFocus(focused_ - 1);
+    if (focused_ > (int) tree_.Size() - 1) {
+      MoveFocus(tree_.Size() - 1);
     }
   }
 
-  void DirTreeBase::MoveDepth(int entryId, short depth) {
-    depths_[entryId] = depth > 0 ? depth : 0;
-    UpdatePrefixsAndDepths(false);
+  void DirTreeBase::MoveDepth(int entryId, int delta) {
+    MoveSubtree(entryId, [&] {
+      tree_.Indent(entryId, delta);
+      return size_t(entryId);
+    });
   }
 
   void DirTreeBase::TransitState(States targetState) {
     if (targetState == state_) return;
 
     if (targetState == States::EDITING) {
-      inputString_ = entries_[focused_];
+      inputString_ = FromUtf8(tree_.Name(tree_.At(focused_)));
       inputPosition_ = inputString_.size();
     }
-
-    UpdatePrefixsAndDepths();
     state_ = targetState;
   }
 
-  // recalc prefixs
-  void DirTreeBase::UpdatePrefixsAndDepths(bool formatDepth) {
-    // depths
-    if (formatDepth) {
-      depths_[0] = 0;
-      for (auto it = depths_.begin() + 1; it < depths_.end(); it++) {
-        if (*it > 1 + *(it - 1)) *it = 1 + *(it - 1);
-      }
+  std::wstring DirTreeBase::Prefix(int windowRow) const {
+    std::wstring prefix;
+    int depth = windowDepths_[windowRow];
+    uint64_t mask = prefixMasks_[windowRow];
+    if (depth == 0) return prefix;
+    prefix.reserve(depth * 4);
+    for (int j = 1; j < depth; j++) {
+      prefix.append(mask >> j & 1 ? L"│   " : L"    ");
     }
+    prefix.append(mask >> depth & 1 ? L"├───" : L"└───");
+    return prefix;
+  }
 
-    // prefixs
-    prefixs_ = std::vector<std::wstring>(entries_.size());
-
-    std::vector<bool> depthVisible(*std::max_element(depths_.begin(), depths_.end()) + 1,
-                                   false);
-
-    auto nextDepth = depths_.back();
-    for (int i = entries_.size() - 1; i >= 0; i--) {
-      auto curDepth = depths_.at(i);
-      // jump branch
-      if (nextDepth < curDepth) {
-        for (auto it = depthVisible.begin() + nextDepth + 1; it <= depthVisible.begin() + curDepth; it++) {
-          *it = false;
-        }
-      }
-      nextDepth = curDepth;
-
-      prefixs_[i] = L"";
-      if (curDepth > 0) {
-        for (int j = 0; j < curDepth - 1; j++) {
-          prefixs_[i].append(depthVisible[j + 1] ? L"│   " : L"    ");
-        }
-        prefixs_[i].append(depthVisible[curDepth] ? L"├───" : L"└───");
-        depthVisible[curDepth] = true;
+  // rows [scrollTop_, scrollTop_ + viewHeight) of the view and their prefix masks.
+  // bit j of a row's mask says whether level j continues below it. the last row asks the tree,
+  // each row above only depends on the next one:
+  // mask(i) = (mask(i + 1) below depth(i + 1) | bit depth(i + 1)) up to depth(i).
+  void DirTreeBase::UpdateWindow(int viewHeight) {
+    bool filtered = Filtered();
+    if (filtered) {
+      windowIds_.clear();
+      windowDepths_.clear();
+      for (int i = scrollTop_; i < std::min(scrollTop_ + viewHeight, ViewSize()); i++) {
+        windowIds_.push_back(tree_.At(filter_.Row(i)));
+        windowDepths_.push_back(filter_.Depth(i));
       }
+    } else {
+      tree_.Window(scrollTop_, viewHeight, windowIds_, windowDepths_);
+    }
+    int size = windowIds_.size();
+    prefixMasks_.assign(size, 0);
+    if (size == 0) return;
+
+    uint64_t &last = prefixMasks_[size - 1];
+    for (short j = 1; j <= windowDepths_[size - 1]; j++) {
+      size_t row = scrollTop_ + size - 1;
+      if (filtered ? filter_.Continues(row, j) : tree_.Continues(row, j)) last |= uint64_t(1) << j;
+    }
+    auto upTo = [](int depth) { return depth >= 63 ? ~uint64_t(0) : (uint64_t(1) << (depth + 1)) - 1; };
+    for (int i = size - 2; i >= 0; i--) {
+      int next = windowDepths_[i + 1];
+      uint64_t mask = ((prefixMasks_[i + 1] & (upTo(next) >> 1)) | (uint64_t(1) << next)) & upTo(windowDepths_[i]);
+      prefixMasks_[i] = mask & ~uint64_t(1);
     }
   }
 }// namespace fstui
\ No newline at end of file
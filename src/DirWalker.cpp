@@ -0,0 +1,241 @@
+#include <algorithm>// for sort
+#include <cerrno>
+#include <cstring>// for strerror, strcmp
+#include <dirent.h>// for DT_DIR, DT_UNKNOWN
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+#include "DirWalker.hpp"
+
+namespace fstui {
+
+  struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+  };
+
+  DirWalker::DirWalker(WalkOptions options)
+      : options_(std::move(options)), root_(nullptr), rootFd_(-1),
+        pending_(0), pushes_(0), openFds_(0), fdBudget_(256),
+        dirCount_(0), entryCount_(0), errorCount_(0), pathExcludes_(false) {
+    for (auto &glob : options_.excludes) {
+      if (glob.find('/') != std::string::npos) pathExcludes_ = true;
+    }
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) fdBudget_ = rl.rlim_cur / 2;
+  }
+
+  bool DirWalker::Walk(const fs::path &root) {
+    rootFd_ = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd_ < 0) {
+      Fail(nullptr, errno);
+      return false;
+    }
+
+    unsigned threads = options_.threads ? options_.threads : std::max(1u, std::thread::hardware_concurrency());
+    workers_.clear();
+    for (unsigned i = 0; i < threads; i++) workers_.emplace_back(new Worker());
+
+    workers_[0]->storage.push_back({nullptr, "", 0, 0, {}, dup(rootFd_)});
+    root_ = &workers_[0]->storage.back();
+    openFds_ = 1;
+    pending_ = 1;
+    workers_[0]->queue.push_back(root_);
+
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < threads; i++) helpers.emplace_back([this, i] { Run(i); });
+    Run(0);
+    for (auto &t : helpers) t.join();
+
+    close(rootFd_);
+    rootFd_ = -1;
+    return true;
+  }
+
+  void DirWalker::Run(size_t self) {
+    for (;;) {
+      // read before looking, a push after it wakes the wait below
+      size_t seen = pushes_;
+      WalkDir *dir = Next(self);
+      if (!dir) {
+        std::unique_lock<std::mutex> lock(parkMutex_);
+        parked_.wait(lock, [&] { return pending_ == 0 || pushes_ != seen; });
+        if (pending_ == 0) return;
+        continue;
+      }
+      Scan(self, dir);
+      if (--pending_ == 0) {
+        std::lock_guard<std::mutex> lock(parkMutex_);
+        parked_.notify_all();
+      }
+    }
+  }
+
+  // own queue LIFO for locality, steal FIFO so thieves take the big, shallow subtrees
+  WalkDir *DirWalker::Next(size_t self) {
+    {
+      auto &own = *workers_[self];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.queue.empty()) {
+        WalkDir *dir = own.queue.back();
+        own.queue.pop_back();
+        return dir;
+      }
+    }
+    for (size_t k = 1; k < workers_.size(); k++) {
+      auto &victim = *workers_[(self + k) % workers_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.queue.empty()) {
+        WalkDir *dir = victim.queue.front();
+        victim.queue.pop_front();
+        return dir;
+      }
+    }
+    return nullptr;
+  }
+
+  void DirWalker::Scan(size_t self, WalkDir *dir) {
+    auto &worker = *workers_[self];
+    int fd = dir->fd;
+    if (fd < 0) {
+      // over the fd budget when queued, reopen from the root
+      fd = openat(rootFd_, RelativePath(dir).c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (fd < 0) {
+        Fail(dir, errno);
+        return;
+      }
+      openFds_++;
+    }
+    dir->fd = -1;
+
+    struct stat st {};
+    if (fstat(fd, &st) == 0) dir->mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+    std::vector<WalkDir *> queued;
+    int err = ReadDir(fd, [&](const char *name, bool isDir) {
+      if (!isDir && !options_.includeFiles) return;
+      if (!options_.excludes.empty() && Excluded(dir, name)) return;
+
+      WalkDir *child = nullptr;
+      if (isDir) {
+        worker.storage.push_back({dir, name, short(dir->depth + 1), 0, {}, -1});
+        child = &worker.storage.back();
+        if (options_.maxDepth < 0 || child->depth <= options_.maxDepth) {
+          if (openFds_ < fdBudget_) {
+            child->fd = openat(fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (child->fd >= 0) openFds_++;
+          }
+          queued.push_back(child);
+        }
+      }
+      dir->children.push_back({name, child});
+    });
+    if (err != 0) Fail(dir, err);
+    close(fd);
+    openFds_--;
+
+    std::sort(dir->children.begin(), dir->children.end(), [](const WalkEntry &a, const WalkEntry &b) {
+      return a.name < b.name;
+    });
+    entryCount_ += dir->children.size();
+    dirCount_++;
+
+    if (!queued.empty()) {
+      pending_ += queued.size();
+      {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.queue.insert(worker.queue.end(), queued.begin(), queued.end());
+      }
+      std::lock_guard<std::mutex> lock(parkMutex_);
+      pushes_++;
+      // one worker per directory, this one takes the next itself
+      if (queued.size() >= workers_.size()) {
+        parked_.notify_all();
+      } else {
+        for (size_t i = 1; i < queued.size(); i++) parked_.notify_one();
+      }
+    }
+  }
+
+  int DirWalker::ReadDir(int fd, const std::function<void(const char *, bool)> &onEntry) {
+    thread_local std::vector<char> buffer(1 << 16);
+    for (;;) {
+      long n = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+      if (n < 0) return errno;
+      if (n == 0) return 0;
+      for (long pos = 0; pos < n;) {
+        auto *ent = reinterpret_cast<LinuxDirent64 *>(buffer.data() + pos);
+        pos += ent->d_reclen;
+        const char *name = ent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+        bool isDir = ent->d_type == DT_DIR;
+        if (ent->d_type == DT_UNKNOWN) {
+          struct stat st {};
+          isDir = fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+        }
+        onEntry(name, isDir);
+      }
+    }
+  }
+
+  bool DirWalker::Excluded(const WalkDir *parent, const std::string &name) const {
+    std::string path;
+    if (pathExcludes_) {
+      path = RelativePath(parent);
+      path = path == "." ? name : path + "/" + name;
+    }
+    for (auto &glob : options_.excludes) {
+      bool onPath = glob.find('/') != std::string::npos;
+      if (fnmatch(glob.c_str(), onPath ? path.c_str() : name.c_str(), 0) == 0) return true;
+    }
+    return false;
+  }
+
+  std::string DirWalker::RelativePath(const WalkDir *dir) const {
+    std::vector<const std::string *> parts;
+    for (auto *d = dir; d && d->parent; d = d->parent) parts.push_back(&d->name);
+    if (parts.empty()) return ".";
+    std::string path;
+    for (auto it = parts.rbegin(); it != parts.rend(); it++) {
+      if (!path.empty()) path.push_back('/');
+      path.append(**it);
+    }
+    return path;
+  }
+
+  void DirWalker::Fail(const WalkDir *dir, int err) {
+    errorCount_++;
+    std::lock_guard<std::mutex> lock(errorMutex_);
+    if (firstError_.empty()) firstError_ = (dir ? RelativePath(dir) : std::string("root")) + ": " + std::strerror(err);
+  }
+
+  void DirWalker::Linearize(NameArena &arena, std::vector<std::string_view> &entries, std::vector<short> &depths) const {
+    entries.clear();
+    depths.clear();
+    if (!root_) return;
+    entries.reserve(entryCount_);
+    depths.reserve(entryCount_);
+
+    std::vector<std::pair<const WalkDir *, size_t>> stack{{root_, 0}};
+    while (!stack.empty()) {
+      auto &top = stack.back();
+      if (top.second == top.first->children.size()) {
+        stack.pop_back();
+        continue;
+      }
+      const WalkEntry &entry = top.first->children[top.second++];
+      entries.push_back(arena.Add(entry.name));
+      depths.push_back(top.first->depth);
+      if (entry.dir && !entry.dir->children.empty()) stack.push_back({entry.dir, 0});
+    }
+  }
+}// namespace fstui
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include <algorithm>// for nth_element, min
+#include <cstdio>   // for swprintf
+
+#include "FrameStats.hpp"
+#include "ftxui/component/component.hpp"// for Make
+#include "ftxui/component/event.hpp"    // for Event, Event::Custom, Event::Special
+
+namespace fstui {
+
+  thread_local size_t threadAllocations = 0;
+
+  namespace {
+    uint64_t Since(FrameStats::Clock::time_point start, FrameStats::Clock::time_point end) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    }
+
+    std::wstring Ms(uint64_t ns) {
+      wchar_t buf[32];
+      swprintf(buf, 32, L"%7.2fms", ns / 1e6);
+      return buf;
+    }
+
+    std::wstring Count(uint64_t n) {
+      wchar_t buf[32];
+      swprintf(buf, 32, L"%7llu", (unsigned long long) n);
+      return buf;
+    }
+  }// namespace
+
+  void FrameStats::Series::Add(uint64_t value) {
+    samples_[next_] = value;
+    next_ = (next_ + 1) % kWindow;
+    count_ = std::min(count_ + 1, kWindow);
+  }
+
+  uint64_t FrameStats::Series::Last() const {
+    return count_ == 0 ? 0 : samples_[(next_ + kWindow - 1) % kWindow];
+  }
+
+  uint64_t FrameStats::Series::Percentile(double q) const {
+    if (count_ == 0) return 0;
+    std::array<uint64_t, kWindow> sorted = samples_;
+    size_t k = std::min(count_ - 1, size_t(q * count_));
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.begin() + count_);
+    return sorted[k];
+  }
+
+  // COMPONENTS
+  class FrameStats::Timed : public ComponentBase {
+public:
+    Timed(Component child, Part *part) : part_(part) { Add(std::move(child)); }
+
+    // transparent to focus
+    Component ActiveChild() override { return children_[0]; }
+    bool Focusable() const override { return children_[0]->Focusable(); }
+
+    Element Render() override {
+      auto start = Clock::now();
+      Element element = children_[0]->Render();
+      part_->render.Add(Since(start, Clock::now()));
+      return element;
+    }
+
+    bool OnEvent(Event event) override {
+      auto start = Clock::now();
+      bool handled = children_[0]->OnEvent(event);
+      part_->event.Add(Since(start, Clock::now()));
+      return handled;
+    }
+
+private:
+    Part *part_;
+  };
+
+  class FrameStats::Top : public ComponentBase {
+public:
+    Top(Component child, FrameStats *stats) : stats_(stats) { Add(std::move(child)); }
+
+    // transparent to focus
+    Component ActiveChild() override { return children_[0]; }
+    bool Focusable() const override { return children_[0]->Focusable(); }
+
+    Element Render() override {
+      auto &s = *stats_;
+      size_t allocs = ThreadAllocations();
+      auto start = Clock::now();
+      Element element = children_[0]->Render();
+      auto end = Clock::now();
+      s.frame_.Add(Since(start, end));
+      s.frameAllocs_.Add(ThreadAllocations() - allocs);
+      if (s.pending_) s.latency_.Add(Since(s.eventAt_, end));
+      s.pending_ = false;
+      if (!s.shown_) return element;
+      return vbox({element | flex, s.Render()});
+    }
+
+    bool OnEvent(Event event) override {
+      auto &s = *stats_;
+      auto start = Clock::now();
+      // posted redraws are not input
+      if (event != Event::Custom && !s.pending_) {
+        s.pending_ = true;
+        s.eventAt_ = start;
+      }
+      if (event == Event::Special("\x10")) {// ctrl-p
+        s.Toggle();
+        return true;
+      }
+      size_t allocs = ThreadAllocations();
+      bool handled = children_[0]->OnEvent(event);
+      s.event_.Add(Since(start, Clock::now()));
+      s.eventAllocs_.Add(ThreadAllocations() - allocs);
+      return handled;
+    }
+
+private:
+    FrameStats *stats_;
+  };
+
+  FrameStats::FrameStats(bool shown) : shown_(shown), pending_(false) {}
+
+  Component FrameStats::Wrap(Component child, const std::string &name) {
+    parts_.push_back(std::make_unique<Part>());
+    parts_.back()->name.assign(name.begin(), name.end());
+    return Make<Timed>(std::move(child), parts_.back().get());
+  }
+
+  Component FrameStats::Root(Component child) {
+    return Make<Top>(std::move(child), this);
+  }
+
+  // HUD
+  Element FrameStats::Render() const {
+    auto row = [](const std::wstring &name, const Series &series, std::wstring (*format)(uint64_t)) {
+      return hbox({text(name) | size(WIDTH, EQUAL, 24),
+                   text(L"last" + format(series.Last())),
+                   text(L"  p50" + format(series.Percentile(0.5))),
+                   text(L"  p99" + format(series.Percentile(0.99)))});
+    };
+    Elements rows;
+    rows.push_back(row(L"frame", frame_, Ms));
+    for (auto &part : parts_) {
+      rows.push_back(row(L"  " + part->name + L" render", part->render, Ms));
+      rows.push_back(row(L"  " + part->name + L" event", part->event, Ms));
+    }
+    rows.push_back(row(L"event", event_, Ms));
+    rows.push_back(row(L"event to frame", latency_, Ms));
+
+    // latency histogram over the window, doubling buckets from 1ms
+    std::array<size_t, 7> buckets{};
+    size_t n = latency_.Count();
+    latency_.ForEach([&buckets](uint64_t ns) {
+      uint64_t ms = ns / 1000000;
+      size_t b = 0;
+      while (b + 1 < buckets.size() && ms >= (uint64_t(1) << b)) b++;
+      buckets[b]++;
+    });
+    Elements histogram;
+    for (size_t b = 0; b < buckets.size(); b++) {
+      std::wstring label = b == 0 ? L"<1" : b + 1 == buckets.size() ? L">=" + std::to_wstring(1 << (b - 1)) : L"<" + std::to_wstring(1 << b);
+      histogram.push_back(vbox({gauge(n ? float(buckets[b]) / n : 0.0f) | size(WIDTH, EQUAL, 8),
+                                text(label + L"ms") | dim}));
+      histogram.push_back(text(L" "));
+    }
+    rows.push_back(hbox(std::move(histogram)));
+
+#ifdef FSTUI_COUNT_ALLOCS
+    rows.push_back(row(L"allocs per frame", frameAllocs_, Count));
+    rows.push_back(row(L"allocs per event", eventAllocs_, Count));
+#endif
+    if (entries_) rows.push_back(text(L"entries " + std::to_wstring(entries_())));
+    rows.push_back(text(L"Ctrl+P to hide") | dim);
+    return window(text(L"HUD"), vbox(std::move(rows)));
+  }
+}// namespace fstui
\ No newline at end of file
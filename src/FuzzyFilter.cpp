@@ -0,0 +1,290 @@
+#include <algorithm>// for fill, min, lower_bound, reverse
+#include <cstring>  // for memcmp
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FSTUI_X86 1
+#endif
+
+#include "Encoding.hpp"
+#include "FuzzyFilter.hpp"
+
+namespace fstui {
+
+  namespace {
+    // per matched character, on top of the base
+    const int32_t kMatch = 16;
+    const int32_t kConsecutive = 8;
+    const int32_t kWordStart = 8;
+    // skipped bytes cost one each, up to
+    const size_t kMaxGap = 8;
+    const uint32_t kNoParent = UINT32_MAX;
+
+    wchar_t Fold(wchar_t c) {
+      return c >= L'A' && c <= L'Z' ? c + (L'a' - L'A') : c;
+    }
+
+    bool IsSeparator(char c) {
+      return c == ' ' || c == '_' || c == '-' || c == '.' || c == '/';
+    }
+
+    // letters and digits get a bit each, everything else shares the rest
+    int BloomBit(unsigned char c) {
+      if (c >= 'a' && c <= 'z') return c - 'a';
+      if (c >= '0' && c <= '9') return 26 + c - '0';
+      return 36 + c % 28;
+    }
+
+    // names_ ends in this many zero bytes, so a 16 byte load from inside any name stays in it
+    const size_t kPadding = 16;
+
+#ifdef FSTUI_X86
+    __attribute__((target("sse2"))) size_t FindByte(const char *name, size_t len, size_t from, char c) {
+      auto needle = _mm_set1_epi8(c);
+      for (; from < len; from += 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(name + from));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask) {
+          size_t at = from + __builtin_ctz(mask);
+          return at < len ? at : FuzzyFilter::npos;
+        }
+      }
+      return FuzzyFilter::npos;
+    }
+#else
+    size_t FindByte(const char *name, size_t len, size_t from, char c) {
+      for (; from < len; from++) {
+        if (name[from] == c) return from;
+      }
+      return FuzzyFilter::npos;
+    }
+#endif
+
+    // first seq in name[from, len), npos if none
+    size_t Find(const char *name, size_t len, size_t from, const std::string &seq) {
+      if (seq.size() == 1) return FindByte(name, len, from, seq[0]);
+      while (from + seq.size() <= len) {
+        size_t at = FindByte(name, len, from, seq[0]);
+        if (at == FuzzyFilter::npos || at + seq.size() > len) break;
+        if (std::memcmp(name + at + 1, seq.data() + 1, seq.size() - 1) == 0) return at;
+        from = at + 1;
+      }
+      return FuzzyFilter::npos;
+    }
+
+    // rows whose bloom has all bits of need, written to out in order, numbered from first
+    size_t SelectScalar(const uint64_t *blooms, size_t n, uint64_t need, uint32_t *out, size_t first = 0) {
+      size_t k = 0;
+      for (size_t i = 0; i < n; i++) {
+        out[k] = first + i;
+        k += (blooms[i] & need) == need;
+      }
+      return k;
+    }
+
+#ifdef FSTUI_X86
+    // shuffles packing the 32-bit lanes set in a 4-bit mask to the front
+    struct PackTable {
+      alignas(16) uint8_t shuffle[16][16];
+
+      PackTable() {
+        for (int m = 0; m < 16; m++) {
+          int k = 0;
+          for (int lane = 0; lane < 4; lane++) {
+            if (!(m >> lane & 1)) continue;
+            for (int b = 0; b < 4; b++) shuffle[m][k * 4 + b] = lane * 4 + b;
+            k++;
+          }
+          for (int b = k * 4; b < 16; b++) shuffle[m][b] = 0x80;
+        }
+      }
+    };
+
+    // branch free, writes up to 3 slots past the count
+    __attribute__((target("avx2"))) size_t SelectAvx2(const uint64_t *blooms, size_t n, uint64_t need, uint32_t *out, size_t first) {
+      static const PackTable table;
+      const __m256i mask = _mm256_set1_epi64x(need);
+      const __m128i lanes = _mm_set_epi32(3, 2, 1, 0);
+      size_t i = 0, k = 0;
+      for (; i + 4 <= n; i += 4) {
+        auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(blooms + i));
+        auto eq = _mm256_cmpeq_epi64(_mm256_and_si256(b, mask), mask);
+        int m = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+        auto rows = _mm_add_epi32(_mm_set1_epi32(first + i), lanes);
+        auto packed = _mm_shuffle_epi8(rows, _mm_load_si128(reinterpret_cast<const __m128i *>(table.shuffle[m])));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + k), packed);
+        k += __builtin_popcount(m);
+      }
+      return k + SelectScalar(blooms + i, n - i, need, out + k, first + i);
+    }
+#endif
+
+    struct Kernels {
+      size_t (*Select)(const uint64_t *, size_t, uint64_t, uint32_t *, size_t) = SelectScalar;
+
+      Kernels() {
+#ifdef FSTUI_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) Select = SelectAvx2;
+#endif
+      }
+    };
+
+    const Kernels &Simd() {
+      static const Kernels kernels;
+      return kernels;
+    }
+  }// namespace
+
+  void FuzzyFilter::Build(const DirTree &tree) {
+    Clear();
+    size_t n = tree.Size();
+    std::vector<DirTree::NodeId> ids;
+    std::vector<short> depths;
+    tree.Window(0, n, ids, depths);
+    offsets_.reserve(n + 1);
+    offsets_.push_back(0);
+    depths_.reserve(n);
+    parents_.reserve(n);
+    blooms_.reserve(n);
+    // last row seen per depth
+    std::vector<uint32_t> last(DirTree::kMaxDepth + 1, kNoParent);
+    for (size_t i = 0; i < n; i++) {
+      // folded in place, the tree holds UTF-8 already
+      size_t at = names_.size();
+      names_ += tree.Name(ids[i]);
+      uint64_t bloom = 0;
+      for (size_t k = at; k < names_.size(); k++) {
+        names_[k] = Fold(names_[k]);
+        bloom |= uint64_t(1) << BloomBit(names_[k]);
+      }
+      offsets_.push_back(names_.size());
+      short depth = std::min(depths[i], short(DirTree::kMaxDepth));
+      depths_.push_back(depth);
+      parents_.push_back(depth > 0 ? last[depth - 1] : kNoParent);
+      last[depth] = i;
+      blooms_.push_back(bloom);
+    }
+    names_.append(kPadding, '\0');
+    marks_.assign(n, 0);
+    generation_ = 0;
+  }
+
+  void FuzzyFilter::Clear() {
+    query_.clear();
+    levels_.clear();
+    spare_.clear();
+    names_.clear();
+    offsets_.clear();
+    depths_.clear();
+    parents_.clear();
+    blooms_.clear();
+    selected_.clear();
+    marks_.clear();
+    rows_.clear();
+    best_ = npos;
+  }
+
+  // levels of the common prefix stay, the rest is narrowed again from there
+  void FuzzyFilter::SetQuery(const std::wstring &query) {
+    size_t common = 0;
+    while (common < query.size() && common < query_.size() && Fold(query[common]) == Fold(query_[common])) common++;
+    while (levels_.size() > common) {
+      spare_.push_back(std::move(levels_.back()));
+      levels_.pop_back();
+    }
+    query_ = query;
+    for (size_t k = common; k < query.size(); k++) Narrow(query[k]);
+    UpdateView();
+  }
+
+  // the greedy match of a longer query extends the one of its prefix, so each candidate goes on from its end
+  void FuzzyFilter::Narrow(wchar_t c) {
+    std::string seq = ToUtf8(std::wstring(1, Fold(c)));
+    bool first = levels_.empty();
+    std::vector<Candidate> next;
+    if (!spare_.empty()) {
+      next = std::move(spare_.back());
+      spare_.pop_back();
+      next.clear();
+    }
+    auto step = [&](uint32_t row, uint32_t from, int32_t score) {
+      const char *name = names_.data() + offsets_[row];
+      size_t len = offsets_[row + 1] - offsets_[row];
+      size_t p = Find(name, len, from, seq);
+      if (p == npos) return;
+      int32_t gain = kMatch - int32_t(std::min(p - from, kMaxGap));
+      if (!first && p == from) gain += kConsecutive;
+      if (p == 0 || IsSeparator(name[p - 1])) gain += kWordStart;
+      next.push_back({row, uint32_t(p + seq.size()), score + gain});
+    };
+    if (first) {
+      selected_.resize(blooms_.size() + 4);
+      size_t count = Simd().Select(blooms_.data(), blooms_.size(), uint64_t(1) << BloomBit(seq[0]), selected_.data(), 0);
+      next.reserve(count);
+      for (size_t i = 0; i < count; i++) step(selected_[i], 0, 0);
+    } else {
+      for (auto &candidate : levels_.back()) step(candidate.row, candidate.end, candidate.score);
+    }
+    levels_.push_back(std::move(next));
+  }
+
+  // matches in row order, each after the ancestors not already placed in front of an earlier match.
+  // an ancestor of a match that is not one of an earlier match comes after that earlier match,
+  // so the rows come out sorted, in O(view) rather than O(n).
+  void FuzzyFilter::UpdateView() {
+    rows_.clear();
+    best_ = npos;
+    if (levels_.empty() || levels_.back().empty()) return;
+
+    generation_ += 2;
+    if (generation_ < 2) {
+      std::fill(marks_.begin(), marks_.end(), 0);
+      generation_ = 2;
+    }
+    // highest score, then the shortest name
+    auto &top = levels_.back();
+    const Candidate *best = &top[0];
+    size_t bestLen = SIZE_MAX;
+    for (auto &c : top) {
+      size_t from = rows_.size();
+      for (uint32_t a = parents_[c.row]; a != kNoParent && marks_[a] < generation_; a = parents_[a]) {
+        marks_[a] = generation_;
+        rows_.push_back(a);
+      }
+      // pushed deepest first
+      if (rows_.size() - from > 1) std::reverse(rows_.begin() + from, rows_.end());
+      marks_[c.row] = generation_ + 1;
+      rows_.push_back(c.row);
+
+      if (c.score >= best->score) {
+        size_t len = offsets_[c.row + 1] - offsets_[c.row];
+        if (c.score > best->score || len < bestLen) {
+          best = &c;
+          bestLen = len;
+        }
+      }
+    }
+    best_ = std::lower_bound(rows_.begin(), rows_.end(), best->row) - rows_.begin();
+  }
+
+  bool FuzzyFilter::Continues(size_t i, short depth) const {
+    for (size_t k = i + 1; k < rows_.size(); k++) {
+      short d = Depth(k);
+      if (d <= depth) return d == depth;
+    }
+    return false;
+  }
+
+  std::vector<size_t> FuzzyFilter::Positions(const std::wstring &name, const std::wstring &query) {
+    std::vector<size_t> positions;
+    size_t from = 0;
+    for (wchar_t q : query) {
+      q = Fold(q);
+      while (from < name.size() && Fold(name[from]) != q) from++;
+      if (from == name.size()) return {};
+      positions.push_back(from++);
+    }
+    return positions;
+  }
+}// namespace fstui
\ No newline at end of file
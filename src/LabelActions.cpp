@@ -0,0 +1,231 @@
+#include <cerrno>
+#include <cstdlib>// for strtoul
+#include <fcntl.h>
+#include <fstream>
+#include <linux/fs.h>// for FICLONE
+#include <sstream>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LabelActions.hpp"
+#include "stringtoolbox.hpp"
+
+namespace fstui {
+  namespace str = stringtoolbox;
+
+  namespace {
+    // errors after which a way of copying is not tried again
+    bool Unsupported(int err) {
+      return err == EXDEV || err == EINVAL || err == ENOSYS || err == EOPNOTSUPP || err == ENOTTY || err == EBADF;
+    }
+
+    // plain read/write for the rest of src from offset
+    int Buffered(int src, int dst, off_t offset, off_t size) {
+      char buffer[1 << 16];
+      while (offset < size) {
+        ssize_t n = pread(src, buffer, sizeof buffer, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return n < 0 ? errno : EIO;
+        for (ssize_t done = 0; done < n;) {
+          ssize_t w = write(dst, buffer + done, n - done);
+          if (w < 0 && errno == EINTR) continue;
+          if (w < 0) return errno;
+          done += w;
+        }
+        offset += n;
+      }
+      return 0;
+    }
+  }// namespace
+
+  LabelActions::~LabelActions() {
+    for (auto &action : actions_) {
+      if (action.fd >= 0) close(action.fd);
+    }
+  }
+
+  bool LabelActions::Read(const fs::path &file, std::string &error) {
+    std::ifstream in(file.string());
+    if (!in.is_open()) {
+      error = "cannot open " + file.string();
+      return false;
+    }
+    std::string line;
+    size_t lineNo = 0;
+    while (getline(in, line)) {
+      lineNo++;
+      str::trim(line);
+      if (line.empty() || line[0] == '#') continue;
+      std::istringstream fields(line);
+      Action action;
+      std::string kind, argument;
+      fields >> action.label >> kind >> argument;
+      auto where = file.string() + ":" + std::to_string(lineNo) + ": ";
+      if (argument.empty()) {
+        error = where + "expected <label> <action> <argument>";
+        return false;
+      }
+      if (kind == "copy") {
+        action.kind = COPY;
+        action.source = file.parent_path() / argument;
+        if (!(fields >> action.name)) action.name = action.source.filename().string();
+        action.fd = open(action.source.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st {};
+        if (action.fd < 0 || fstat(action.fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+          if (action.fd >= 0) close(action.fd);
+          error = where + "cannot read template " + action.source.string();
+          return false;
+        }
+        action.size = st.st_size;
+        action.mode = st.st_mode & 0777;
+        action.clone = std::make_unique<std::atomic<bool>>(true);
+        action.range = std::make_unique<std::atomic<bool>>(true);
+      } else if (kind == "touch") {
+        action.kind = TOUCH;
+        action.name = argument;
+        action.mode = 0666;
+      } else if (kind == "mode") {
+        action.kind = MODE;
+        char *end = nullptr;
+        action.mode = std::strtoul(argument.c_str(), &end, 8);
+        if (*end != '\0' || action.mode > 07777) {
+          error = where + "expected an octal mode";
+          return false;
+        }
+      } else {
+        error = where + "unknown action " + kind;
+        return false;
+      }
+      if (action.kind != MODE && (action.name.empty() || action.name.find('/') != std::string::npos)) {
+        error = where + "file names cannot hold '/'";
+        if (action.fd >= 0) close(action.fd);
+        return false;
+      }
+      actions_.push_back(std::move(action));
+    }
+    return true;
+  }
+
+  void LabelActions::Bind(const std::vector<std::string> &labels, const LabelStore &checked) {
+    bound_.clear();
+    checked_ = &checked;
+    for (size_t l = 0; l < labels.size() && l < checked.Labels(); l++) {
+      for (size_t a = 0; a < actions_.size(); a++) {
+        if (actions_[a].label == labels[l]) bound_.emplace_back(l, a);
+      }
+    }
+  }
+
+  bool LabelActions::Has(size_t row) const {
+    if (row >= checked_->Rows()) return false;
+    for (auto &b : bound_) {
+      if (checked_->Get(row, b.first)) return true;
+    }
+    return false;
+  }
+
+  int LabelActions::Seed(size_t row, int parentFd, const std::string &name, ActionStats &stats) const {
+    int dirFd = -1, err = 0;
+    for (auto &b : bound_) {
+      const Action &action = actions_[b.second];
+      if (action.kind == MODE || !checked_->Get(row, b.first)) continue;
+      if (dirFd < 0) {
+        dirFd = openat(parentFd, name.c_str(), O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (dirFd < 0) return errno;
+      }
+      int e = action.kind == COPY ? Copy(action, dirFd, stats) : 0;
+      if (action.kind == TOUCH) {
+        int fd = openat(dirFd, action.name.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, action.mode);
+        if (fd >= 0) {
+          close(fd);
+          stats.files++;
+        } else if (errno == EEXIST) {
+          stats.existed++;
+        } else {
+          e = errno;
+        }
+      }
+      if (!err) err = e;
+    }
+    if (dirFd >= 0) close(dirFd);
+    return err;
+  }
+
+  int LabelActions::Copy(const Action &action, int dirFd, ActionStats &stats) const {
+    int dst = openat(dirFd, action.name.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, action.mode);
+    if (dst < 0) {
+      if (errno != EEXIST) return errno;
+      stats.existed++;
+      return 0;
+    }
+    int err = 0;
+    off_t offset = 0;
+    bool done = action.size == 0;
+    // shares the template's extents, no data is read or written
+    if (!done && *action.clone) {
+      if (ioctl(dst, FICLONE, action.fd) == 0) {
+        done = true;
+        stats.cloned++;
+      } else if (Unsupported(errno)) {
+        *action.clone = false;
+      }
+    }
+    // in kernel, and offloaded by filesystems that can
+    while (!done && *action.range) {
+      off64_t in = offset;
+      ssize_t n = copy_file_range(action.fd, &in, dst, nullptr, action.size - offset, 0);
+      if (n > 0) {
+        offset += n;
+        done = offset >= action.size;
+      } else if (n == 0) {
+        err = EIO;// template shrank
+        break;
+      } else if (errno != EINTR) {
+        if (!Unsupported(errno)) err = errno;
+        else *action.range = false;
+        break;
+      }
+    }
+    if (!done && !err) err = Buffered(action.fd, dst, offset, action.size);
+    close(dst);
+    if (err) {
+      unlinkat(dirFd, action.name.c_str(), 0);
+      return err;
+    }
+    stats.files++;
+    return 0;
+  }
+
+  int LabelActions::Chmod(size_t row, int parentFd, const std::string &name) const {
+    mode_t mode;
+    if (!ModeOf(row, mode)) return 0;
+    return fchmodat(parentFd, name.c_str(), mode, 0) == 0 ? 0 : errno;
+  }
+
+  bool LabelActions::ModeOf(size_t row, mode_t &mode) const {
+    bool any = false;
+    for (auto &b : bound_) {
+      const Action &action = actions_[b.second];
+      if (action.kind != MODE || !checked_->Get(row, b.first)) continue;
+      any = true;
+      mode = action.mode;
+    }
+    return any;
+  }
+
+  void LabelActions::ForEachFile(size_t row, const std::function<void(const std::string &, int, off_t, mode_t)> &fn) const {
+    // the first one of a name wins, as with O_EXCL in Seed
+    std::vector<const std::string *> seen;
+    for (auto &b : bound_) {
+      const Action &action = actions_[b.second];
+      if (action.kind == MODE || !checked_->Get(row, b.first)) continue;
+      bool dup = false;
+      for (auto name : seen) dup = dup || *name == action.name;
+      if (dup) continue;
+      seen.push_back(&action.name);
+      if (action.kind == COPY) fn(action.name, action.fd, action.size, action.mode);
+      else fn(action.name, -1, 0, action.mode);
+    }
+  }
+}// namespace fstui
\ No newline at end of file
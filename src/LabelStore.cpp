@@ -0,0 +1,206 @@
+#include <algorithm>// for max, copy, swap
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FSTUI_X86 1
+#endif
+
+#include "LabelStore.hpp"
+
+namespace fstui {
+
+  namespace {
+    void AndScalar(uint64_t *dst, const uint64_t *src, size_t n) {
+      for (size_t i = 0; i < n; i++) dst[i] &= src[i];
+    }
+
+    void OrScalar(uint64_t *dst, const uint64_t *src, size_t n) {
+      for (size_t i = 0; i < n; i++) dst[i] |= src[i];
+    }
+
+    size_t PopcountScalar(const uint64_t *src, size_t n) {
+      size_t count = 0;
+      for (size_t i = 0; i < n; i++) count += __builtin_popcountll(src[i]);
+      return count;
+    }
+
+#ifdef FSTUI_X86
+    __attribute__((target("avx2"))) void AndAvx2(uint64_t *dst, const uint64_t *src, size_t n) {
+      size_t i = 0;
+      for (; i + 4 <= n; i += 4) {
+        auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+        auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_and_si256(a, b));
+      }
+      AndScalar(dst + i, src + i, n - i);
+    }
+
+    __attribute__((target("avx2"))) void OrAvx2(uint64_t *dst, const uint64_t *src, size_t n) {
+      size_t i = 0;
+      for (; i + 4 <= n; i += 4) {
+        auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+        auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_or_si256(a, b));
+      }
+      OrScalar(dst + i, src + i, n - i);
+    }
+
+    __attribute__((target("sse2"))) void AndSse2(uint64_t *dst, const uint64_t *src, size_t n) {
+      size_t i = 0;
+      for (; i + 2 <= n; i += 2) {
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_and_si128(a, b));
+      }
+      AndScalar(dst + i, src + i, n - i);
+    }
+
+    __attribute__((target("sse2"))) void OrSse2(uint64_t *dst, const uint64_t *src, size_t n) {
+      size_t i = 0;
+      for (; i + 2 <= n; i += 2) {
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_or_si128(a, b));
+      }
+      OrScalar(dst + i, src + i, n - i);
+    }
+
+    __attribute__((target("popcnt"))) size_t PopcountHw(const uint64_t *src, size_t n) {
+      size_t count = 0;
+      for (size_t i = 0; i < n; i++) count += __builtin_popcountll(src[i]);
+      return count;
+    }
+#endif
+
+    struct Kernels {
+      void (*And)(uint64_t *, const uint64_t *, size_t) = AndScalar;
+      void (*Or)(uint64_t *, const uint64_t *, size_t) = OrScalar;
+      size_t (*Popcount)(const uint64_t *, size_t) = PopcountScalar;
+
+      Kernels() {
+#ifdef FSTUI_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+          And = AndAvx2;
+          Or = OrAvx2;
+        } else if (__builtin_cpu_supports("sse2")) {
+          And = AndSse2;
+          Or = OrSse2;
+        }
+        if (__builtin_cpu_supports("popcnt")) Popcount = PopcountHw;
+#endif
+      }
+    };
+
+    const Kernels &Simd() {
+      static const Kernels kernels;
+      return kernels;
+    }
+  }// namespace
+
+  LabelStore::LabelStore(size_t labels, size_t rows) : labels_(0), rows_(0), stride_(0) {
+    Reset(labels, rows);
+  }
+
+  void LabelStore::Reset(size_t labels, size_t rows) {
+    labels_ = labels;
+    rows_ = rows;
+    stride_ = 0;
+    bits_.clear();
+    Reserve(rows);
+  }
+
+  // columns grow by doubling, rounded to a cache line of words
+  void LabelStore::Reserve(size_t rows) {
+    size_t words = (rows + 63) >> 6;
+    if (stride_ > 0 && words <= stride_) return;
+    size_t stride = std::max<size_t>(8, (std::max(words, stride_ * 2) + 7) & ~size_t(7));
+    std::vector<uint64_t> bits(labels_ * stride, 0);
+    for (size_t l = 0; l < labels_; l++) {
+      std::copy(Column(l), Column(l) + std::min(stride_, stride), bits.data() + l * stride);
+    }
+    bits_.swap(bits);
+    stride_ = stride;
+  }
+
+  void LabelStore::Load(size_t labels, size_t rows, const uint64_t *columns, size_t stride) {
+    Reset(labels, rows);
+    size_t words = std::min(Words(), stride);
+    for (size_t l = 0; l < labels_; l++) {
+      std::copy(columns + l * stride, columns + l * stride + words, Column(l));
+      if (rows_ & 63) Column(l)[Words() - 1] &= (uint64_t(1) << (rows_ & 63)) - 1;
+    }
+  }
+
+  void LabelStore::InsertRow(size_t row) {
+    Reserve(rows_ + 1);
+    size_t first = row >> 6;
+    size_t last = rows_ >> 6;// word of the new last row
+    uint64_t low = (uint64_t(1) << (row & 63)) - 1;
+    for (size_t l = 0; l < labels_; l++) {
+      uint64_t *col = Column(l);
+      for (size_t k = last; k > first; k--) col[k] = col[k] << 1 | col[k - 1] >> 63;
+      col[first] = (col[first] & low) | (col[first] & ~low) << 1;
+    }
+    rows_++;
+  }
+
+  void LabelStore::EraseRow(size_t row) {
+    if (row >= rows_) return;
+    size_t first = row >> 6;
+    size_t last = (rows_ - 1) >> 6;
+    uint64_t low = (uint64_t(1) << (row & 63)) - 1;
+    for (size_t l = 0; l < labels_; l++) {
+      uint64_t *col = Column(l);
+      uint64_t carry = first < last ? col[first + 1] << 63 : 0;
+      col[first] = (col[first] & low) | ((col[first] >> 1) & ~low) | carry;
+      for (size_t k = first + 1; k <= last; k++) col[k] = col[k] >> 1 | (k < last ? col[k + 1] << 63 : 0);
+    }
+    rows_--;
+  }
+
+  void LabelStore::SwapRows(size_t a, size_t b) {
+    for (size_t l = 0; l < labels_; l++) {
+      bool va = Get(a, l), vb = Get(b, l);
+      Set(a, l, vb);
+      Set(b, l, va);
+    }
+  }
+
+  std::vector<uint64_t> LabelStore::Match(const std::vector<size_t> &all, const std::vector<size_t> &any) const {
+    size_t words = Words();
+    std::vector<uint64_t> out(words, ~uint64_t(0));
+    if (rows_ & 63) out[words - 1] = (uint64_t(1) << (rows_ & 63)) - 1;
+    auto &simd = Simd();
+    for (auto l : all) {
+      if (l < labels_) simd.And(out.data(), Column(l), words);
+      else std::fill(out.begin(), out.end(), 0);
+    }
+    if (!any.empty()) {
+      std::vector<uint64_t> either(words, 0);
+      for (auto l : any) {
+        if (l < labels_) simd.Or(either.data(), Column(l), words);
+      }
+      simd.And(out.data(), either.data(), words);
+    }
+    return out;
+  }
+
+  size_t LabelStore::Count(const std::vector<uint64_t> &bits) {
+    return Simd().Popcount(bits.data(), bits.size());
+  }
+
+  std::vector<size_t> LabelStore::RowsOf(const std::vector<uint64_t> &bits) {
+    std::vector<size_t> rows;
+    for (size_t k = 0; k < bits.size(); k++) {
+      for (uint64_t word = bits[k]; word; word &= word - 1) rows.push_back(k * 64 + __builtin_ctzll(word));
+    }
+    return rows;
+  }
+
+  std::vector<size_t> LabelStore::CountPerLabel() const {
+    std::vector<size_t> counts(labels_);
+    for (size_t l = 0; l < labels_; l++) counts[l] = Simd().Popcount(Column(l), Words());
+    return counts;
+  }
+}// namespace fstui
\ No newline at end of file
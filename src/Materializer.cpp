@@ -0,0 +1,218 @@
+#include <algorithm>// for lower_bound, min, max
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>// for strerror
+#include <fcntl.h>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Materializer.hpp"
+#include "NameArena.hpp"
+#include "Pattern.hpp"
+
+namespace fstui {
+
+  struct Materializer::Context {
+    NameArena arena;// expanded names
+    std::vector<std::string_view> names;
+    std::vector<int> parents;             // row of parent, -1 -> root
+    std::vector<bool> hasChildren;
+    std::vector<std::vector<size_t>> levels;// rows of each depth, in pre-order
+    std::vector<int> fds;                 // dir fd of a row while its children are being created
+    std::vector<size_t> sources;          // entry a row was expanded from
+    std::vector<uint8_t> made;            // created or existed, with actions only
+    const LabelActions *actions = nullptr;
+    ActionStats actionStats;
+    int rootFd = -1;
+    size_t slab = 0;
+    TaskProgress *progress = nullptr;
+
+    bool Cancelled() const { return progress && progress->Cancelled(); }
+
+    std::atomic<size_t> created{0};
+    std::atomic<size_t> existed{0};
+    std::atomic<size_t> failed{0};
+    std::mutex errorMutex;
+    std::string firstError;
+
+    void Fail(std::string_view name, int err) {
+      failed++;
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if (firstError.empty()) firstError = std::string(name) + ": " + std::strerror(err);
+    }
+  };
+
+  std::wstring MaterializeStats::Summary() const {
+    std::wostringstream ss;
+    if (cancelled) ss << L"cancelled, ";
+    ss << created << L" created, " << existed << L" existed, " << failed << L" failed";
+    if (files > 0) ss << L", " << files << L" files (" << cloned << L" cloned)";
+    ss << L" in "
+       << std::fixed << std::setprecision(2) << seconds << L"s ("
+       << std::setprecision(0) << NodesPerSecond() << L" nodes/s)";
+    return ss.str();
+  }
+
+  Materializer::Materializer(WorkerPool &pool, mode_t mode) : pool_(pool), mode_(mode) {}
+
+  static bool ValidName(std::string_view name) {
+    return !name.empty() && name != "." && name != ".." &&
+           name.find('/') == std::string_view::npos && name.find('\0') == std::string_view::npos;
+  }
+
+  // raise the soft fd limit and return how many dir fds may be held at once
+  static size_t FdBudget() {
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return 256;
+    if (rl.rlim_cur < rl.rlim_max) {
+      rlimit raised = rl;
+      raised.rlim_cur = rl.rlim_max == RLIM_INFINITY ? 1 << 20 : rl.rlim_max;
+      if (setrlimit(RLIMIT_NOFILE, &raised) == 0) rl = raised;
+    }
+    size_t limit = rl.rlim_cur == RLIM_INFINITY ? 1 << 20 : rl.rlim_cur;
+    return limit > 128 ? limit - 64 : 64;
+  }
+
+  MaterializeStats Materializer::Run(const std::vector<std::string_view> &entries,
+                                     const std::vector<short> &depths,
+                                     const fs::path &root,
+                                     TaskProgress *progress,
+                                     const LabelActions *actions) {
+    auto start = std::chrono::steady_clock::now();
+    MaterializeStats stats;
+    Context ctx;
+    // patterns count as every entry they expand to
+    size_t n = ExpandedCount(entries, depths);
+    ctx.progress = progress;
+    ctx.actions = actions && !actions->Empty() ? actions : nullptr;
+    if (n > kMaxExpanded) {
+      stats.failed = 1;
+      stats.firstError = ExpandedError(n);
+      return stats;
+    }
+    if (progress) progress->SetTotal(n);
+
+    std::error_code ec;
+    fs::create_directories(root, ec);
+    ctx.rootFd = open(root.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (ctx.rootFd < 0) {
+      stats.nodes = n;
+      stats.failed = n;
+      stats.firstError = root.string() + ": " + std::strerror(errno);
+      return stats;
+    }
+
+    // parents and levels, unnormalized depths are clamped to parent + 1
+    std::vector<size_t> stack;
+    ForEachExpanded(entries, depths, [&](std::string_view name, short d, size_t source) {
+      size_t i = ctx.names.size();
+      ctx.names.push_back(ctx.arena.Add(name));
+      if (ctx.actions) ctx.sources.push_back(source);
+      ctx.parents.push_back(-1);
+      ctx.hasChildren.push_back(false);
+      size_t depth = d > 0 ? d : 0;
+      if (stack.size() > depth) stack.resize(depth);
+      if (!stack.empty()) {
+        ctx.parents[i] = stack.back();
+        ctx.hasChildren[stack.back()] = true;
+      }
+      if (ctx.levels.size() <= stack.size()) ctx.levels.resize(stack.size() + 1);
+      ctx.levels[stack.size()].push_back(i);
+      stack.push_back(i);
+      return !ctx.Cancelled();
+    });
+    n = ctx.names.size();
+    ctx.fds.assign(n, -1);
+    if (ctx.actions) ctx.made.assign(n, false);
+
+    // only one slab per level keeps its fds open
+    ctx.slab = std::max<size_t>(64, FdBudget() / (ctx.levels.size() + 1));
+
+    if (n > 0) RunLevel(ctx, 0, 0, ctx.levels[0].size(), n);
+    close(ctx.rootFd);
+
+    stats.nodes = n;
+    stats.created = ctx.created;
+    stats.existed = ctx.existed;
+    stats.failed = ctx.failed;
+    stats.files = ctx.actionStats.files;
+    stats.cloned = ctx.actionStats.cloned;
+    stats.firstError = ctx.firstError;
+    stats.cancelled = ctx.Cancelled();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+  }
+
+  // create levels[level][begin, end), then recurse into their children which all lie before hiRow
+  void Materializer::RunLevel(Context &ctx, size_t level, size_t begin, size_t end, size_t hiRow) {
+    const auto &rows = ctx.levels[level];
+    for (size_t lo = begin; lo < end && !ctx.Cancelled(); lo += ctx.slab) {
+      size_t hi = std::min(end, lo + ctx.slab);
+
+      pool_.ParallelFor(lo, hi, [this, &ctx, &rows](size_t k) {
+        if (ctx.Cancelled()) return;
+        if (ctx.progress) ctx.progress->Advance();
+        size_t row = rows[k];
+        int parent = ctx.parents[row];
+        int dirFd = parent < 0 ? ctx.rootFd : ctx.fds[parent];
+        std::string_view name = ctx.names[row];
+        if (dirFd < 0) {
+          ctx.failed++;// parent missing
+          return;
+        }
+        if (!ValidName(name)) {
+          ctx.Fail(name, EINVAL);
+          return;
+        }
+        if (mkdirat(dirFd, name.data(), mode_) == 0) {
+          ctx.created++;
+        } else if (errno == EEXIST) {
+          ctx.existed++;
+        } else {
+          ctx.Fail(name, errno);
+          return;
+        }
+        if (ctx.actions) ctx.made[row] = true;
+        if (ctx.hasChildren[row]) {
+          ctx.fds[row] = openat(dirFd, name.data(), O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+          if (ctx.fds[row] < 0) ctx.Fail(name, errno);
+        }
+      }, 8);
+
+      if (level + 1 < ctx.levels.size()) {
+        const auto &next = ctx.levels[level + 1];
+        size_t loRow = rows[lo];
+        size_t hiSlabRow = hi < end ? rows[hi] : hiRow;
+        size_t childBegin = std::lower_bound(next.begin(), next.end(), loRow) - next.begin();
+        size_t childEnd = std::lower_bound(next.begin(), next.end(), hiSlabRow) - next.begin();
+        if (childBegin < childEnd) RunLevel(ctx, level + 1, childBegin, childEnd, hiSlabRow);
+      }
+
+      // files first, the mode may take away write access
+      if (ctx.actions) {
+        pool_.ParallelFor(lo, hi, [&ctx, &rows](size_t k) {
+          size_t row = rows[k];
+          size_t source = ctx.sources[row];
+          if (!ctx.made[row] || !ctx.actions->Has(source) || ctx.Cancelled()) return;
+          int parent = ctx.parents[row];
+          int dirFd = parent < 0 ? ctx.rootFd : ctx.fds[parent];
+          std::string name(ctx.names[row]);
+          int err = ctx.actions->Seed(source, dirFd, name, ctx.actionStats);
+          if (!err) err = ctx.actions->Chmod(source, dirFd, name);
+          if (err) ctx.Fail(name, err);
+        }, 8);
+      }
+
+      for (size_t k = lo; k < hi; k++) {
+        int &fd = ctx.fds[rows[k]];
+        if (fd >= 0) close(fd);
+        fd = -1;
+      }
+    }
+  }
+}// namespace fstui
\ No newline at end of file
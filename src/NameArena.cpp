@@ -0,0 +1,26 @@
+#include <algorithm>// for max, min
+#include <cstring>  // for memcpy
+
+#include "NameArena.hpp"
+
+namespace fstui {
+
+  std::string_view NameArena::Add(std::string_view name) {
+    if (name.empty()) return {};
+    size_t need = name.size() + 1;
+    if (need > left_) {
+      size_t size = std::max(blockSize_, need);
+      blocks_.emplace_back(new char[size]);
+      bytes_ += size;
+      next_ = blocks_.back().get();
+      left_ = size;
+      blockSize_ = std::min(blockSize_ * 2, size_t(kMaxBlock));
+    }
+    char *at = next_;
+    std::memcpy(at, name.data(), name.size());
+    at[name.size()] = '\0';
+    next_ += need;
+    left_ -= need;
+    return std::string_view(at, name.size());
+  }
+}// namespace fstui
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include <algorithm>// for max, min
+
+#include "Pattern.hpp"
+
+namespace fstui {
+
+  namespace {
+    // groups past this many values are left literal rather than expanded
+    const size_t kMaxGroup = size_t(1) << 32;
+
+    size_t Multiply(size_t a, size_t b) {
+      size_t out;
+      return __builtin_mul_overflow(a, b, &out) ? SIZE_MAX : out;
+    }
+
+    size_t Add(size_t a, size_t b) {
+      size_t out;
+      return __builtin_add_overflow(a, b, &out) ? SIZE_MAX : out;
+    }
+
+    bool IsLetter(char c) {
+      return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    // an optionally signed decimal, false unless all of text is one
+    bool ParseNumber(std::string_view text, long long &value, bool &padded) {
+      size_t i = !text.empty() && text[0] == '-' ? 1 : 0;
+      if (i >= text.size() || text.size() - i > 18) return false;
+      value = 0;
+      for (size_t k = i; k < text.size(); k++) {
+        if (text[k] < '0' || text[k] > '9') return false;
+        value = value * 10 + (text[k] - '0');
+      }
+      if (i) value = -value;
+      padded = text.size() - i > 1 && text[i] == '0';
+      return true;
+    }
+
+    // rows after row down to the end of its subtree
+    std::vector<size_t> SubtreeEnds(const std::vector<short> &depths, size_t n) {
+      std::vector<size_t> ends(n, n);
+      std::vector<size_t> stack;
+      for (size_t i = 0; i < n; i++) {
+        while (!stack.empty() && depths[stack.back()] >= depths[i]) {
+          ends[stack.back()] = i;
+          stack.pop_back();
+        }
+        stack.push_back(i);
+      }
+      return ends;
+    }
+  }// namespace
+
+  Pattern::Pattern(std::string_view name) : count_(1) {
+    std::string literal;
+    for (size_t i = 0; i < name.size();) {
+      if (name[i] == '\\' && i + 1 < name.size() && (name[i + 1] == '{' || name[i + 1] == '}')) {
+        literal.push_back(name[i + 1]);
+        i += 2;
+        continue;
+      }
+      size_t close = name[i] == '{' ? name.find('}', i + 1) : std::string_view::npos;
+      Group group{};
+      if (close != std::string_view::npos) {
+        std::string_view body = name.substr(i + 1, close - i - 1);
+        if ((ParseRange(body, group) || ParseList(body, group)) && group.count <= kMaxGroup) {
+          literals_.push_back(literal);
+          literal.clear();
+          groups_.push_back(std::move(group));
+          count_ = Multiply(count_, groups_.back().count);
+          i = close + 1;
+          continue;
+        }
+      }
+      literal.push_back(name[i++]);
+    }
+    literals_.push_back(literal);
+  }
+
+  std::string Pattern::Escape(std::string_view name) {
+    std::string out;
+    for (char c : name) {
+      if (c == '{' || c == '}') out.push_back('\\');
+      out.push_back(c);
+    }
+    return out;
+  }
+
+  // a..b or a..b..step, both numbers or both single letters
+  bool Pattern::ParseRange(std::string_view body, Group &group) {
+    size_t dots = body.find("..");
+    if (dots == std::string_view::npos || dots == 0) return false;
+    std::string_view from = body.substr(0, dots), to = body.substr(dots + 2);
+    long long step = 1;
+    size_t stepDots = to.find("..");
+    if (stepDots != std::string_view::npos) {
+      bool padded;
+      if (!ParseNumber(to.substr(stepDots + 2), step, padded) || step == 0) return false;
+      step = step < 0 ? -step : step;
+      to = to.substr(0, stepDots);
+    }
+    if (to.empty()) return false;
+
+    long long first, last;
+    bool padFirst, padLast;
+    if (ParseNumber(from, first, padFirst) && ParseNumber(to, last, padLast)) {
+      group.kind = Group::NUMBER;
+      group.width = padFirst || padLast ? std::max(from.size(), to.size()) : 0;
+    } else if (from.size() == 1 && to.size() == 1 && IsLetter(from[0]) && IsLetter(to[0])) {
+      group.kind = Group::LETTER;
+      group.width = 0;
+      first = from[0];
+      last = to[0];
+    } else {
+      return false;
+    }
+    unsigned long long span = first <= last ? last - first : first - last;
+    group.first = first;
+    group.step = first <= last ? step : -step;
+    group.count = span / step + 1;
+    return true;
+  }
+
+  // two or more items between commas, any of them may be empty
+  bool Pattern::ParseList(std::string_view body, Group &group) {
+    if (body.find(',') == std::string_view::npos || body.find('{') != std::string_view::npos) return false;
+    group.kind = Group::LIST;
+    group.items.clear();
+    size_t from = 0;
+    for (size_t comma; (comma = body.find(',', from)) != std::string_view::npos; from = comma + 1) {
+      group.items.emplace_back(body.substr(from, comma - from));
+    }
+    group.items.emplace_back(body.substr(from));
+    group.count = group.items.size();
+    return true;
+  }
+
+  void Pattern::Append(const Group &group, size_t k, std::string &out) const {
+    if (group.kind == Group::LIST) {
+      out += group.items[k];
+      return;
+    }
+    long long value = group.first + (long long) k * group.step;
+    if (group.kind == Group::LETTER) {
+      out.push_back(char(value));
+      return;
+    }
+    std::string digits = std::to_string(value < 0 ? -value : value);
+    int pad = group.width - int(digits.size()) - (value < 0 ? 1 : 0);
+    if (value < 0) out.push_back('-');
+    if (pad > 0) out.append(pad, '0');
+    out += digits;
+  }
+
+  std::string Pattern::At(size_t i) const {
+    // mixed radix, last group fastest
+    std::vector<size_t> digits(groups_.size());
+    for (size_t g = groups_.size(); g-- > 0;) {
+      digits[g] = i % groups_[g].count;
+      i /= groups_[g].count;
+    }
+    std::string out = literals_[0];
+    for (size_t g = 0; g < groups_.size(); g++) {
+      Append(groups_[g], digits[g], out);
+      out += literals_[g + 1];
+    }
+    return out;
+  }
+
+  void ForEachExpanded(const std::vector<std::string_view> &entries,
+                       const std::vector<short> &depths,
+                       const std::function<bool(std::string_view name, short depth, size_t row)> &fn) {
+    size_t n = std::min(entries.size(), depths.size());
+    auto ends = SubtreeEnds(depths, n);
+    // rows [begin, end), false once fn stopped. recursion only goes as deep as patterns nest.
+    std::function<bool(size_t, size_t)> walk = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        if (entries[i].find_first_of("{\\") == std::string_view::npos) {
+          if (!fn(entries[i], depths[i], i)) return false;
+          continue;
+        }
+        // without groups the name is only unescaped
+        Pattern pattern(entries[i]);
+        if (!pattern.IsPattern()) {
+          if (!fn(pattern.At(0), depths[i], i)) return false;
+          continue;
+        }
+        for (size_t k = 0; k < pattern.Count(); k++) {
+          if (!fn(pattern.At(k), depths[i], i) || !walk(i + 1, ends[i])) return false;
+        }
+        i = ends[i] - 1;
+      }
+      return true;
+    };
+    walk(0, n);
+  }
+
+  size_t ExpandedCount(const std::vector<std::string_view> &entries, const std::vector<short> &depths) {
+    size_t n = std::min(entries.size(), depths.size());
+    auto ends = SubtreeEnds(depths, n);
+    std::function<size_t(size_t, size_t)> count = [&](size_t begin, size_t end) {
+      size_t total = 0;
+      for (size_t i = begin; i < end; i++) {
+        size_t copies = entries[i].find('{') == std::string_view::npos ? 1 : Pattern(entries[i]).Count();
+        if (copies == 1) {
+          total = Add(total, 1);
+          continue;
+        }
+        total = Add(total, Multiply(copies, Add(1, count(i + 1, ends[i]))));
+        i = ends[i] - 1;
+      }
+      return total;
+    };
+    return count(0, n);
+  }
+
+  std::string ExpandedError(size_t count) {
+    return "patterns expand to " + (count == SIZE_MAX ? std::string("too many") : std::to_string(count)) +
+           " entries, at most " + std::to_string(kMaxExpanded) + " are allowed";
+  }
+}// namespace fstui
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include <sys/stat.h>
+
+#include "BinaryPreset.hpp"
+#include "PresetCache.hpp"
+#include "PresetIO.hpp"
+
+namespace fstui {
+
+  PresetCache::PresetCache(WorkerPool &pool, size_t budget) : pool_(pool), budget_(budget), bytes_(0) {}
+
+  PresetCache::~PresetCache() {
+    // prefetches still queued on the pool point back here
+    std::unique_lock<std::mutex> lock(mutex_);
+    parsed_.wait(lock, [this] { return parsing_.empty(); });
+  }
+
+  bool PresetCache::StampOf(const fs::path &path, Stamp &stamp) {
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0) return false;
+    stamp = {uint64_t(st.st_dev), uint64_t(st.st_ino), uint64_t(st.st_size),
+             int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec};
+    return true;
+  }
+
+  std::shared_ptr<PresetModel> PresetCache::Parse(const fs::path &path) {
+    auto model = std::make_shared<PresetModel>();
+    // a fresh .dfb is used in place
+    if (auto binary = BinaryPreset::For(path)) {
+      model->labels = binary->Labels();
+      model->tree.Assign(binary);
+      return model;
+    }
+    auto source = std::make_shared<PresetSource>();
+    if (!source->Open(path)) return nullptr;
+    PresetData data;
+    std::vector<PresetRange> ranges;
+    if (!ScanPreset(*source, kScanBudget, data, ranges)) return nullptr;
+    model->labels = data.labels;
+    model->tree.Assign(std::move(data), source, ranges);
+    return model;
+  }
+
+  std::shared_ptr<const PresetModel> PresetCache::Find(const std::string &key, const Stamp &stamp) {
+    auto it = slots_.find(key);
+    if (it == slots_.end()) return nullptr;
+    if (!(it->second.stamp == stamp)) {
+      bytes_ -= it->second.bytes;
+      lru_.erase(it->second.lru);
+      slots_.erase(it);
+      return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    return it->second.model;
+  }
+
+  void PresetCache::Insert(const std::string &key, const Stamp &stamp, std::shared_ptr<const PresetModel> model) {
+    size_t bytes = model->tree.Bytes() + sizeof(PresetModel);
+    // one that would not fit even alone is handed out uncached
+    if (bytes > budget_) return;
+    auto it = slots_.find(key);
+    if (it != slots_.end()) {
+      bytes_ -= it->second.bytes;
+      lru_.erase(it->second.lru);
+      slots_.erase(it);
+    }
+    lru_.push_front(key);
+    slots_[key] = {stamp, std::move(model), bytes, lru_.begin()};
+    bytes_ += bytes;
+    while (bytes_ > budget_) {
+      auto last = slots_.find(lru_.back());
+      bytes_ -= last->second.bytes;
+      slots_.erase(last);
+      lru_.pop_back();
+    }
+  }
+
+  std::shared_ptr<const PresetModel> PresetCache::Get(const fs::path &path) {
+    Stamp stamp{};
+    if (!StampOf(path, stamp)) return nullptr;
+    std::string key = path.string();
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      // a prefetch of it is as good as done, wait rather than parse twice
+      parsed_.wait(lock, [&] { return !parsing_.count(key); });
+      if (auto model = Find(key, stamp)) return model;
+      parsing_.insert(key);
+    }
+    std::shared_ptr<const PresetModel> model = Parse(path);
+    std::lock_guard<std::mutex> lock(mutex_);
+    parsing_.erase(key);
+    if (model) Insert(key, stamp, model);
+    parsed_.notify_all();
+    return model;
+  }
+
+  void PresetCache::Prefetch(const fs::path &path) {
+    Stamp stamp{};
+    if (!StampOf(path, stamp)) return;
+    std::string key = path.string();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (parsing_.count(key)) return;
+      auto it = slots_.find(key);
+      if (it != slots_.end() && it->second.stamp == stamp) return;
+      parsing_.insert(key);
+    }
+    pool_.Submit([this, path, key, stamp] {
+      std::shared_ptr<const PresetModel> model = Parse(path);
+      std::lock_guard<std::mutex> lock(mutex_);
+      parsing_.erase(key);
+      if (model) Insert(key, stamp, model);
+      parsed_.notify_all();
+    });
+  }
+}// namespace fstui
@@ -0,0 +1,590 @@
+#include <algorithm>// for sort, unique, lower_bound, set_intersection
+#include <cstring>  // for memcpy
+#include <fstream>
+#include <iterator> // for back_inserter
+#include <sys/stat.h>
+
+#include "Pattern.hpp"
+#include "PresetCatalog.hpp"
+#include "PresetIO.hpp"
+#include "stringtoolbox.hpp"
+
+namespace fstui {
+  namespace str = stringtoolbox;
+
+  namespace {
+    constexpr char kMagic[8] = {'F', 'S', 'T', 'U', 'I', 'C', 'A', 'T'};
+    constexpr uint32_t kVersion = 2;
+
+    // term kinds, the first byte of each term
+    constexpr char kName = 'n';   // folded name
+    constexpr char kEdge = 'e';   // folded parent '/' folded name
+    constexpr char kLabeled = 'a';// folded name '/' label
+    constexpr char kLabel = 'l';  // label
+
+    std::string Fold(std::string_view name) {
+      std::string folded(name);
+      for (auto &c : folded) {
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+      }
+      return folded;
+    }
+
+    template<typename T>
+    void Emit(std::string &out, T value) {
+      out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void EmitString(std::string &out, const std::string &s) {
+      Emit<uint32_t>(out, s.size());
+      out += s;
+    }
+
+    void EmitVarint(std::string &out, uint64_t value) {
+      for (; value >= 0x80; value >>= 7) out.push_back(char(value | 0x80));
+      out.push_back(char(value));
+    }
+
+    // sorted terms front coded: the length shared with the previous term, the rest as a string
+    template<typename F>
+    void EmitTerms(std::string &out, size_t count, F &&termAt) {
+      Emit<uint32_t>(out, count);
+      const std::string *prev = nullptr;
+      for (size_t i = 0; i < count; i++) {
+        const std::string &term = termAt(i);
+        size_t shared = 0;
+        if (prev) {
+          size_t limit = std::min(prev->size(), term.size());
+          while (shared < limit && (*prev)[shared] == term[shared]) shared++;
+        }
+        EmitVarint(out, shared);
+        EmitVarint(out, term.size() - shared);
+        out.append(term, shared, std::string::npos);
+        prev = &term;
+      }
+    }
+
+    // reads a record payload, false once it runs past the end
+    struct Reader {
+      const char *at, *end;
+
+      template<typename T>
+      bool Get(T &value) {
+        if (size_t(end - at) < sizeof(value)) return false;
+        std::memcpy(&value, at, sizeof(value));
+        at += sizeof(value);
+        return true;
+      }
+
+      bool GetString(std::string &s) {
+        uint32_t size;
+        if (!Get(size) || size_t(end - at) < size) return false;
+        s.assign(at, size);
+        at += size;
+        return true;
+      }
+
+      bool GetVarint(uint64_t &value) {
+        value = 0;
+        for (int shift = 0; at < end && shift < 64; shift += 7) {
+          auto byte = uint8_t(*at++);
+          value |= uint64_t(byte & 0x7F) << shift;
+          if (!(byte & 0x80)) return true;
+        }
+        return false;
+      }
+
+      bool GetTerms(std::vector<std::string> &terms) {
+        uint32_t count;
+        if (!Get(count)) return false;
+        terms.resize(count);
+        for (size_t i = 0; i < count; i++) {
+          uint64_t shared, rest;
+          if (!GetVarint(shared) || !GetVarint(rest) || size_t(end - at) < rest) return false;
+          if (shared > (i > 0 ? terms[i - 1].size() : 0)) return false;
+          if (i > 0) terms[i].assign(terms[i - 1], 0, shared);
+          terms[i].append(at, rest);
+          at += rest;
+        }
+        return true;
+      }
+    };
+
+    void Insert(std::vector<uint32_t> &ids, uint32_t id) {
+      ids.insert(std::lower_bound(ids.begin(), ids.end(), id), id);
+    }
+  }// namespace
+
+  PresetCatalog::PresetCatalog(WorkerPool &pool, fs::path dir, std::function<void()> notify)
+      : pool_(pool), dir_(std::move(dir)), notify_(std::move(notify)),
+        generation_(0), busy_(true), stop_(false) {
+    thread_ = std::thread([this] { Run(); });
+  }
+
+  PresetCatalog::~PresetCatalog() {
+    {
+      std::lock_guard<std::mutex> lock(queueMutex_);
+      stop_ = true;
+    }
+    queued_.notify_all();
+    thread_.join();
+  }
+
+  void PresetCatalog::Refresh(const fs::path &path) {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    queue_.push_back({Op::REFRESH, path.filename().string(), {}});
+    queued_.notify_one();
+  }
+
+  void PresetCatalog::Forget(const fs::path &path) {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    queue_.push_back({Op::FORGET, path.filename().string(), {}});
+    queued_.notify_one();
+  }
+
+  void PresetCatalog::Retain(std::unordered_set<std::string> present) {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    queue_.push_back({Op::RETAIN, {}, std::move(present)});
+    queued_.notify_one();
+  }
+
+  void PresetCatalog::Wait() {
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    idle_.wait(lock, [this] { return queue_.empty() && !busy_; });
+  }
+
+  size_t PresetCatalog::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return byName_.size();
+  }
+
+  void PresetCatalog::Run() {
+    Load();
+    if (notify_) notify_();
+    for (;;) {
+      std::vector<Op> ops;
+      {
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        busy_ = false;
+        if (queue_.empty()) idle_.notify_all();
+        queued_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (stop_) return;
+        ops.swap(queue_);
+        busy_ = true;
+      }
+      Apply(ops);
+    }
+  }
+
+  void PresetCatalog::Apply(std::vector<Op> &ops) {
+    // the last op on a name wins
+    std::vector<std::string> order;
+    std::unordered_map<std::string, bool> refresh;
+    auto want = [&](const std::string &name, bool read) {
+      if (refresh.emplace(name, read).second) order.push_back(name);
+      else refresh[name] = read;
+    };
+    for (auto &op : ops) {
+      if (op.kind != Op::RETAIN) {
+        want(op.name, op.kind == Op::REFRESH);
+        continue;
+      }
+      std::unordered_set<std::string> keep;
+      for (auto &p : op.present) keep.insert(fs::path(p).filename().string());
+      for (auto &r : byName_) {
+        if (!keep.count(r.first)) want(r.first, false);
+      }
+    }
+
+    // presets including a changed one are read again with it
+    std::unordered_set<std::string> changed;
+    for (auto &name : order) changed.insert(PresetGraph::Key(dir_ / name));
+    for (auto &r : byName_) {
+      if (refresh.count(r.first)) continue;
+      for (auto &file : records_[r.second].includes) {
+        if (!changed.count(file.path)) continue;
+        want(r.first, true);
+        break;
+      }
+    }
+
+    // only presets that are new or changed since their record, or whose includes changed, are read
+    std::vector<Scan> scans;
+    for (auto &name : order) {
+      auto it = byName_.find(name);
+      Scan scan;
+      scan.name = name;
+      if (!refresh[name]) {
+        if (it != byName_.end()) scans.push_back(std::move(scan));
+        continue;
+      }
+      struct stat st {};
+      if (stat((dir_ / name).c_str(), &st) == 0 && it != byName_.end()) {
+        Stamp stamp{uint64_t(st.st_ino), uint64_t(st.st_size), int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec};
+        if (records_[it->second].stamp == stamp && PresetGraph::Fresh(records_[it->second].includes)) continue;
+      }
+      scan.present = true;
+      scans.push_back(std::move(scan));
+    }
+    if (scans.empty()) return;
+    PresetGraph graph;
+    pool_.ParallelFor(
+            0, scans.size(), [this, &scans, &graph](size_t i) {
+              if (scans[i].present) scans[i] = Read(graph, dir_ / scans[i].name, scans[i].name);
+            },
+            1);
+
+    // one at a time, queries wait for a preset, not a batch
+    for (auto &scan : scans) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (scan.present) Put(scan);
+      else Drop(scan.name);
+    }
+    Append(scans);
+    generation_++;
+    if (notify_) notify_();
+  }
+
+  PresetCatalog::Scan PresetCatalog::Read(PresetGraph &graph, const fs::path &path, const std::string &name) {
+    Scan scan;
+    scan.name = name;
+    // taken before reading, a change while reading only makes the next refresh read again
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0) return scan;
+    scan.stamp = {uint64_t(st.st_ino), uint64_t(st.st_size), int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec};
+    std::string error;
+    std::vector<PresetGraph::Stamp> files;
+    auto resolved = graph.Resolve(path, error, &files);
+    if (!resolved) {
+      // a missing include or a cycle: indexed as written until one of its includes changes
+      auto raw = std::make_shared<PresetData>();
+      if (!LoadPreset(path, *raw)) return scan;
+      files.clear();
+      for (auto &entry : raw->entries) {
+        if (!PresetGraph::IsInclude(entry)) continue;
+        fs::path target(std::string(PresetGraph::Target(entry)));
+        files.push_back({PresetGraph::Key(target.is_absolute() ? target : path.parent_path() / target), 0, 0, 0});
+      }
+      resolved = std::move(raw);
+    }
+    std::string self = PresetGraph::Key(path);
+    for (auto &file : files) {
+      if (file.path != self) scan.includes.push_back(std::move(file));
+    }
+    scan.present = true;
+    const PresetData &data = *resolved;
+
+    std::unordered_set<std::string> terms;
+    std::vector<bool> used(data.labels.size(), false);
+    size_t labels = std::min(data.labels.size(), data.labelChecked.Labels());
+    // folded names of the current entry's ancestors
+    std::vector<std::string> parents;
+    // row is the entry the name comes from, for its labels
+    auto add = [&](std::string_view entry, short depth, size_t row) {
+      std::string name = Fold(entry);
+      scan.maxDepth = std::max(scan.maxDepth, depth);
+      terms.insert(kName + name);
+      if (depth > 0 && size_t(depth) <= parents.size()) terms.insert(kEdge + parents[depth - 1] + '/' + name);
+      for (size_t l = 0; l < labels; l++) {
+        if (!data.labelChecked.Get(row, l)) continue;
+        used[l] = true;
+        terms.insert(kLabeled + name + '/' + data.labels[l]);
+      }
+      parents.resize(std::min<size_t>(depth, parents.size()));
+      parents.push_back(std::move(name));
+    };
+    // patterns are indexed as the entries they expand to, unless that is more than a run would create
+    scan.entries = ExpandedCount(data.entries, data.depths);
+    if (scan.entries <= kMaxExpanded) {
+      ForEachExpanded(data.entries, data.depths, [&](std::string_view name, short depth, size_t row) {
+        add(name, depth, row);
+        return true;
+      });
+    } else {
+      scan.entries = data.entries.size();
+      for (size_t row = 0; row < data.entries.size(); row++) add(data.entries[row], data.depths[row], row);
+    }
+    for (size_t l = 0; l < data.labels.size(); l++) {
+      if (!used[l]) continue;
+      scan.labels.push_back(data.labels[l]);
+      terms.insert(kLabel + data.labels[l]);
+    }
+    scan.terms.assign(terms.begin(), terms.end());
+    std::sort(scan.terms.begin(), scan.terms.end());
+    return scan;
+  }
+
+  void PresetCatalog::Put(Scan &scan) {
+    Drop(scan.name);
+    uint32_t id;
+    if (free_.empty()) {
+      id = records_.size();
+      records_.emplace_back();
+    } else {
+      id = free_.back();
+      free_.pop_back();
+    }
+    Record &record = records_[id];
+    record.name = scan.name;
+    record.stamp = scan.stamp;
+    record.includes = scan.includes;
+    record.entries = scan.entries;
+    record.maxDepth = scan.maxDepth;
+    record.labels = scan.labels;
+    record.terms.reserve(scan.terms.size());
+    for (auto &term : scan.terms) {
+      auto found = termIds_.try_emplace(term, 0);
+      if (found.second) {
+        uint32_t termId;
+        if (freeTerms_.empty()) {
+          termId = terms_.size();
+          terms_.push_back(nullptr);
+          postings_.emplace_back();
+        } else {
+          termId = freeTerms_.back();
+          freeTerms_.pop_back();
+        }
+        found.first->second = termId;
+        terms_[termId] = &found.first->first;
+        if (term[0] == kName) names_.insert(found.first->first);
+      }
+      Insert(postings_[found.first->second], id);
+      record.terms.push_back(found.first->second);
+    }
+    byName_[scan.name] = id;
+  }
+
+  void PresetCatalog::Drop(const std::string &name) {
+    auto found = byName_.find(name);
+    if (found == byName_.end()) return;
+    uint32_t id = found->second;
+    for (auto termId : records_[id].terms) {
+      auto &ids = postings_[termId];
+      ids.erase(std::lower_bound(ids.begin(), ids.end(), id));
+      if (!ids.empty()) continue;
+      ids.shrink_to_fit();
+      auto it = termIds_.find(*terms_[termId]);
+      if (it->first[0] == kName) names_.erase(it->first);
+      termIds_.erase(it);
+      terms_[termId] = nullptr;
+      freeTerms_.push_back(termId);
+    }
+    records_[id] = Record();
+    free_.push_back(id);
+    byName_.erase(found);
+  }
+
+  // QUERY
+  std::vector<CatalogHit> PresetCatalog::Query(const std::string &query, size_t limit) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<uint32_t> ids;
+    bool any = false;
+    auto narrow = [&ids, &any](std::vector<uint32_t> &&matched) {
+      if (!any) {
+        ids = std::move(matched);
+      } else {
+        std::vector<uint32_t> both;
+        std::set_intersection(ids.begin(), ids.end(), matched.begin(), matched.end(), std::back_inserter(both));
+        ids = std::move(both);
+      }
+      any = true;
+    };
+    // the folded names a query name stands for, all known names starting with it for a prefix
+    auto expand = [this](const std::string &name, bool prefix) {
+      std::vector<std::string> names;
+      if (!prefix) {
+        names.push_back(name);
+        return names;
+      }
+      std::string key = kName + name;
+      for (auto it = names_.lower_bound(key); it != names_.end() && it->compare(0, key.size(), key) == 0; ++it) {
+        names.emplace_back(it->substr(1));
+      }
+      return names;
+    };
+    // presets holding any of the terms kind + before + name + after
+    auto lookup = [this](char kind, const std::string &before, const std::vector<std::string> &names, const std::string &after) {
+      std::vector<uint32_t> matched;
+      // a short prefix spans many terms, marked per preset instead of merged
+      std::vector<uint8_t> marked(names.size() > 1 ? records_.size() : 0, 0);
+      for (auto &name : names) {
+        auto it = termIds_.find(kind + before + name + after);
+        if (it == termIds_.end()) continue;
+        if (names.size() == 1) return postings_[it->second];
+        for (auto id : postings_[it->second]) marked[id] = 1;
+      }
+      for (uint32_t id = 0; id < marked.size(); id++) {
+        if (marked[id]) matched.push_back(id);
+      }
+      return matched;
+    };
+
+    for (auto &token : str::split(query, ' ')) {
+      if (token.empty()) continue;
+      if (token.rfind("label:", 0) == 0) {
+        narrow(lookup(kLabel, "", {token.substr(6)}, ""));
+        continue;
+      }
+      auto at = token.rfind('@');
+      std::string label = at == std::string::npos ? std::string() : token.substr(at + 1);
+      std::vector<std::string> names;
+      std::vector<bool> prefixes;
+      for (auto &name : str::split(Fold(token.substr(0, at)), '/')) {
+        if (name.empty()) continue;
+        bool prefix = name.back() == '*';
+        if (prefix) name.pop_back();
+        names.push_back(name);
+        prefixes.push_back(prefix);
+      }
+      std::vector<std::string> last;
+      for (size_t i = 0; i < names.size(); i++) {
+        last = expand(names[i], prefixes[i]);
+        narrow(lookup(kName, "", last, ""));
+        // a prefix parent is not looked up in pairs, the names alone have to do
+        if (i > 0 && !prefixes[i - 1]) narrow(lookup(kEdge, names[i - 1] + '/', last, ""));
+      }
+      if (!names.empty() && !label.empty()) narrow(lookup(kLabeled, "", last, '/' + label));
+    }
+    if (!any) {
+      for (auto &r : byName_) ids.push_back(r.second);
+    }
+
+    std::vector<CatalogHit> hits;
+    hits.reserve(ids.size());
+    for (auto id : ids) {
+      auto &record = records_[id];
+      hits.push_back({dir_ / record.name, record.entries, record.maxDepth, record.labels});
+    }
+    std::sort(hits.begin(), hits.end(), [](const CatalogHit &a, const CatalogHit &b) { return a.path < b.path; });
+    if (limit > 0 && hits.size() > limit) hits.resize(limit);
+    return hits;
+  }
+
+  // LOG
+  // a header, then records of a uint32 size and the payload:
+  // present byte, name, and for a present preset ino, size, mtime, the path, ino, size and mtime of each
+  // included file, entries, max depth, labels and front coded terms
+  namespace {
+    void Encode(std::string &out, bool present, const std::string &name, uint64_t ino, uint64_t size, int64_t mtime,
+                const std::vector<PresetGraph::Stamp> &includes, uint64_t entries, short maxDepth,
+                const std::vector<std::string> &labels, const std::function<void(std::string &)> &terms) {
+      size_t start = out.size();
+      Emit<uint32_t>(out, 0);
+      Emit<uint8_t>(out, present);
+      EmitString(out, name);
+      if (present) {
+        Emit(out, ino);
+        Emit(out, size);
+        Emit(out, mtime);
+        Emit<uint32_t>(out, includes.size());
+        for (auto &file : includes) {
+          EmitString(out, file.path);
+          Emit(out, file.ino);
+          Emit(out, file.size);
+          Emit(out, file.mtime);
+        }
+        Emit(out, entries);
+        Emit<int16_t>(out, maxDepth);
+        Emit<uint32_t>(out, labels.size());
+        for (auto &l : labels) EmitString(out, l);
+        terms(out);
+      }
+      uint32_t payload = out.size() - start - sizeof(uint32_t);
+      std::memcpy(&out[start], &payload, sizeof(payload));
+    }
+  }// namespace
+
+  void PresetCatalog::Load() {
+    std::ifstream in(FileFor(dir_), std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    Reader file{bytes.data(), bytes.data() + bytes.size()};
+    char magic[8];
+    uint32_t version;
+    bool ok = file.Get(magic) && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0 && file.Get(version) && version == kVersion;
+    size_t logged = 0;
+    // a record cut short by a crash ends the log
+    uint32_t payload;
+    while (ok && file.Get(payload) && size_t(file.end - file.at) >= payload) {
+      Reader r{file.at, file.at + payload};
+      file.at += payload;
+      logged++;
+      Scan scan;
+      uint8_t present;
+      if (!r.Get(present) || !r.GetString(scan.name)) {
+        ok = false;
+        break;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!present) {
+        Drop(scan.name);
+        continue;
+      }
+      uint32_t count;
+      int16_t depth;
+      if (!r.Get(scan.stamp.ino) || !r.Get(scan.stamp.size) || !r.Get(scan.stamp.mtime) || !r.Get(count)) {
+        ok = false;
+        break;
+      }
+      // each at least an empty path and its stamp
+      ok = count <= size_t(r.end - r.at) / 28;
+      scan.includes.resize(ok ? count : 0);
+      for (auto &file : scan.includes) {
+        ok = ok && r.GetString(file.path) && r.Get(file.ino) && r.Get(file.size) && r.Get(file.mtime);
+      }
+      if (!ok || !r.Get(scan.entries) || !r.Get(depth) || !r.Get(count)) {
+        ok = false;
+        break;
+      }
+      scan.maxDepth = depth;
+      scan.labels.resize(count);
+      for (auto &l : scan.labels) ok = ok && r.GetString(l);
+      ok = ok && r.GetTerms(scan.terms);
+      if (!ok) break;
+      scan.present = true;
+      Put(scan);
+    }
+    ok = ok && file.at == file.end;
+    logged_ = logged;
+    // rewritten when missing, unreadable or mostly superseded records
+    if (!ok || logged_ > 2 * byName_.size() + 64) Compact();
+    generation_++;
+  }
+
+  void PresetCatalog::Compact() {
+    std::string out(kMagic, sizeof(kMagic));
+    Emit(out, kVersion);
+    for (auto &r : byName_) {
+      auto &record = records_[r.second];
+      Encode(out, true, record.name, record.stamp.ino, record.stamp.size, record.stamp.mtime, record.includes,
+             record.entries, record.maxDepth, record.labels, [this, &record](std::string &o) {
+               EmitTerms(o, record.terms.size(), [this, &record](size_t i) -> const std::string & { return *terms_[record.terms[i]]; });
+             });
+    }
+    fs::path file = FileFor(dir_), tmp = file;
+    tmp += ".tmp";
+    std::ofstream f(tmp, std::ios::binary);
+    f.write(out.data(), out.size());
+    f.close();
+    std::error_code ec;
+    if (!f.fail()) fs::rename(tmp, file, ec);
+    if (f.fail() || ec) fs::remove(tmp, ec);
+    logged_ = byName_.size();
+  }
+
+  void PresetCatalog::Append(const std::vector<Scan> &scans) {
+    std::string out;
+    for (auto &scan : scans) {
+      Encode(out, scan.present, scan.name, scan.stamp.ino, scan.stamp.size, scan.stamp.mtime, scan.includes,
+             scan.entries, scan.maxDepth, scan.labels, [&scan](std::string &o) {
+               EmitTerms(o, scan.terms.size(), [&scan](size_t i) -> const std::string & { return scan.terms[i]; });
+             });
+    }
+    logged_ += scans.size();
+    if (logged_ > 2 * byName_.size() + 64) {
+      Compact();
+      return;
+    }
+    std::ofstream f(FileFor(dir_), std::ios::binary | std::ios::app);
+    f.write(out.data(), out.size());
+  }
+}// namespace fstui
\ No newline at end of file
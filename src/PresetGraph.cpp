@@ -0,0 +1,168 @@
+#include <algorithm>// for find, sort, unique
+#include <sys/stat.h>
+
+#include "PresetGraph.hpp"
+#include "stringtoolbox.hpp"
+
+namespace fstui {
+  namespace str = stringtoolbox;
+
+  namespace {
+    constexpr std::string_view kInclude = "@include ";
+  }// namespace
+
+  bool PresetGraph::IsInclude(std::string_view name) {
+    return name.size() > kInclude.size() && name.compare(0, kInclude.size(), kInclude) == 0;
+  }
+
+  std::string_view PresetGraph::Target(std::string_view name) {
+    return str::trimView(name.substr(kInclude.size()));
+  }
+
+  std::string PresetGraph::Key(const fs::path &path) {
+    std::error_code ec;
+    auto canonical = fs::weakly_canonical(path, ec);
+    return (ec ? path : canonical).string();
+  }
+
+  bool PresetGraph::StampOf(const std::string &path, Stamp &stamp) {
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0) return false;
+    stamp = {path, uint64_t(st.st_ino), uint64_t(st.st_size), int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec};
+    return true;
+  }
+
+  bool PresetGraph::Fresh(const std::vector<Stamp> &files) {
+    for (auto &file : files) {
+      Stamp now;
+      if (!StampOf(file.path, now) || now.ino != file.ino || now.size != file.size || now.mtime != file.mtime) return false;
+    }
+    return true;
+  }
+
+  size_t PresetGraph::Cached() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return nodes_.size();
+  }
+
+  std::shared_ptr<const PresetData> PresetGraph::Resolve(const fs::path &path, std::string &error,
+                                                         std::vector<Stamp> *files) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> stack;
+    std::vector<Stamp> read;
+    auto data = ResolveFile(Key(path), stack, read, error);
+    if (files) *files = std::move(read);
+    return data;
+  }
+
+  std::shared_ptr<const PresetData> PresetGraph::Resolve(std::shared_ptr<const PresetData> data, const fs::path &path,
+                                                         std::string &error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> stack{Key(path)};
+    std::vector<Stamp> files;
+    return Splice(std::move(data), fs::path(stack[0]).parent_path(), stack, files, error);
+  }
+
+  std::shared_ptr<const PresetData> PresetGraph::ResolveFile(const std::string &key, std::vector<std::string> &stack,
+                                                             std::vector<Stamp> &files, std::string &error) {
+    auto cycle = std::find(stack.begin(), stack.end(), key);
+    if (cycle != stack.end()) {
+      error = "include cycle:";
+      for (; cycle != stack.end(); ++cycle) error += " " + *cycle + " ->";
+      error += " " + key;
+      return nullptr;
+    }
+    auto cached = nodes_.find(key);
+    if (cached != nodes_.end() && Fresh(cached->second.files)) {
+      files.insert(files.end(), cached->second.files.begin(), cached->second.files.end());
+      return cached->second.data;
+    }
+
+    // stamped before reading, a change while reading only resolves it again next time
+    Node node;
+    Stamp self;
+    auto raw = std::make_shared<PresetData>();
+    if (!StampOf(key, self) || !LoadPreset(key, *raw)) {
+      error = "cannot read preset " + key;
+      return nullptr;
+    }
+    node.files.push_back(self);
+    stack.push_back(key);
+    node.data = Splice(std::move(raw), fs::path(key).parent_path(), stack, node.files, error);
+    stack.pop_back();
+    if (!node.data) return nullptr;
+
+    std::sort(node.files.begin(), node.files.end(), [](const Stamp &a, const Stamp &b) { return a.path < b.path; });
+    node.files.erase(std::unique(node.files.begin(), node.files.end(), [](const Stamp &a, const Stamp &b) { return a.path == b.path; }),
+                     node.files.end());
+    files.insert(files.end(), node.files.begin(), node.files.end());
+    auto data = node.data;
+    nodes_[key] = std::move(node);
+    return data;
+  }
+
+  std::shared_ptr<const PresetData> PresetGraph::Splice(std::shared_ptr<const PresetData> data, const fs::path &dir,
+                                                        std::vector<std::string> &stack, std::vector<Stamp> &files,
+                                                        std::string &error) {
+    // included presets first, they decide the labels
+    std::vector<std::shared_ptr<const PresetData>> included;
+    for (auto &name : data->entries) {
+      if (!IsInclude(name)) continue;
+      fs::path target(std::string(Target(name)));
+      auto sub = ResolveFile(Key(target.is_absolute() ? target : dir / target), stack, files, error);
+      if (!sub) return nullptr;
+      included.push_back(std::move(sub));
+    }
+    if (included.empty()) return data;
+
+    auto out = std::make_shared<PresetData>();
+    out->labels = data->labels;
+    std::unordered_map<std::string, size_t> labelIds;
+    for (size_t l = 0; l < out->labels.size(); l++) labelIds.emplace(out->labels[l], l);
+    // column in out of each label of each included preset
+    std::vector<std::vector<size_t>> columns(included.size());
+    for (size_t k = 0; k < included.size(); k++) {
+      for (auto &label : included[k]->labels) {
+        auto it = labelIds.emplace(label, out->labels.size());
+        if (it.second) out->labels.push_back(label);
+        columns[k].push_back(it.first->second);
+      }
+    }
+    out->labelChecked.Reset(out->labels.size(), 0);
+
+    // entries stay views into the arenas they were read into, which out keeps
+    out->names->Keep(data->names);
+    size_t ownLabels = std::min(data->labels.size(), data->labelChecked.Labels());
+    std::vector<size_t> checked;
+    size_t k = 0;
+    for (size_t row = 0; row < data->entries.size(); row++) {
+      checked.clear();
+      for (size_t l = 0; l < ownLabels; l++) {
+        if (data->labelChecked.Get(row, l)) checked.push_back(l);
+      }
+      if (!IsInclude(data->entries[row])) {
+        size_t at = out->entries.size();
+        out->entries.push_back(data->entries[row]);
+        out->depths.push_back(data->depths[row]);
+        out->labelChecked.PushRow();
+        for (auto l : checked) out->labelChecked.Set(at, l, true);
+        continue;
+      }
+      auto &sub = *included[k];
+      auto &column = columns[k++];
+      out->names->Keep(sub.names);
+      size_t subLabels = std::min(sub.labels.size(), sub.labelChecked.Labels());
+      for (size_t r = 0; r < sub.entries.size(); r++) {
+        size_t at = out->entries.size();
+        out->entries.push_back(sub.entries[r]);
+        out->depths.push_back(data->depths[row] + sub.depths[r]);
+        out->labelChecked.PushRow();
+        for (auto l : checked) out->labelChecked.Set(at, l, true);
+        for (size_t l = 0; l < subLabels; l++) {
+          if (sub.labelChecked.Get(r, l)) out->labelChecked.Set(at, column[l], true);
+        }
+      }
+    }
+    return out;
+  }
+}// namespace fstui
\ No newline at end of file
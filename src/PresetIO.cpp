@@ -0,0 +1,233 @@
+#include <algorithm>// for min, max
+#include <cerrno>
+#include <climits>  // for SHRT_MAX
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BinaryPreset.hpp"
+#include "PresetIO.hpp"
+#include "stringtoolbox.hpp"
+
+namespace fstui {
+  namespace str = stringtoolbox;
+
+  bool LoadPreset(const fs::path &path, PresetData &data) {
+    if (auto binary = BinaryPreset::For(path)) {
+      binary->Read(data);
+      return true;
+    }
+    PresetSource source;
+    if (!source.Open(path)) {
+      data = PresetData();
+      return false;
+    }
+    std::vector<PresetRange> ranges;
+    return ScanPreset(source, SIZE_MAX, data, ranges);
+  }
+
+  bool SavePreset(const fs::path &path,
+                  const std::vector<std::string> &labels,
+                  const std::vector<std::string_view> &entries,
+                  const std::vector<short> &depths,
+                  const LabelStore &labelChecked,
+                  TaskProgress *progress) {
+    // written aside and renamed over, so an open PresetSource of the old file stays intact
+    fs::path tmp = path;
+    tmp += ".tmp";
+    std::ofstream f(tmp);
+    if (!f.is_open()) return false;
+    if (labels.size() > 0) {
+      f << "|";
+      for (auto &l : labels) f << l << "|";
+      f << '\n';
+    }
+    if (progress) progress->SetTotal(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (progress && (i & 1023) == 0) {
+        if (progress->Cancelled()) break;
+        progress->Advance(i == 0 ? 0 : 1024);
+      }
+      for (auto j = 0; j < depths[i]; j++) f << '\t';
+      f << entries[i];
+      if (labels.size() > 0) {
+        f << " |";
+        for (size_t j = 0; j < labels.size(); j++) f << (j < labelChecked.Labels() && labelChecked.Get(i, j) ? '1' : '0');
+        f << "|";
+      }
+      f << '\n';
+    }
+    f.close();
+    std::error_code ec;
+    bool cancelled = progress && progress->Cancelled();
+    if (!f.fail() && !cancelled) fs::rename(tmp, path, ec);
+    if (f.fail() || cancelled || ec) {
+      fs::remove(tmp, ec);
+      return false;
+    }
+    // best effort, a missing or stale .dfb only means the next load parses the .df
+    BinaryPreset::Write(path, labels, entries, depths, labelChecked);
+    return true;
+  }
+
+  bool SavePreset(const fs::path &path, const PresetData &data, TaskProgress *progress) {
+    return SavePreset(path, data.labels, data.entries, data.depths, data.labelChecked, progress);
+  }
+
+  // LAZY LOADING
+  PresetSource::~PresetSource() {
+    if (fd_ >= 0) close(fd_);
+  }
+
+  namespace {
+    int64_t MtimeOf(const struct stat &st) {
+      return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    }
+  }// namespace
+
+  bool PresetSource::Open(const fs::path &path) {
+    fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) return false;
+    struct stat st {};
+    if (fstat(fd_, &st) != 0) return false;
+    size_ = st.st_size;
+    mtime_ = MtimeOf(st);
+    return true;
+  }
+
+  bool PresetSource::Changed() const {
+    struct stat st {};
+    return fd_ < 0 || fstat(fd_, &st) != 0 || size_t(st.st_size) != size_ || MtimeOf(st) != mtime_;
+  }
+
+  // read, not mapped: a file truncated under a mapping faults on the pages it lost
+  bool PresetSource::Read(size_t begin, size_t end, std::string &bytes) const {
+    end = std::min(end, size_);
+    bytes.resize(begin < end ? end - begin : 0);
+    if (Changed()) return false;
+    for (size_t done = 0; done < bytes.size();) {
+      ssize_t n = pread(fd_, &bytes[done], bytes.size() - done, begin + done);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      done += n;
+    }
+    // a write racing the read shows in the stamp
+    return !Changed();
+  }
+
+  namespace {
+    // lines up to the first empty one
+    template<typename F>
+    void ForEachLine(const char *data, size_t begin, size_t end, F &&onLine) {
+      for (auto line : str::splitView(std::string_view(data + begin, end - begin), '\n')) {
+        if (line.empty()) return;
+        size_t b = line.data() - data;
+        onLine(b, b + line.size());
+      }
+    }
+
+    short LineDepth(const char *data, size_t begin, size_t end) {
+      return str::countChar(std::string_view(data + begin, end - begin), '\t');
+    }
+
+    void ParseLine(const char *bytes, size_t begin, size_t end, short depth, PresetData &data) {
+      auto line = str::ltrimView(std::string_view(bytes + begin, end - begin));
+      auto labelPos = line.find(" |");
+      size_t row = data.entries.size();
+      data.labelChecked.PushRow();
+      if (labelPos != std::string_view::npos) {
+        auto label = line.substr(labelPos + 2, data.labelChecked.Labels());
+        for (size_t i = 0; i < label.size(); i++) {
+          if (label[i] == '1') data.labelChecked.Set(row, i, true);
+        }
+      }
+      auto entry = line.substr(0, labelPos);
+      data.entries.push_back(data.names->Add(entry));
+      data.depths.push_back(depth);
+    }
+
+    // reads the levels of [begin, end) that fit in budget, deeper lines become ranges of their last read ancestor
+    void ScanLines(const char *bytes, size_t begin, size_t end, size_t budget,
+                   PresetData &data, std::vector<PresetRange> &ranges) {
+      // there are fewer lines than bytes, so a budget that big reads everything without counting
+      short maxDepth = SHRT_MAX;
+      if (budget < end - begin) {
+        std::vector<size_t> perDepth;
+        ForEachLine(bytes, begin, end, [&](size_t b, size_t e) {
+          size_t depth = LineDepth(bytes, b, e);
+          if (perDepth.size() <= depth) perDepth.resize(depth + 1, 0);
+          perDepth[depth]++;
+        });
+        maxDepth = 0;
+        for (size_t total = 0; maxDepth < (short) perDepth.size(); maxDepth++) {
+          if (total > 0 && total + perDepth[maxDepth] > budget) break;
+          total += perDepth[maxDepth];
+        }
+        maxDepth--;
+      }
+
+      size_t first = data.entries.size();
+      bool open = false;
+      ForEachLine(bytes, begin, end, [&](size_t b, size_t e) {
+        short depth = LineDepth(bytes, b, e);
+        if (depth > maxDepth && data.entries.size() > first) {
+          if (!open) ranges.push_back({data.entries.size() - 1, b, e, data.depths.back(), 0});
+          open = true;
+          ranges.back().end = e;
+          ranges.back().span = std::max<short>(ranges.back().span, depth - ranges.back().depth);
+          return;
+        }
+        open = false;
+        ParseLine(bytes, b, e, depth, data);
+      });
+      // the newline closing each range's last line belongs to it
+      for (auto &range : ranges) range.end = std::min(end, range.end + 1);
+    }
+  }// namespace
+
+  bool ScanPreset(const PresetSource &source, size_t budget, PresetData &data, std::vector<PresetRange> &ranges) {
+    data = PresetData();
+    ranges.clear();
+    std::string all;
+    if (!source.Read(0, source.Size(), all)) return false;
+    const char *bytes = all.data();
+    size_t size = all.size();
+
+    size_t begin = 0;
+    if (size > 0 && bytes[0] == '|') {
+      size_t stop = std::min(size, str::findChar(all, '\n'));
+      // every field but the first and the last
+      auto fields = str::splitView(std::string_view(all).substr(0, stop), '|');
+      auto it = ++fields.begin();
+      for (auto next = it; it != fields.end() && ++next != fields.end(); it = next) data.labels.emplace_back(*it);
+      begin = std::min(size, stop + 1);
+    }
+    data.labelChecked.Reset(data.labels.size(), 0);
+    ScanLines(bytes, begin, size, budget, data, ranges);
+    return true;
+  }
+
+  bool ScanPresetRange(const PresetSource &source, const PresetRange &range, size_t budget,
+                       PresetData &data, std::vector<PresetRange> &ranges) {
+    ranges.clear();
+    std::string bytes;
+    if (!source.Read(range.begin, range.end, bytes)) return false;
+    ScanLines(bytes.data(), 0, bytes.size(), budget, data, ranges);
+    // offsets in the file
+    for (auto &sub : ranges) {
+      sub.begin += range.begin;
+      sub.end += range.begin;
+    }
+    return true;
+  }
+
+  bool LoadPresetRange(const PresetSource &source, const PresetRange &range, PresetData &data) {
+    std::string bytes;
+    if (!source.Read(range.begin, range.end, bytes)) return false;
+    ForEachLine(bytes.data(), 0, bytes.size(), [&](size_t b, size_t e) {
+      ParseLine(bytes.data(), b, e, LineDepth(bytes.data(), b, e), data);
+    });
+    return true;
+  }
+}// namespace fstui
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "PresetWatcher.hpp"
+
+namespace fstui {
+
+  namespace {
+    constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF;
+  }// namespace
+
+  PresetWatcher::PresetWatcher(fs::path dir, std::string ext, std::function<void()> notify)
+      : dir_(std::move(dir)), ext_(std::move(ext)), notify_(std::move(notify)),
+        inotify_(-1), wake_(-1), stop_(false), listed_(false) {
+    inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // watched before listing, a file showing up in between is reported by both and listed once by the UI
+    if (inotify_ >= 0 && inotify_add_watch(inotify_, dir_.c_str(), kWatchMask) < 0) {
+      close(inotify_);
+      inotify_ = -1;
+    }
+    wake_ = eventfd(0, EFD_CLOEXEC);
+    thread_ = std::thread([this] { Run(); });
+  }
+
+  PresetWatcher::~PresetWatcher() {
+    stop_ = true;
+    if (wake_ >= 0) {
+      uint64_t one = 1;
+      (void) !write(wake_, &one, sizeof(one));
+    }
+    thread_.join();
+    if (inotify_ >= 0) close(inotify_);
+    if (wake_ >= 0) close(wake_);
+  }
+
+  std::vector<PresetWatcher::Change> PresetWatcher::Take() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::move(pending_);
+  }
+
+  void PresetWatcher::Report(bool added, const fs::path &path) {
+    auto key = path.string();
+    // a preset written again is reported again, its contents changed
+    if (added) present_.insert(key);
+    else if (present_.erase(key) == 0) return;
+    bool first;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      first = pending_.empty();
+      pending_.push_back({added, path});
+    }
+    // one wakeup per batch, the UI takes everything queued by then
+    if (first && notify_) notify_();
+  }
+
+  void PresetWatcher::List() {
+    std::unordered_set<std::string> seen;
+    std::error_code ec;
+    for (fs::directory_iterator it{dir_, ec}, end; !ec && it != end && !stop_; it.increment(ec)) {
+      if (it->is_directory(ec) || it->path().extension().string() != ext_) continue;
+      seen.insert(it->path().string());
+      Report(true, it->path());
+    }
+    if (ec || stop_) return;
+    std::vector<std::string> gone;
+    for (auto &p : present_) {
+      if (!seen.count(p)) gone.push_back(p);
+    }
+    for (auto &p : gone) Report(false, p);
+  }
+
+  void PresetWatcher::OnEvents() {
+    alignas(inotify_event) char buffer[16 * 1024];
+    for (;;) {
+      ssize_t n = read(inotify_, buffer, sizeof(buffer));
+      if (n <= 0) return;
+      for (char *p = buffer; p < buffer + n;) {
+        auto *event = reinterpret_cast<const inotify_event *>(p);
+        p += sizeof(inotify_event) + event->len;
+        if (event->mask & IN_Q_OVERFLOW) {
+          List();
+          continue;
+        }
+        if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+          // the directory itself went away, nothing left to follow
+          close(inotify_);
+          inotify_ = -1;
+          return;
+        }
+        if (event->len == 0 || (event->mask & IN_ISDIR)) continue;
+        fs::path path = dir_ / event->name;
+        if (path.extension().string() != ext_) continue;
+        Report(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO), path);
+      }
+    }
+  }
+
+  void PresetWatcher::Run() {
+    List();
+    listed_ = true;
+    if (notify_) notify_();
+    while (!stop_ && inotify_ >= 0 && wake_ >= 0) {
+      pollfd fds[2] = {{inotify_, POLLIN, 0}, {wake_, POLLIN, 0}};
+      if (poll(fds, 2, -1) < 0) continue;
+      if (fds[1].revents) break;
+      if (fds[0].revents) OnEvents();
+    }
+  }
+}// namespace fstui
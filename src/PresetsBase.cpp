@@ -1,9 +1,12 @@
-#include <algorithm>// for max, min
+#include <algorithm>// for max, min, find
+#include <chrono>
+#include <cstdio>   // for swprintf
 #include <filesystem>
 #include <functional>// for function
 #include <memory>    // for shared_ptr, allocator_traits<>::value_type
 #include <stddef.h>  // for size_t
 #include <string>    // for operator+, string
+#include <unordered_map>
 #include <utility>   // for move
 #include <vector>    // for vector, __alloc_traits<>::value_type
 
@@ -18,6 +21,7 @@
 #include "ftxui/screen/box.hpp"                  // for Box
 #include "ftxui/util/ref.hpp"                    // for Ref
 
+#include "Encoding.hpp"
 #include "PresetsBase.hpp"
 
 namespace fstui {
@@ -29,36 +33,137 @@ namespace fstui {
                            const std::string &windowName,
                            const std::function<void(fs::path &)> onSave,
                            const std::function<void(fs::path &)> onLoad,
-                           const std::function<void(fs::path &)> onAction)
+                           const std::function<void(fs::path &)> onAction,
+                           std::function<void()> onIndexChange,
+                           std::function<void(fs::path &)> onPrefetch)
       : presetDir_(std::move(presetDir)), actionName_(actionName.begin(), actionName.end()), windowName_(windowName.begin(), windowName.end()),
-        focused_(0), selected_(0),
+        focused_(0), selected_(0), loaded_(false),
         presetPaths_(), presetEntries_(),
-        onSave_(onSave), onLoad_(onLoad), onAction_(onAction), menuOption_() {
-    // proc preset names
+        onSave_(onSave), onLoad_(onLoad), onAction_(onAction), onPrefetch_(std::move(onPrefetch)), menuOption_() {
     state_ = States::PRESETS;
     const fs::path p{presetDir_};
     if (!exists(p)) fs::create_directory(p);
-    for (auto const &f : fs::directory_iterator{p}) {
-      if (f.is_directory() || f.path().extension().string() != presetExt_) continue;
-      std::wstring file = f.path().filename().wstring();
-      presetEntries_.emplace_back(file);
-      presetPaths_.emplace_back(f.path());
-    }
+    // preset names arrive from the watcher thread, onIndexChange wakes the UI to pick them up
+    watcher_ = std::make_unique<PresetWatcher>(p, presetExt_, std::move(onIndexChange));
+  }
 
+  void PresetsBase::Sync() {
+    bool listed = watcher_->Listed();
+    auto changes = watcher_->Take();
+    for (auto &change : changes) {
+      if (change.added) AddPreset(presetPaths_.size(), change.path);
+      else RemovePreset(change.path);
+      if (!catalog_) continue;
+      if (change.added) catalog_->Refresh(change.path);
+      else catalog_->Forget(change.path);
+    }
+    // presets removed while nothing watched leave the catalog once the first listing is in
+    if (catalog_ && listed && !retained_) {
+      retained_ = true;
+      catalog_->Retain(knownPaths_);
+    }
+    if (Querying() && (!changes.empty() || (catalog_ && catalog_->Generation() != queryGeneration_))) RunQuery();
     // load first
-    if (presetPaths_.size() > 0) {
-      onLoad_(presetPaths_[0]);
+    if (!loaded_ && presetPaths_.size() > 0) Load(0);
+  }
+
+  void PresetsBase::AddPreset(size_t at, const fs::path &path) {
+    if (!knownPaths_.insert(path.string()).second) return;
+    presetEntries_.insert(presetEntries_.begin() + at, path.filename().wstring());
+    presetPaths_.insert(presetPaths_.begin() + at, path);
+    // query results keep pointing at their presets until the next query
+    for (int &i : shown_) {
+      if (i >= (int) at) i++;
+    }
+  }
+
+  void PresetsBase::RemovePreset(const fs::path &path) {
+    if (knownPaths_.erase(path.string()) == 0) return;
+    int index = std::find(presetPaths_.begin(), presetPaths_.end(), path) - presetPaths_.begin();
+    presetEntries_.erase(presetEntries_.begin() + index);
+    presetPaths_.erase(presetPaths_.begin() + index);
+    auto shown = std::find(shown_.begin(), shown_.end(), index);
+    if (shown != shown_.end()) {
+      shownInfo_.erase(shownInfo_.begin() + (shown - shown_.begin()));
+      shown_.erase(shown);
+    }
+    for (int &i : shown_) {
+      if (i > index) i--;
+    }
+    // the tree keeps showing a removed selection until another preset is loaded
+    int last = std::max(0, int(presetPaths_.size()) - 1);
+    if (selected_ > index) selected_--;
+    if (focused_ > index) focused_--;
+    selected_ = std::min(selected_, last);
+    focused_ = std::min(focused_, last);
+  }
+
+  void PresetsBase::Load(size_t index) {
+    loaded_ = true;
+    onLoad_(presetPaths_[index]);
+    Prefetch();
+  }
+
+  // QUERY
+  int PresetsBase::Step(int index, int delta) const {
+    if (!Querying()) {
+      int next = index + delta;
+      return next >= 0 && next < (int) presetEntries_.size() ? next : -1;
+    }
+    auto it = std::find(shown_.begin(), shown_.end(), index);
+    if (it == shown_.end()) return shown_.empty() ? -1 : shown_[0];
+    int row = int(it - shown_.begin()) + delta;
+    return row >= 0 && row < (int) shown_.size() ? shown_[row] : -1;
+  }
+
+  void PresetsBase::SetQuery(const std::wstring &query) {
+    query_ = query;
+    shown_.clear();
+    shownInfo_.clear();
+    if (Querying()) RunQuery();
+  }
+
+  void PresetsBase::RunQuery() {
+    shown_.clear();
+    shownInfo_.clear();
+    if (!catalog_) return;
+    auto start = std::chrono::steady_clock::now();
+    queryGeneration_ = catalog_->Generation();
+    auto hits = catalog_->Query(ToUtf8(query_));
+    std::unordered_map<std::string, size_t> hitOf;
+    for (size_t h = 0; h < hits.size(); h++) hitOf.emplace(hits[h].path.string(), h);
+    for (int i = 0; i < (int) presetPaths_.size(); i++) {
+      auto it = hitOf.find(presetPaths_[i].string());
+      if (it == hitOf.end()) continue;
+      auto &hit = hits[it->second];
+      shown_.push_back(i);
+      shownInfo_.push_back(L"  " + std::to_wstring(hit.entries) + L" entries, depth " + std::to_wstring(hit.maxDepth));
+    }
+    queryMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    // the focus stays on a shown preset
+    if (!shown_.empty() && std::find(shown_.begin(), shown_.end(), focused_) == shown_.end()) {
+      focused_ = shown_[0];
+      Prefetch();
+    }
+  }
+
+  void PresetsBase::Prefetch() {
+    if (!onPrefetch_) return;
+    for (int i : {focused_, Step(focused_, 1), Step(focused_, -1)}) {
+      if (i >= 0 && i < (int) presetPaths_.size() && i != selected_) onPrefetch_(presetPaths_[i]);
     }
   }
 
 
   Element PresetsBase::Render() {
+    Sync();
     // preset list
     Elements elements;
     bool is_menu_focused = PresetsBase::Focused();
-    presetBoxes_.resize(presetEntries_.size());
-    for (int i = 0; i < presetEntries_.size(); i++) {
-      bool is_focused = focused_ == int(i) && state_ == PRESETS;
+    presetBoxes_.resize(ShownSize());
+    for (int row = 0; row < ShownSize(); row++) {
+      int i = ShownAt(row);
+      bool is_focused = focused_ == int(i) && (state_ == PRESETS || state_ == QUERY);
       bool is_selected = selected_ == int(i) && Focused();
 
       auto style = is_focused ? (is_selected ? menuOption_.style_selected_focused
@@ -72,7 +177,19 @@ namespace fstui {
 
       Element elem;
       elem = text(presetEntries_.at(i));
-      elements.emplace_back(elem | style | focus_management | reflect(presetBoxes_[i]));
+      if (Querying()) elem = hbox({elem, text(shownInfo_[row]) | dim});
+      elements.emplace_back(elem | style | focus_management | reflect(presetBoxes_[row]));
+    }
+    // query box
+    if (state_ == States::QUERY || Querying()) {
+      std::wstring count;
+      if (Querying()) {
+        wchar_t ms[32];
+        swprintf(ms, 32, L"%.2f", queryMs_);
+        count = L"  " + std::to_wstring(shown_.size()) + L" presets in " + ms + L" ms";
+      }
+      Element cursor = state_ == States::QUERY ? text(L" ") | underlined : text(L"");
+      elements.insert(elements.begin(), hbox({text(L"/" + query_), cursor, text(count) | dim}));
     }
     // save name
     Element savename;
@@ -81,21 +198,44 @@ namespace fstui {
       auto atPos = inputPosition_ < inputString_.size() ? inputString_.substr(inputPosition_, 1) : L" ";
       auto afterPos = inputPosition_ < (int) inputString_.size() - 1 ? inputString_.substr(inputPosition_ + 1) : L"";
       savename = hbox(text(beforePos), text(atPos) | underlined, text(afterPos));
-    } else {
+    } else if (!presetEntries_.empty()) {
       inputString_ = presetEntries_[selected_].substr(0, presetEntries_[selected_].size() - presetExt_.size());
       savename = text(inputString_);
     }
     if (state_ == States::EDITSAVENAME || state_ == States::SAVENAME) savename = savename | inverted;
     savename = hbox(text(L"Name: ") | vcenter, border(savename | reflect(nameBox_)));
     // action btn
-//    Element actionbtn = border(text(actionName_) | center | (state_ == States::ACTIONBTN ? inverted : nothing)) | hcenter;
-//    actionbtn = actionbtn | reflect(actionbtnBox_);
+    Element actionbtn = border(text(actionName_) | center | (state_ == States::ACTIONBTN ? inverted : nothing));
+    actionbtn = actionbtn | reflect(actionbtnBox_);
+    if (onExport_) {
+      Element exportbtn = border(text(exportName_) | center | (state_ == States::EXPORTBTN ? inverted : nothing));
+      actionbtn = hbox({actionbtn, exportbtn | reflect(exportbtnBox_)});
+    }
+    actionbtn = actionbtn | hcenter;
+    Element status = status_.empty() ? text(L"") : text(status_) | dim;
+    if (tasks_ && tasks_->Busy()) {
+      float fraction = tasks_->Fraction();
+      Element bar = fraction < 0 ? text(L"") : gauge(fraction) | flex;
+      status = vbox({hbox({text(tasks_->Name() + L" "), bar}),
+                     text(L"Esc to cancel") | dim});
+    }
 
     return window(
             text(windowName_),
             vbox(
                     {vbox(std::move(elements)),
-                     savename}));
+                     savename,
+                     actionbtn,
+                     status}));
+  }
+
+  void PresetsBase::SetExport(std::string exportName, std::function<void(fs::path &)> onExport) {
+    exportName_ = FromUtf8(exportName);
+    onExport_ = std::move(onExport);
+  }
+
+  void PresetsBase::SetStatus(const std::wstring &status) {
+    status_ = status;
   }
 
   bool PresetsBase::OnEvent(Event event) {
@@ -105,22 +245,32 @@ namespace fstui {
       return OnMouseEvent(event);
     if (!Focused())
       return false;
+    Sync();
 
     switch (state_) {
       case States::PRESETS:
         if (event == Event::ArrowUp) {
-          if (focused_ > 0) {
-            focused_--;
+          int prev = Step(focused_, -1);
+          if (prev >= 0) {
+            focused_ = prev;
+            Prefetch();
           }
         } else if (event == Event::ArrowDown) {
-          if (focused_ < presetEntries_.size() - 1) {
-            focused_++;
+          int next = Step(focused_, 1);
+          if (next >= 0) {
+            focused_ = next;
+            Prefetch();
           } else {
             state_ = SAVENAME;
           }
         } else if (event == Event::Character(' ') || event == Event::Return) {
+          if (ShownSize() == 0) return true;
           selected_ = focused_;
-          onLoad_(presetPaths_[selected_]);
+          Load(selected_);
+        } else if (event == Event::Character('/')) {
+          state_ = States::QUERY;
+        } else if (event == Event::Escape && Querying()) {
+          SetQuery(L"");
         } else {
           return false;
         }
@@ -131,8 +281,8 @@ namespace fstui {
           inputPosition_ = inputString_.size();
         } else if (event == Event::ArrowUp) {
           state_ = States::PRESETS;
-//        } else if (event == Event::ArrowDown) {
-//          state_ = States::ACTIONBTN;
+        } else if (event == Event::ArrowDown) {
+          state_ = States::ACTIONBTN;
         } else {
           return false;
         }
@@ -151,12 +301,12 @@ namespace fstui {
           fs::path dir{presetDir_};
           fs::path file{newName};
           fs::path newPath = dir/file;
-          presetEntries_.insert(presetEntries_.begin()+selected_+1,newName);
-          presetPaths_.insert(presetPaths_.begin()+selected_+1, newPath);
-          selected_++;
-          focused_++;
+          int at = presetPaths_.empty() ? 0 : selected_ + 1;
+          AddPreset(at, newPath);
+          selected_ = at;
+          focused_ = at;
           onSave_(presetPaths_[selected_]);
-          onLoad_(presetPaths_[selected_]);
+          Load(selected_);
           state_ = States::SAVENAME;
         } else if (event == Event::Escape) {
           state_ = States::SAVENAME;
@@ -187,11 +337,48 @@ namespace fstui {
           return false;
         }
         break;
+      case States::QUERY:
+        if (event == Event::Return) {
+          state_ = States::PRESETS;
+        } else if (event == Event::Escape) {
+          SetQuery(L"");
+          state_ = States::PRESETS;
+        } else if (event == Event::ArrowUp || event == Event::ArrowDown) {
+          int next = Step(focused_, event == Event::ArrowUp ? -1 : 1);
+          if (next >= 0) {
+            focused_ = next;
+            Prefetch();
+          }
+        } else if (event == Event::Backspace) {
+          if (query_.empty()) {
+            state_ = States::PRESETS;
+          } else {
+            SetQuery(query_.substr(0, query_.size() - 1));
+          }
+        } else if (event.is_character()) {
+          SetQuery(query_ + event.character());
+        } else {
+          return false;
+        }
+        break;
       case States::ACTIONBTN:
         if (event == Event::ArrowUp) {
           state_ = States::SAVENAME;
+        } else if (event == Event::ArrowRight && onExport_) {
+          state_ = States::EXPORTBTN;
+        } else if (event == Event::Return || event == Event::Character(' ')) {
+          if (presetPaths_.size() > 0) onAction_(presetPaths_[selected_]);
+        } else {
+          return false;
+        }
+        break;
+      case States::EXPORTBTN:
+        if (event == Event::ArrowUp) {
+          state_ = States::SAVENAME;
+        } else if (event == Event::ArrowLeft) {
+          state_ = States::ACTIONBTN;
         } else if (event == Event::Return || event == Event::Character(' ')) {
-          onAction_(presetPaths_[selected_]);
+          if (presetPaths_.size() > 0) onExport_(presetPaths_[selected_]);
         } else {
           return false;
         }
@@ -205,18 +392,22 @@ namespace fstui {
       return false;
     if (state_ == States::EDITSAVENAME) return false;
     // presets
-    for (int i = 0; i < int(presetBoxes_.size()); ++i) {
-      if (!presetBoxes_[i].Contain(event.mouse().x, event.mouse().y))
+    for (int row = 0; row < int(presetBoxes_.size()) && row < ShownSize(); ++row) {
+      if (!presetBoxes_[row].Contain(event.mouse().x, event.mouse().y))
         continue;
+      int i = ShownAt(row);
 
       TakeFocus();
-      focused_ = i;
+      if (focused_ != i) {
+        focused_ = i;
+        Prefetch();
+      }
       if (event.mouse().button == Mouse::Left &&
           event.mouse().motion == Mouse::Released) {
         if (selected_ != i) {
           selected_ = i;
           focused_ = i;
-          onLoad_(presetPaths_[selected_]);
+          Load(selected_);
           return true;
         }
       }
@@ -232,15 +423,25 @@ namespace fstui {
       }
     }
     // actionbtn
-//    if (actionbtnBox_.Contain(event.mouse().x, event.mouse().y)) {
-//      TakeFocus();
-//      if (event.mouse().button == Mouse::Left &&
-//          event.mouse().motion == Mouse::Released) {
-//        state_ = States::ACTIONBTN;
-//        onAction_(presetPaths_[selected_]);
-//        return true;
-//      }
-//    }
+    if (actionbtnBox_.Contain(event.mouse().x, event.mouse().y)) {
+      TakeFocus();
+      if (event.mouse().button == Mouse::Left &&
+          event.mouse().motion == Mouse::Released) {
+        state_ = States::ACTIONBTN;
+        if (presetPaths_.size() > 0) onAction_(presetPaths_[selected_]);
+        return true;
+      }
+    }
+    // exportbtn
+    if (onExport_ && exportbtnBox_.Contain(event.mouse().x, event.mouse().y)) {
+      TakeFocus();
+      if (event.mouse().button == Mouse::Left &&
+          event.mouse().motion == Mouse::Released) {
+        state_ = States::EXPORTBTN;
+        if (presetPaths_.size() > 0) onExport_(presetPaths_[selected_]);
+        return true;
+      }
+    }
     return false;
   }
 
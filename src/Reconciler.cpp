@@ -0,0 +1,353 @@
+#include <algorithm>// for lower_bound, sort, min
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>// for strerror
+#include <fcntl.h>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "DirWalker.hpp"
+#include "NameArena.hpp"
+#include "Pattern.hpp"
+#include "Reconciler.hpp"
+
+namespace fstui {
+
+  namespace {
+    enum State : uint8_t { UNKNOWN,
+                           PRESENT,
+                           CREATED,
+                           FAILED };
+
+    // name -> is a directory
+    using Listing = std::unordered_map<std::string, bool>;
+
+    bool ValidName(std::string_view name) {
+      return !name.empty() && name != "." && name != ".." &&
+             name.find('/') == std::string_view::npos && name.find('\0') == std::string_view::npos;
+    }
+
+    // entries of the dir parentFd/name, false if it cannot be read
+    bool List(int parentFd, const std::string &name, std::vector<std::pair<std::string, bool>> &out) {
+      int fd = openat(parentFd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (fd < 0) return false;
+      int err = DirWalker::ReadDir(fd, [&](const char *child, bool isDir) { out.emplace_back(child, isDir); });
+      close(fd);
+      return err == 0;
+    }
+
+    // true unless everything below parentFd/name is a directory
+    bool HoldsFiles(int parentFd, const std::string &name) {
+      std::vector<std::pair<std::string, bool>> children;
+      if (!List(parentFd, name, children)) return true;
+      int fd = openat(parentFd, name.c_str(), O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (fd < 0) return true;
+      bool files = false;
+      for (auto &child : children) {
+        if (!child.second || HoldsFiles(fd, child.first)) {
+          files = true;
+          break;
+        }
+      }
+      close(fd);
+      return files;
+    }
+
+    // removes a tree of directories only, bottom up
+    bool RemoveTree(int parentFd, const std::string &name) {
+      std::vector<std::pair<std::string, bool>> children;
+      if (!List(parentFd, name, children)) return false;
+      int fd = openat(parentFd, name.c_str(), O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (fd < 0) return false;
+      bool removed = true;
+      for (auto &child : children) removed = removed && child.second && RemoveTree(fd, child.first);
+      close(fd);
+      return removed && unlinkat(parentFd, name.c_str(), AT_REMOVEDIR) == 0;
+    }
+  }// namespace
+
+  struct Reconciler::Context {
+    NameArena arena;// expanded names
+    std::vector<std::string_view> names;
+    std::vector<int> parents;               // row of parent, -1 -> root
+    std::vector<size_t> ends;               // past the last row of the subtree
+    std::vector<bool> hasChildren;
+    std::vector<std::vector<size_t>> levels;// rows of each depth, in pre-order
+    std::vector<size_t> sources;            // entry a row was expanded from, with actions only
+    const LabelActions *actions = nullptr;
+    ActionStats actionStats;
+    int rootFd = -1;
+    ReconcileOptions options;
+    TaskProgress *progress = nullptr;
+
+    bool Cancelled() const { return progress && progress->Cancelled(); }
+    bool Seeded(size_t row) const { return actions && actions->Has(sources[row]); }
+
+    // STAT CACHE, what this run knows of each row and, with extras, what is in its dir.
+    // paths and listings are dropped once the level below is done, the paths of seeded rows once their actions ran.
+    std::vector<uint8_t> states;
+    std::vector<std::string> paths;// relative to root
+    std::vector<std::unique_ptr<Listing>> listings;
+    std::unique_ptr<Listing> rootListing;
+
+    std::atomic<size_t> present{0};
+    std::atomic<size_t> created{0};
+    std::atomic<size_t> failed{0};
+    std::atomic<size_t> pruned{0};
+    std::mutex mutex;
+    std::vector<std::string> extras;
+    std::string firstError;
+
+    void Fail(const std::string &path, int err) {
+      failed++;
+      std::lock_guard<std::mutex> lock(mutex);
+      if (firstError.empty()) firstError = path + ": " + std::strerror(err);
+    }
+  };
+
+  std::wstring ReconcileStats::Summary() const {
+    std::wostringstream ss;
+    if (cancelled) ss << L"cancelled, ";
+    ss << present << L" present, " << created << L" created, " << failed << L" failed";
+    if (!extras.empty()) ss << L", " << extras.size() << L" extra (" << pruned << L" pruned)";
+    if (files > 0) ss << L", " << files << L" files (" << cloned << L" cloned)";
+    ss << L" in " << std::fixed << std::setprecision(2) << seconds << L"s ("
+       << std::setprecision(0) << NodesPerSecond() << L" nodes/s)";
+    return ss.str();
+  }
+
+  Reconciler::Reconciler(WorkerPool &pool, mode_t mode) : pool_(pool), mode_(mode) {}
+
+  ReconcileStats Reconciler::Run(const std::vector<std::string_view> &entries,
+                                 const std::vector<short> &depths,
+                                 const fs::path &root,
+                                 ReconcileOptions options,
+                                 TaskProgress *progress,
+                                 const LabelActions *actions) {
+    auto start = std::chrono::steady_clock::now();
+    ReconcileStats stats;
+    Context ctx;
+    size_t n = ExpandedCount(entries, depths);
+    ctx.options = options;
+    ctx.options.extras = options.extras || options.prune;
+    ctx.progress = progress;
+    ctx.actions = actions && !actions->Empty() ? actions : nullptr;
+    if (n > kMaxExpanded) {
+      stats.failed = 1;
+      stats.firstError = ExpandedError(n);
+      return stats;
+    }
+    if (progress) progress->SetTotal(n);
+
+    std::error_code ec;
+    fs::create_directories(root, ec);
+    ctx.rootFd = open(root.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (ctx.rootFd < 0) {
+      stats.nodes = n;
+      stats.failed = n;
+      stats.firstError = root.string() + ": " + std::strerror(errno);
+      return stats;
+    }
+
+    // parents, subtree ends and levels, unnormalized depths are clamped to parent + 1
+    std::vector<size_t> stack;
+    ForEachExpanded(entries, depths, [&](std::string_view name, short d, size_t source) {
+      size_t i = ctx.names.size();
+      ctx.names.push_back(ctx.arena.Add(name));
+      if (ctx.actions) ctx.sources.push_back(source);
+      ctx.parents.push_back(-1);
+      ctx.ends.push_back(0);
+      ctx.hasChildren.push_back(false);
+      size_t depth = d > 0 ? d : 0;
+      while (stack.size() > depth) {
+        ctx.ends[stack.back()] = i;
+        stack.pop_back();
+      }
+      if (!stack.empty()) {
+        ctx.parents[i] = stack.back();
+        ctx.hasChildren[stack.back()] = true;
+      }
+      if (ctx.levels.size() <= stack.size()) ctx.levels.resize(stack.size() + 1);
+      ctx.levels[stack.size()].push_back(i);
+      stack.push_back(i);
+      return !ctx.Cancelled();
+    });
+    n = ctx.names.size();
+    for (size_t row : stack) ctx.ends[row] = n;
+    ctx.states.assign(n, UNKNOWN);
+    ctx.paths.resize(n);
+    ctx.listings.resize(n);
+
+    if (ctx.options.extras) Extras(ctx, -1, 0, ctx.rootFd);
+    for (size_t level = 0; level < ctx.levels.size() && !ctx.Cancelled(); level++) {
+      RunLevel(ctx, level);
+      // the level below only looks one up
+      if (level > 0) {
+        for (size_t row : ctx.levels[level - 1]) {
+          if (!ctx.Seeded(row)) std::string().swap(ctx.paths[row]);
+          ctx.listings[row].reset();
+        }
+      } else {
+        ctx.rootListing.reset();
+      }
+    }
+    // files first, the mode may take away write access
+    for (size_t level = ctx.levels.size(); ctx.actions && level-- > 0 && !ctx.Cancelled();) RunActions(ctx, level);
+    close(ctx.rootFd);
+
+    stats.nodes = n;
+    stats.present = ctx.present;
+    stats.created = ctx.created;
+    stats.failed = ctx.failed;
+    stats.pruned = ctx.pruned;
+    stats.files = ctx.actionStats.files;
+    stats.cloned = ctx.actionStats.cloned;
+    stats.extras = std::move(ctx.extras);
+    std::sort(stats.extras.begin(), stats.extras.end());
+    stats.firstError = ctx.firstError;
+    stats.cancelled = ctx.Cancelled();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+  }
+
+  void Reconciler::RunLevel(Context &ctx, size_t level) {
+    pool_.ParallelFor(0, ctx.levels[level].size(), [this, &ctx, level](size_t k) {
+      if (ctx.Cancelled()) return;
+      if (ctx.progress) ctx.progress->Advance();
+      size_t row = ctx.levels[level][k];
+      int parent = ctx.parents[row];
+      uint8_t parentState = parent < 0 ? uint8_t(PRESENT) : ctx.states[parent];
+      std::string_view name = ctx.names[row];
+      auto &state = ctx.states[row];
+      if (parentState != PRESENT && parentState != CREATED) {
+        state = FAILED;
+        ctx.failed++;// parent missing
+        return;
+      }
+      std::string path = parent < 0 ? std::string() : ctx.paths[parent] + "/";
+      path += name;
+      if (!ValidName(name)) {
+        state = FAILED;
+        ctx.Fail(path, EINVAL);
+        return;
+      }
+
+      // nothing is under a directory this run made
+      bool exists = false, isDir = false;
+      if (parentState == PRESENT) {
+        const Listing *listing = parent < 0 ? ctx.rootListing.get() : ctx.listings[parent].get();
+        if (listing) {
+          auto it = listing->find(std::string(name));
+          exists = it != listing->end();
+          isDir = exists && it->second;
+        } else {
+          struct stat st {};
+          if (fstatat(ctx.rootFd, path.c_str(), &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            exists = true;
+            isDir = S_ISDIR(st.st_mode);
+          } else if (errno != ENOENT) {
+            state = FAILED;
+            ctx.Fail(path, errno);
+            return;
+          }
+        }
+      }
+
+      if (exists && !isDir) {
+        state = FAILED;
+        ctx.Fail(path, ENOTDIR);
+        return;
+      }
+      if (exists) {
+        state = PRESENT;
+        ctx.present++;
+      } else if (mkdirat(ctx.rootFd, path.c_str(), mode_) == 0) {
+        state = CREATED;
+        ctx.created++;
+      } else if (errno == EEXIST) {
+        state = PRESENT;
+        ctx.present++;
+      } else {
+        state = FAILED;
+        ctx.Fail(path, errno);
+        return;
+      }
+
+      if (ctx.hasChildren[row] || ctx.options.extras || ctx.Seeded(row)) ctx.paths[row] = path;
+      if (state == PRESENT && ctx.options.extras) {
+        int fd = openat(ctx.rootFd, path.c_str(), O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd >= 0) {
+          Extras(ctx, row, level + 1, fd);
+          close(fd);
+        } else {
+          ctx.Fail(path, errno);
+        }
+      }
+    }, 8);
+  }
+
+  void Reconciler::RunActions(Context &ctx, size_t level) {
+    pool_.ParallelFor(0, ctx.levels[level].size(), [&ctx, level](size_t k) {
+      size_t row = ctx.levels[level][k];
+      uint8_t state = ctx.states[row];
+      if ((state != PRESENT && state != CREATED) || !ctx.Seeded(row) || ctx.Cancelled()) return;
+      // paths are relative to the root, which works as the parent
+      const std::string &path = ctx.paths[row];
+      int err = ctx.actions->Seed(ctx.sources[row], ctx.rootFd, path, ctx.actionStats);
+      if (!err) err = ctx.actions->Chmod(ctx.sources[row], ctx.rootFd, path);
+      if (err) ctx.Fail(path, err);
+      std::string().swap(ctx.paths[row]);
+    }, 8);
+  }
+
+  void Reconciler::Extras(Context &ctx, int row, size_t childLevel, int dirFd) {
+    std::vector<std::pair<std::string, bool>> children;
+    int fd = openat(dirFd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    int err = fd < 0 ? errno : DirWalker::ReadDir(fd, [&](const char *child, bool isDir) { children.emplace_back(child, isDir); });
+    if (fd >= 0) close(fd);
+    std::string prefix = row < 0 ? "" : ctx.paths[row] + "/";
+    if (err != 0) {
+      ctx.Fail(row < 0 ? "." : ctx.paths[row], err);
+      return;
+    }
+
+    // children of row in the model
+    std::unordered_set<std::string_view> expected;
+    if (childLevel < ctx.levels.size()) {
+      const auto &next = ctx.levels[childLevel];
+      auto from = row < 0 ? next.begin() : std::lower_bound(next.begin(), next.end(), size_t(row));
+      auto to = row < 0 ? next.end() : std::lower_bound(from, next.end(), ctx.ends[row]);
+      for (auto it = from; it != to; ++it) expected.insert(ctx.names[*it]);
+    }
+
+    std::vector<std::string> extras;
+    size_t pruned = 0;
+    for (auto &child : children) {
+      // files are content, not structure
+      if (!child.second || expected.count(child.first)) continue;
+      if (ctx.options.prune && !HoldsFiles(dirFd, child.first) && RemoveTree(dirFd, child.first)) pruned++;
+      extras.push_back(prefix + child.first);
+    }
+    if (!extras.empty()) {
+      ctx.pruned += pruned;
+      std::lock_guard<std::mutex> lock(ctx.mutex);
+      ctx.extras.insert(ctx.extras.end(), extras.begin(), extras.end());
+    }
+
+    // answers the lookups of the children
+    if (expected.empty()) return;
+    auto listing = std::make_unique<Listing>(children.begin(), children.end());
+    if (row < 0)
+      ctx.rootListing = std::move(listing);
+    else
+      ctx.listings[row] = std::move(listing);
+  }
+}// namespace fstui
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include <algorithm>// for min
+#include <chrono>
+
+#include "TaskRunner.hpp"
+
+namespace fstui {
+
+  namespace {
+    constexpr int64_t kFrameNs = 1000000000 / 60;
+
+    int64_t Now() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+  }// namespace
+
+  void TaskProgress::Advance(size_t n) {
+    done_ += n;
+    int64_t now = Now(), last = lastPost_;
+    if (now - last >= kFrameNs && lastPost_.compare_exchange_strong(last, now) && post_) post_();
+  }
+
+  float TaskProgress::Fraction() const {
+    size_t total = total_;
+    return total == 0 ? -1.0f : std::min(1.0f, float(done_) / float(total));
+  }
+
+  TaskRunner::TaskRunner(std::function<void()> post) : post_(std::move(post)), stop_(false) {
+    thread_ = std::thread([this] { Loop(); });
+  }
+
+  TaskRunner::~TaskRunner() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+      if (current_) current_->progress->cancelled_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  void TaskRunner::Run(std::wstring name,
+                       std::function<void(TaskProgress &)> work,
+                       std::function<void(bool cancelled)> done) {
+    auto progress = std::make_shared<TaskProgress>();
+    progress->post_ = post_;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back({std::move(name), std::move(work), std::move(done), std::move(progress)});
+    }
+    cv_.notify_all();
+    if (post_) post_();
+  }
+
+  void TaskRunner::Cancel() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (current_) current_->progress->cancelled_ = true;
+      for (auto &task : queue_) finished_.emplace_back(std::move(task.done), true);
+      queue_.clear();
+    }
+    if (post_) post_();
+  }
+
+  void TaskRunner::Poll() {
+    decltype(finished_) finished;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      finished.swap(finished_);
+    }
+    for (auto &[done, cancelled] : finished) {
+      if (done) done(cancelled);
+    }
+  }
+
+  bool TaskRunner::Busy() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_ || !queue_.empty();
+  }
+
+  std::wstring TaskRunner::Name() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_ ? current_->name : queue_.empty() ? L"" : queue_.front().name;
+  }
+
+  float TaskRunner::Fraction() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_ ? current_->progress->Fraction() : -1.0f;
+  }
+
+  void TaskRunner::Loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (stop_) return;
+      current_ = std::make_unique<Task>(std::move(queue_.front()));
+      queue_.pop_front();
+      lock.unlock();
+      current_->work(*current_->progress);
+      lock.lock();
+      finished_.emplace_back(std::move(current_->done), bool(current_->progress->cancelled_));
+      current_.reset();
+      lock.unlock();
+      if (post_) post_();
+      lock.lock();
+    }
+  }
+}// namespace fstui
@@ -0,0 +1,698 @@
+#include <algorithm>// for sort, unique, min
+#include <atomic>
+#include <cerrno>
+#include <cstring>// for memcmp, memcpy, strerror
+#include <fcntl.h>
+#include <fstream>
+#include <regex>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "DirWalker.hpp"
+#include "Pattern.hpp"
+#include "TrigramIndex.hpp"
+
+namespace fstui {
+
+  namespace {
+    constexpr char kMagic[8] = {'F', 'S', 'T', 'U', 'I', 'T', 'R', 'I'};
+    constexpr uint32_t kVersion = 1;
+    constexpr uint32_t kBlock = 128;
+    constexpr uint16_t kDirFlag = 1;
+    constexpr uint32_t kNone = UINT32_MAX;
+
+    inline unsigned char Fold(unsigned char c) {
+      return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+    }
+
+    // three folded bytes
+    inline uint32_t Key(const char *p) {
+      return uint32_t(Fold(p[0])) << 16 | uint32_t(Fold(p[1])) << 8 | Fold(p[2]);
+    }
+
+    void Keys(std::string_view name, std::vector<uint32_t> &keys) {
+      keys.clear();
+      for (size_t i = 0; i + 3 <= name.size(); i++) keys.push_back(Key(name.data() + i));
+      std::sort(keys.begin(), keys.end());
+      keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    }
+
+    void PutVarint(std::string &out, uint32_t v) {
+      while (v >= 0x80) {
+        out.push_back(char(v | 0x80));
+        v >>= 7;
+      }
+      out.push_back(char(v));
+    }
+
+    // false when the varint runs past end or 32 bits
+    inline bool GetVarint(const unsigned char *&p, const unsigned char *end, uint32_t &v) {
+      v = 0;
+      for (int shift = 0; p < end && shift < 32; shift += 7) {
+        unsigned char b = *p++;
+        v |= uint32_t(b & 0x7F) << shift;
+        if (b < 0x80) return true;
+      }
+      return false;
+    }
+
+    bool Contains(std::string_view name, std::string_view query, bool ignoreCase) {
+      if (!ignoreCase) return name.find(query) != std::string_view::npos;
+      if (query.size() > name.size()) return false;
+      for (size_t i = 0; i + query.size() <= name.size(); i++) {
+        size_t k = 0;
+        while (k < query.size() && Fold(name[i + k]) == Fold(query[k])) k++;
+        if (k == query.size()) return true;
+      }
+      return false;
+    }
+
+    // literal runs every match must contain, empty when the pattern has alternations
+    std::vector<std::string> RequiredLiterals(const std::string &re) {
+      std::vector<std::string> out;
+      if (re.find('|') != std::string::npos) return out;
+      std::string run;
+      auto flush = [&out, &run]() {
+        if (run.size() >= 3) out.push_back(run);
+        run.clear();
+      };
+      for (size_t i = 0; i < re.size(); i++) {
+        char c = re[i];
+        char lit;
+        if (c == '\\' && i + 1 < re.size()) {
+          char e = re[++i];
+          if (std::strchr(".^$|()[]{}*+?\\/-", e) == nullptr) {
+            // class escape like \d, or a character spelled by its operand, which is no literal either
+            size_t operand = e == 'x' ? 2 : e == 'u' ? 4 : e == 'c' ? 1 : 0;
+            if (e >= '0' && e <= '9') operand = std::strspn(re.c_str() + i + 1, "0123456789");
+            i = std::min(i + operand, re.size() - 1);
+            flush();
+            continue;
+          }
+          lit = e;
+        } else if (c == '[' || c == '(') {
+          // skip classes and groups
+          char close = c == '[' ? ']' : ')';
+          int level = 0;
+          for (; i < re.size(); i++) {
+            if (re[i] == '\\') {
+              i++;
+            } else if (re[i] == c && (c == '(' || level == 0)) {
+              level++;
+            } else if (re[i] == close && --level == 0) {
+              break;
+            }
+          }
+          flush();
+          continue;
+        } else if (c == '{') {
+          while (i < re.size() && re[i] != '}') i++;
+          flush();
+          continue;
+        } else if (std::strchr(".^$)*+?}", c)) {
+          flush();
+          continue;
+        } else {
+          lit = c;
+        }
+        char next = i + 1 < re.size() ? re[i + 1] : '\0';
+        if (next == '*' || next == '?' || next == '{') {
+          flush();
+          continue;
+        }
+        run.push_back(lit);
+        if (next == '+') flush();
+      }
+      flush();
+      return out;
+    }
+  }// namespace
+
+  struct TrigramIndex::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockSize;
+    uint64_t entryCount;
+    uint64_t dirCount;
+    uint64_t trigramCount;
+    uint64_t entriesOff;
+    uint64_t dirsOff;
+    uint64_t mtimesOff;
+    uint64_t namesOff;
+    uint64_t namesSize;
+    uint64_t trigramsOff;
+    uint64_t postingsOff;
+    uint64_t postingsSize;
+    uint64_t rootOff;
+    uint64_t rootSize;
+  };
+
+  struct TrigramIndex::EntryRec {
+    uint64_t nameOff;
+    uint32_t parent;
+    uint16_t nameLen;
+    uint16_t flags;
+  };
+
+  // postings at off: skip table {first id, byte offset} per block, then the varint deltas
+  struct TrigramIndex::TrigramRec {
+    uint32_t key;
+    uint32_t count;
+    uint64_t off;
+  };
+
+  class TrigramIndex::Cursor {
+public:
+    // rec as checked by Open, the varints are read no further than the end of the postings
+    Cursor(const char *postings, uint64_t postingsSize, const TrigramRec &rec)
+        : count_(rec.count), blocks_((rec.count + kBlock - 1) / kBlock),
+          skip_(reinterpret_cast<const uint32_t *>(postings + rec.off)),
+          data_(reinterpret_cast<const unsigned char *>(postings + rec.off + blocks_ * 8)),
+          end_(reinterpret_cast<const unsigned char *>(postings + postingsSize)) {
+      Load(0);
+    }
+
+    bool Done() const { return block_ >= blocks_; }
+    uint32_t Id() const { return id_; }
+
+    void Next() {
+      uint32_t delta;
+      if (++inBlock_ >= BlockLength(block_))
+        Load(block_ + 1);
+      else if (GetVarint(p_, end_, delta))
+        id_ += delta;
+      else
+        block_ = blocks_;// damaged, the list ends here
+    }
+
+    void SeekGE(uint32_t target) {
+      if (Done() || id_ >= target) return;
+      if (block_ + 1 < blocks_ && skip_[2 * (block_ + 1)] <= target) {
+        size_t lo = block_ + 1, hi = blocks_;
+        while (hi - lo > 1) {
+          size_t mid = (lo + hi) / 2;
+          if (skip_[2 * mid] <= target)
+            lo = mid;
+          else
+            hi = mid;
+        }
+        Load(lo);
+      }
+      while (!Done() && id_ < target) Next();
+    }
+
+private:
+    size_t count_;
+    size_t blocks_;
+    const uint32_t *skip_;
+    const unsigned char *data_;
+    const unsigned char *end_;
+    size_t block_ = 0;
+    size_t inBlock_ = 0;
+    uint32_t id_ = 0;
+    const unsigned char *p_ = nullptr;
+
+    size_t BlockLength(size_t b) const { return b + 1 < blocks_ ? kBlock : count_ - b * kBlock; }
+    void Load(size_t b) {
+      block_ = b;
+      if (b >= blocks_) return;
+      inBlock_ = 0;
+      id_ = skip_[2 * b];
+      p_ = data_ + skip_[2 * b + 1];
+    }
+  };
+
+  TrigramIndex::~TrigramIndex() {
+    Close();
+  }
+
+  // BUILD
+
+  void TrigramIndex::FromWalk(const DirWalker &walker, std::vector<IndexEntry> &entries) {
+    entries.clear();
+    entries.push_back({kNone, "", true, walker.Root().mtime});
+    std::vector<std::pair<const WalkDir *, uint32_t>> stack{{&walker.Root(), 0}};
+    while (!stack.empty()) {
+      auto top = stack.back();
+      stack.pop_back();
+      for (auto &child : top.first->children) {
+        uint32_t id = entries.size();
+        entries.push_back({top.second, child.name, child.dir != nullptr, child.dir ? child.dir->mtime : 0});
+        if (child.dir && !child.dir->children.empty()) stack.push_back({child.dir, id});
+      }
+    }
+  }
+
+  void TrigramIndex::FromPreset(const std::vector<std::string_view> &names,
+                                const std::vector<short> &depths,
+                                std::vector<IndexEntry> &entries) {
+    entries.clear();
+    entries.push_back({kNone, "", true, 0});
+    std::vector<uint32_t> stack{0};
+    ForEachExpanded(names, depths, [&](std::string_view name, short d, size_t) {
+      size_t depth = d > 0 ? d : 0;
+      if (stack.size() > depth + 1) stack.resize(depth + 1);
+      uint32_t id = entries.size();
+      entries.push_back({stack.back(), std::string(name), true, 0});
+      stack.push_back(id);
+      return entries.size() < kNone;
+    });
+  }
+
+  bool TrigramIndex::Write(const fs::path &file, const std::string &root,
+                           const std::vector<IndexEntry> &entries, WorkerPool &pool, std::string &error) {
+    // counting sort of (key, id), ids come out ascending per key
+    std::vector<uint32_t> starts((1u << 24) + 1, 0);
+    std::vector<uint32_t> keys;
+    for (auto &e : entries) {
+      Keys(e.name, keys);
+      for (auto k : keys) starts[k + 1]++;
+    }
+    std::vector<uint32_t> used;
+    for (uint32_t k = 0; k < (1u << 24); k++) {
+      if (starts[k + 1] > 0) used.push_back(k);
+      starts[k + 1] += starts[k];
+    }
+    std::vector<uint32_t> ids(starts.back());
+    {
+      std::vector<uint32_t> fill(starts.begin(), starts.end() - 1);
+      for (uint32_t id = 0; id < entries.size(); id++) {
+        Keys(entries[id].name, keys);
+        for (auto k : keys) ids[fill[k]++] = id;
+      }
+    }
+
+    // encode lists in parallel, each padded to 4 bytes for the skip table
+    std::vector<std::string> encoded(used.size());
+    pool.ParallelFor(0, used.size(), [&](size_t u) {
+      uint32_t k = used[u];
+      const uint32_t *list = ids.data() + starts[k];
+      size_t count = starts[k + 1] - starts[k];
+      size_t blocks = (count + kBlock - 1) / kBlock;
+      std::vector<uint32_t> skip(blocks * 2);
+      std::string data;
+      for (size_t b = 0; b < blocks; b++) {
+        skip[2 * b] = list[b * kBlock];
+        skip[2 * b + 1] = data.size();
+        for (size_t i = b * kBlock + 1; i < std::min(count, (b + 1) * kBlock); i++) PutVarint(data, list[i] - list[i - 1]);
+      }
+      std::string &out = encoded[u];
+      out.assign(reinterpret_cast<const char *>(skip.data()), skip.size() * 4);
+      out += data;
+      out.resize((out.size() + 3) & ~size_t(3), '\0');
+    }, 256);
+
+    // layout
+    auto align = [](uint64_t off) { return (off + 7) & ~uint64_t(7); };
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.blockSize = kBlock;
+    header.entryCount = entries.size();
+    header.trigramCount = used.size();
+
+    std::vector<EntryRec> recs(entries.size());
+    std::vector<uint32_t> dirs;
+    std::vector<int64_t> mtimes;
+    uint64_t namesSize = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+      uint16_t len = uint16_t(std::min<size_t>(entries[i].name.size(), UINT16_MAX));
+      recs[i] = {namesSize, entries[i].parent, len, uint16_t(entries[i].dir ? kDirFlag : 0)};
+      namesSize += len;
+      if (entries[i].dir) {
+        dirs.push_back(i);
+        mtimes.push_back(entries[i].mtime);
+      }
+    }
+    std::vector<TrigramRec> trigrams(used.size());
+    uint64_t postingsSize = 0;
+    for (size_t u = 0; u < used.size(); u++) {
+      trigrams[u] = {used[u], starts[used[u] + 1] - starts[used[u]], postingsSize};
+      postingsSize += encoded[u].size();
+    }
+    header.dirCount = dirs.size();
+    header.entriesOff = align(sizeof(Header));
+    header.dirsOff = align(header.entriesOff + recs.size() * sizeof(EntryRec));
+    header.mtimesOff = align(header.dirsOff + dirs.size() * sizeof(uint32_t));
+    header.namesOff = align(header.mtimesOff + mtimes.size() * sizeof(int64_t));
+    header.namesSize = namesSize;
+    header.trigramsOff = align(header.namesOff + namesSize);
+    header.postingsOff = align(header.trigramsOff + trigrams.size() * sizeof(TrigramRec));
+    header.postingsSize = postingsSize;
+    header.rootOff = align(header.postingsOff + postingsSize);
+    header.rootSize = root.size();
+
+    // write next to the target and rename, readers keep their old mapping
+    fs::path tmp = file;
+    tmp += ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+      error = "cannot write " + tmp.string();
+      return false;
+    }
+    uint64_t pos = 0;
+    auto put = [&out, &pos](uint64_t off, const void *data, size_t size) {
+      static const char zeros[8] = {};
+      out.write(zeros, off - pos);
+      out.write(static_cast<const char *>(data), size);
+      pos = off + size;
+    };
+    put(0, &header, sizeof(header));
+    put(header.entriesOff, recs.data(), recs.size() * sizeof(EntryRec));
+    put(header.dirsOff, dirs.data(), dirs.size() * sizeof(uint32_t));
+    put(header.mtimesOff, mtimes.data(), mtimes.size() * sizeof(int64_t));
+    put(header.namesOff, nullptr, 0);
+    for (size_t i = 0; i < entries.size(); i++) out.write(entries[i].name.data(), recs[i].nameLen);
+    pos += namesSize;
+    put(header.trigramsOff, trigrams.data(), trigrams.size() * sizeof(TrigramRec));
+    put(header.postingsOff, nullptr, 0);
+    for (auto &e : encoded) out.write(e.data(), e.size());
+    pos += postingsSize;
+    put(header.rootOff, root.data(), root.size());
+    out.close();
+    if (out.fail()) {
+      error = "cannot write " + tmp.string();
+      return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, file, ec);
+    if (ec) {
+      error = file.string() + ": " + ec.message();
+      return false;
+    }
+    return true;
+  }
+
+  bool TrigramIndex::Update(const fs::path &file, WorkerPool &pool, std::string &error, size_t *rescanned) {
+    TrigramIndex old;
+    if (!old.Open(file)) {
+      error = "cannot open index " + file.string();
+      return false;
+    }
+    std::string root = old.Root();
+    if (root.empty()) {
+      error = file.string() + " was built from a preset and has no root to rescan";
+      return false;
+    }
+    int rootFd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+      error = root + ": " + std::strerror(errno);
+      return false;
+    }
+
+    // children of the old entries
+    size_t n = old.Size();
+    std::vector<uint32_t> childStart(n + 1, 0), children(n > 0 ? n - 1 : 0);
+    for (uint32_t id = 1; id < n; id++) childStart[old.entries_[id].parent + 1]++;
+    for (size_t i = 0; i < n; i++) childStart[i + 1] += childStart[i];
+    {
+      std::vector<uint32_t> fill(childStart.begin(), childStart.end() - 1);
+      for (uint32_t id = 1; id < n; id++) children[fill[old.entries_[id].parent]++] = id;
+    }
+    std::vector<int64_t> oldMtime(n, 0);
+    auto dirIds = reinterpret_cast<const uint32_t *>(old.data_ + old.header_->dirsOff);
+    auto dirMtimes = reinterpret_cast<const int64_t *>(old.data_ + old.header_->mtimesOff);
+    for (size_t d = 0; d < old.header_->dirCount; d++) {
+      if (dirIds[d] >= n) {
+        close(rootFd);
+        error = file.string() + " is damaged, build it again";
+        return false;
+      }
+      oldMtime[dirIds[d]] = dirMtimes[d];
+    }
+
+    struct Child {
+      std::string name;
+      bool dir;
+      uint32_t oldId;
+    };
+    struct Listing {
+      int64_t mtime = 0;
+      std::vector<Child> children;
+    };
+
+    std::vector<IndexEntry> fresh{{kNone, "", true, 0}};
+    std::vector<uint32_t> oldOf{n > 0 ? 0 : kNone};
+    std::vector<uint32_t> level{0};
+    std::atomic<size_t> listed{0};
+
+    auto relativePath = [&fresh](uint32_t id) {
+      std::vector<const std::string *> parts;
+      for (; id != 0; id = fresh[id].parent) parts.push_back(&fresh[id].name);
+      std::string path = parts.empty() ? "." : "";
+      for (auto it = parts.rbegin(); it != parts.rend(); it++) {
+        if (!path.empty()) path.push_back('/');
+        path.append(**it);
+      }
+      return path;
+    };
+
+    // level by level: restat in parallel, reuse the old listing of unchanged dirs
+    while (!level.empty()) {
+      std::vector<Listing> listings(level.size());
+      pool.ParallelFor(0, level.size(), [&](size_t k) {
+        uint32_t id = level[k];
+        std::string rel = relativePath(id);
+        struct stat st {};
+        if (fstatat(rootFd, rel.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISDIR(st.st_mode)) return;
+        Listing &listing = listings[k];
+        listing.mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+        uint32_t oid = oldOf[id];
+        if (oid != kNone && oldMtime[oid] != 0 && oldMtime[oid] == listing.mtime) {
+          for (uint32_t c = childStart[oid]; c < childStart[oid + 1]; c++) {
+            uint32_t cid = children[c];
+            listing.children.push_back({old.Name(cid), (old.entries_[cid].flags & kDirFlag) != 0, cid});
+          }
+          return;
+        }
+
+        listed++;
+        std::unordered_map<std::string_view, uint32_t> previous;
+        if (oid != kNone) {
+          for (uint32_t c = childStart[oid]; c < childStart[oid + 1]; c++) {
+            uint32_t cid = children[c];
+            previous.emplace(std::string_view(old.names_ + old.entries_[cid].nameOff, old.entries_[cid].nameLen), cid);
+          }
+        }
+        int fd = openat(rootFd, rel.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) return;
+        DirWalker::ReadDir(fd, [&listing, &previous](const char *name, bool isDir) {
+          auto it = previous.find(name);
+          listing.children.push_back({name, isDir, it == previous.end() ? kNone : it->second});
+        });
+        close(fd);
+      }, 4);
+
+      std::vector<uint32_t> next;
+      for (size_t k = 0; k < level.size(); k++) {
+        fresh[level[k]].mtime = listings[k].mtime;
+        for (auto &child : listings[k].children) {
+          uint32_t id = fresh.size();
+          fresh.push_back({level[k], std::move(child.name), child.dir, 0});
+          oldOf.push_back(child.oldId);
+          if (child.dir) next.push_back(id);
+        }
+      }
+      level.swap(next);
+    }
+    close(rootFd);
+    if (rescanned) *rescanned = listed;
+    return Write(file, root, fresh, pool, error);
+  }
+
+  // QUERY
+
+  bool TrigramIndex::Open(const fs::path &file) {
+    Close();
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+      close(fd);
+      return false;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    data_ = static_cast<const char *>(map);
+    size_ = st.st_size;
+    header_ = reinterpret_cast<const Header *>(data_);
+    if (!Valid()) {
+      Close();
+      return false;
+    }
+    return true;
+  }
+
+  // a damaged or foreign file is refused here, so queries and updates can trust offsets and ids.
+  // sections are checked without sums that could wrap, records one by one, postings as far as their skip tables
+  bool TrigramIndex::Valid() {
+    const Header &h = *header_;
+    // count items of size bytes at off, aligned for them
+    auto fits = [this](uint64_t off, uint64_t count, uint64_t size) {
+      return off <= size_ && count <= (size_ - off) / size && off % std::min<uint64_t>(size, 8) == 0;
+    };
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion || h.blockSize != kBlock ||
+        h.entryCount == 0 || h.entryCount >= kNone || h.dirCount > h.entryCount ||
+        !fits(h.entriesOff, h.entryCount, sizeof(EntryRec)) || !fits(h.dirsOff, h.dirCount, sizeof(uint32_t)) ||
+        !fits(h.mtimesOff, h.dirCount, sizeof(int64_t)) || !fits(h.namesOff, h.namesSize, 1) ||
+        !fits(h.trigramsOff, h.trigramCount, sizeof(TrigramRec)) || !fits(h.postingsOff, h.postingsSize, 1) ||
+        !fits(h.rootOff, h.rootSize, 1)) {
+      return false;
+    }
+    entries_ = reinterpret_cast<const EntryRec *>(data_ + h.entriesOff);
+    trigrams_ = reinterpret_cast<const TrigramRec *>(data_ + h.trigramsOff);
+    names_ = data_ + h.namesOff;
+    postings_ = data_ + h.postingsOff;
+
+    // parents come first, so walking up always ends at the root
+    for (uint64_t id = 0; id < h.entryCount; id++) {
+      auto &e = entries_[id];
+      if ((id > 0 && e.parent >= id) || e.nameOff > h.namesSize || e.nameLen > h.namesSize - e.nameOff) return false;
+    }
+    for (uint64_t t = 0; t < h.trigramCount; t++) {
+      auto &rec = trigrams_[t];
+      uint64_t blocks = (uint64_t(rec.count) + kBlock - 1) / kBlock;
+      if (rec.count == 0 || rec.count > h.entryCount || rec.off % 4 != 0 || rec.off > h.postingsSize ||
+          blocks > (h.postingsSize - rec.off) / 8) {
+        return false;
+      }
+      auto skip = reinterpret_cast<const uint32_t *>(postings_ + rec.off);
+      uint64_t data = h.postingsSize - rec.off - blocks * 8;
+      for (uint64_t b = 0; b < blocks; b++) {
+        if (skip[2 * b] >= h.entryCount || skip[2 * b + 1] > data) return false;
+      }
+    }
+    return true;
+  }
+
+  void TrigramIndex::Close() {
+    if (data_) munmap(const_cast<char *>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+    header_ = nullptr;
+  }
+
+  size_t TrigramIndex::Size() const {
+    return header_ ? header_->entryCount : 0;
+  }
+
+  std::string TrigramIndex::Root() const {
+    return header_ ? std::string(data_ + header_->rootOff, header_->rootSize) : "";
+  }
+
+  std::string TrigramIndex::Name(uint32_t id) const {
+    return std::string(names_ + entries_[id].nameOff, entries_[id].nameLen);
+  }
+
+  std::string TrigramIndex::Path(uint32_t id) const {
+    std::vector<uint32_t> chain;
+    for (; id != 0 && id < Size(); id = entries_[id].parent) chain.push_back(id);
+    std::string path;
+    for (auto it = chain.rbegin(); it != chain.rend(); it++) {
+      if (!path.empty()) path.push_back('/');
+      path.append(names_ + entries_[*it].nameOff, entries_[*it].nameLen);
+    }
+    return path;
+  }
+
+  const TrigramIndex::TrigramRec *TrigramIndex::Find(uint32_t key) const {
+    auto begin = trigrams_, end = trigrams_ + header_->trigramCount;
+    auto it = std::lower_bound(begin, end, key, [](const TrigramRec &rec, uint32_t k) { return rec.key < k; });
+    return it != end && it->key == key ? it : nullptr;
+  }
+
+  // ids containing every trigram of the literals, all -> no trigram to narrow by
+  std::vector<uint32_t> TrigramIndex::Candidates(const std::vector<std::string> &literals, bool &all) const {
+    std::vector<uint32_t> keys, litKeys;
+    for (auto &lit : literals) {
+      Keys(lit, litKeys);
+      keys.insert(keys.end(), litKeys.begin(), litKeys.end());
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    all = keys.empty();
+    std::vector<uint32_t> out;
+    if (all) return out;
+
+    std::vector<const TrigramRec *> recs;
+    for (auto k : keys) {
+      auto rec = Find(k);
+      if (!rec) return out;
+      recs.push_back(rec);
+    }
+    std::sort(recs.begin(), recs.end(), [](const TrigramRec *a, const TrigramRec *b) { return a->count < b->count; });
+    std::vector<Cursor> cursors;
+    for (auto rec : recs) cursors.emplace_back(postings_, header_->postingsSize, *rec);
+
+    auto &lead = cursors[0];
+    while (!lead.Done()) {
+      uint32_t id = lead.Id();
+      // lists only grow, a damaged one runs past the entries
+      if (id >= Size()) return out;
+      bool match = true;
+      for (size_t c = 1; c < cursors.size(); c++) {
+        cursors[c].SeekGE(id);
+        if (cursors[c].Done()) return out;
+        if (cursors[c].Id() != id) {
+          lead.SeekGE(cursors[c].Id());
+          match = false;
+          break;
+        }
+      }
+      if (match) {
+        out.push_back(id);
+        lead.Next();
+      }
+    }
+    return out;
+  }
+
+  std::vector<uint32_t> TrigramIndex::Search(const std::string &query, bool ignoreCase, size_t limit) const {
+    std::vector<uint32_t> out;
+    if (!header_ || query.empty()) return out;
+    bool all = false;
+    auto candidates = Candidates({query}, all);
+    auto check = [&](uint32_t id) {
+      std::string_view name(names_ + entries_[id].nameOff, entries_[id].nameLen);
+      if (Contains(name, query, ignoreCase)) out.push_back(id);
+      return limit == 0 || out.size() < limit;
+    };
+    if (all) {
+      for (uint32_t id = 1; id < Size(); id++)
+        if (!check(id)) break;
+    } else {
+      for (auto id : candidates)
+        if (!check(id)) break;
+    }
+    return out;
+  }
+
+  std::vector<uint32_t> TrigramIndex::SearchRegex(const std::string &pattern, bool ignoreCase, size_t limit) const {
+    std::vector<uint32_t> out;
+    if (!header_) return out;
+    auto flags = std::regex::ECMAScript | std::regex::optimize;
+    if (ignoreCase) flags |= std::regex::icase;
+    std::regex re(pattern, flags);
+    bool all = false;
+    auto candidates = Candidates(RequiredLiterals(pattern), all);
+    std::string name;
+    auto check = [&](uint32_t id) {
+      name.assign(names_ + entries_[id].nameOff, entries_[id].nameLen);
+      if (std::regex_search(name, re)) out.push_back(id);
+      return limit == 0 || out.size() < limit;
+    };
+    if (all) {
+      for (uint32_t id = 1; id < Size(); id++)
+        if (!check(id)) break;
+    } else {
+      for (auto id : candidates)
+        if (!check(id)) break;
+    }
+    return out;
+  }
+}// namespace fstui
\ No newline at end of file
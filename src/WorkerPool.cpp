@@ -0,0 +1,87 @@
+#include <algorithm>// for min, max
+#include <atomic>
+#include <memory>// for shared_ptr, make_shared
+
+#include "WorkerPool.hpp"
+
+namespace fstui {
+
+  WorkerPool::WorkerPool(unsigned threads) : stop_(false) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < threads; i++) {
+      workers_.emplace_back([this] { Run(); });
+    }
+  }
+
+  WorkerPool::~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &w : workers_) w.join();
+  }
+
+  void WorkerPool::Submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.emplace_back(std::move(task));
+    }
+    cv_.notify_one();
+  }
+
+  void WorkerPool::Run() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+        if (stop_ && tasks_.empty()) return;
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  void WorkerPool::ParallelFor(size_t begin, size_t end, const std::function<void(size_t)> &fn, size_t grain) {
+    if (begin >= end) return;
+    grain = std::max<size_t>(1, grain);
+    size_t chunks = (end - begin + grain - 1) / grain;
+    if (chunks == 1 || workers_.empty()) {
+      for (size_t i = begin; i < end; i++) fn(i);
+      return;
+    }
+
+    // helpers may start after the caller already returned, so the shared state outlives this frame
+    struct Shared {
+      std::atomic<size_t> next;
+      std::atomic<size_t> done;
+      std::mutex mutex;
+      std::condition_variable cv;
+    };
+    auto shared = std::make_shared<Shared>();
+    shared->next = 0;
+    shared->done = 0;
+    const std::function<void(size_t)> *body = &fn;
+
+    auto drain = [shared, body, begin, end, grain, chunks]() {
+      for (size_t c = shared->next++; c < chunks; c = shared->next++) {
+        size_t lo = begin + c * grain;
+        size_t hi = std::min(end, lo + grain);
+        for (size_t i = lo; i < hi; i++) (*body)(i);
+        if (++shared->done == chunks) {
+          std::lock_guard<std::mutex> lock(shared->mutex);
+          shared->cv.notify_all();
+        }
+      }
+    };
+
+    size_t helpers = std::min<size_t>(workers_.size(), chunks - 1);
+    for (size_t i = 0; i < helpers; i++) Submit(drain);
+    drain();
+
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->cv.wait(lock, [&shared, chunks] { return shared->done == chunks; });
+  }
+}// namespace fstui
\ No newline at end of file
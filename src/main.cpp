@@ -3,105 +3,643 @@
 #include <vector> 
 #include <filesystem>
 #include <fstream>
+#include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <regex>
+#include <unordered_set>
+#include <cstdlib>
+#include <new>
 
+#include "ArchiveExporter.hpp"
+#include "BatchApply.hpp"
+#include "BinaryPreset.hpp"
+#include "DirTree.hpp"
 #include "DirTreeBase.hpp"
+#include "DirWalker.hpp"
+#include "Encoding.hpp"
+#include "FrameStats.hpp"
+#include "LabelActions.hpp"
+#include "Materializer.hpp"
+#include "Pattern.hpp"
+#include "PresetCache.hpp"
+#include "PresetCatalog.hpp"
+#include "PresetGraph.hpp"
+#include "PresetIO.hpp"
 #include "PresetsBase.hpp"
+#include "TaskRunner.hpp"
+#include "TrigramIndex.hpp"
+#include "WorkerPool.hpp"
 #include "ftxui/component/component.hpp"// for Make, Menu
 #include "stringtoolbox.hpp"
 
+#include "ftxui/component/event.hpp"            // for Event::Custom
 #include "ftxui/component/screen_interactive.hpp"// for Component
 #include "ftxui/dom/elements.hpp"                // for operator|, Element, reflect, text, vbox, Elements, focus, nothing, select
 
+#ifdef FSTUI_COUNT_ALLOCS
+// counted for the HUD, one thread local increment on top of malloc.
+// the aligned overloads (align_val_t) are not replaced, their allocations go uncounted.
+void *operator new(size_t size) {
+  fstui::threadAllocations++;
+  if (size == 0) size = 1;
+  while (true) {
+    if (void *p = std::malloc(size)) return p;
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) throw std::bad_alloc();
+    handler();
+  }
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+#endif
+
+static int Usage() {
+  std::cerr << "usage: fstui [--hud] [target-root]\n"
+               "       fstui apply [--jobs N] [--per-fs N] [--reconcile [--extras] [--prune]] <preset.df> <root>...\n"
+               "       fstui apply [--jobs N] [--per-fs N] [--reconcile [--extras] [--prune]] --job-file <file>\n"
+               "       fstui import [--depth N] [--exclude GLOB]... <dir> <preset.df>\n"
+               "       fstui index (<root> | --preset <preset.df>) <index-file>\n"
+               "       fstui index --update <index-file>\n"
+               "       fstui search [--regex] [-i] [--limit N] <index-file> <query>\n"
+               "       fstui labels [--all L,L...] [--any L,L...] <preset.df>\n"
+               "       fstui convert <preset.df>...\n"
+               "       fstui catalog [--dir <preset-dir>] [--limit N] <query>...\n"
+               "       fstui export [--format tar|cpio] <preset.df> <archive|->\n";
+  return 2;
+}
+
+/*
+ * Headless apply
+ */
+static int ApplyCommand(int argc, const char* argv[]) {
+  using namespace fstui;
+  BatchOptions options;
+  std::vector<ApplyJob> jobs;
+  std::vector<std::string> positional;
+  for (int i = 0; i < argc; i++) {
+    std::string arg = argv[i];
+    if ((arg == "--jobs" || arg == "--per-fs" || arg == "--job-file") && i + 1 < argc) {
+      std::string value = argv[++i];
+      if (arg == "--job-file") {
+        std::string error;
+        if (!BatchApply::ReadJobFile(value, jobs, error)) {
+          std::cerr << error << std::endl;
+          return 1;
+        }
+      } else {
+        try {
+          (arg == "--jobs" ? options.jobs : options.perFs) = std::stoul(value);
+        } catch (const std::exception &) {
+          return Usage();
+        }
+      }
+    } else if (arg == "--reconcile") {
+      options.reconcile = true;
+    } else if (arg == "--extras") {
+      options.reconcileOptions.extras = true;
+    } else if (arg == "--prune") {
+      options.reconcileOptions.prune = true;
+    } else if (arg.rfind("--", 0) == 0) {
+      return Usage();
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (!options.reconcile && (options.reconcileOptions.extras || options.reconcileOptions.prune)) return Usage();
+  if (positional.size() == 1) return Usage();
+  for (size_t i = 1; i < positional.size(); i++) jobs.push_back({positional[0], positional[i]});
+  if (jobs.empty()) return Usage();
+
+  WorkerPool pool;
+  BatchApply batch(pool, options);
+  return batch.Run(jobs, std::cout) > 0 ? 1 : 0;
+}
+
+/*
+ * Import a directory as preset
+ */
+static int ImportCommand(int argc, const char* argv[]) {
+  using namespace fstui;
+  WalkOptions options;
+  std::vector<std::string> positional;
+  for (int i = 0; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--depth" && i + 1 < argc) {
+      try {
+        options.maxDepth = std::stoi(argv[++i]);
+      } catch (const std::exception &) {
+        return Usage();
+      }
+    } else if (arg == "--exclude" && i + 1 < argc) {
+      options.excludes.push_back(argv[++i]);
+    } else if (arg.rfind("--", 0) == 0) {
+      return Usage();
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.size() != 2) return Usage();
+
+  DirWalker walker(options);
+  if (!walker.Walk(positional[0])) {
+    std::cerr << walker.FirstError() << std::endl;
+    return 1;
+  }
+  PresetData data;
+  walker.Linearize(*data.names, data.entries, data.depths);
+  // directories named like a pattern stay one directory
+  for (auto &entry : data.entries) {
+    if (entry.find_first_of("{}") != std::string_view::npos) entry = data.names->Add(Pattern::Escape(entry));
+  }
+  data.labelChecked.Reset(0, data.entries.size());
+  if (!SavePreset(positional[1], data)) {
+    std::cerr << "cannot write " << positional[1] << std::endl;
+    return 1;
+  }
+  std::cout << data.entries.size() << " entries from " << walker.DirCount() << " directories";
+  if (walker.ErrorCount() > 0) std::cout << ", " << walker.ErrorCount() << " errors (" << walker.FirstError() << ")";
+  std::cout << std::endl;
+  return 0;
+}
+
+/*
+ * Filename index
+ */
+static int IndexCommand(int argc, const char* argv[]) {
+  using namespace fstui;
+  WorkerPool pool;
+  std::string error;
+  std::vector<IndexEntry> entries;
+  std::string root;
+  fs::path file;
+  if (argc == 2 && std::string(argv[0]) == "--update") {
+    size_t rescanned = 0;
+    if (!TrigramIndex::Update(argv[1], pool, error, &rescanned)) {
+      std::cerr << error << std::endl;
+      return 1;
+    }
+    std::cout << rescanned << " directories rescanned" << std::endl;
+    return 0;
+  } else if (argc == 3 && std::string(argv[0]) == "--preset") {
+    PresetGraph graph;
+    auto data = graph.Resolve(argv[1], error);
+    if (!data) {
+      std::cerr << error << std::endl;
+      return 1;
+    }
+    size_t n = ExpandedCount(data->entries, data->depths);
+    if (n > kMaxExpanded) {
+      std::cerr << ExpandedError(n) << std::endl;
+      return 1;
+    }
+    TrigramIndex::FromPreset(data->entries, data->depths, entries);
+    file = argv[2];
+  } else if (argc == 2) {
+    WalkOptions options;
+    options.includeFiles = true;
+    DirWalker walker(options);
+    if (!walker.Walk(argv[0])) {
+      std::cerr << walker.FirstError() << std::endl;
+      return 1;
+    }
+    TrigramIndex::FromWalk(walker, entries);
+    root = fs::absolute(argv[0]).string();
+    file = argv[1];
+  } else {
+    return Usage();
+  }
+  if (!TrigramIndex::Write(file, root, entries, pool, error)) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+  std::cout << entries.size() - 1 << " names indexed" << std::endl;
+  return 0;
+}
+
+static int SearchCommand(int argc, const char* argv[]) {
+  using namespace fstui;
+  bool regex = false, ignoreCase = false;
+  size_t limit = 0;
+  std::vector<std::string> positional;
+  for (int i = 0; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--regex") {
+      regex = true;
+    } else if (arg == "-i") {
+      ignoreCase = true;
+    } else if (arg == "--limit" && i + 1 < argc) {
+      try {
+        limit = std::stoul(argv[++i]);
+      } catch (const std::exception &) {
+        return Usage();
+      }
+    } else if (arg.rfind("-", 0) == 0) {
+      return Usage();
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.size() != 2) return Usage();
+
+  TrigramIndex index;
+  if (!index.Open(positional[0])) {
+    std::cerr << "cannot open index " << positional[0] << std::endl;
+    return 1;
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::vector<uint32_t> hits;
+  try {
+    hits = regex ? index.SearchRegex(positional[1], ignoreCase, limit)
+                 : index.Search(positional[1], ignoreCase, limit);
+  } catch (const std::regex_error &e) {
+    std::cerr << "bad regex: " << e.what() << std::endl;
+    return 1;
+  }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  std::string root = index.Root();
+  for (auto id : hits) std::cout << (root.empty() ? "" : root + "/") << index.Path(id) << "\n";
+  std::cerr << hits.size() << " matches in " << ms << " ms" << std::endl;
+  return hits.empty() ? 1 : 0;
+}
+
+/*
+ * Label queries
+ */
+static int LabelsCommand(int argc, const char* argv[]) {
+  using namespace fstui;
+  namespace str = stringtoolbox;
+  std::vector<std::string> all, any;
+  std::vector<std::string> positional;
+  for (int i = 0; i < argc; i++) {
+    std::string arg = argv[i];
+    if ((arg == "--all" || arg == "--any") && i + 1 < argc) {
+      for (auto &l : str::split(argv[++i], ',')) (arg == "--all" ? all : any).push_back(l);
+    } else if (arg.rfind("--", 0) == 0) {
+      return Usage();
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.size() != 1) return Usage();
+
+  PresetGraph graph;
+  std::string error;
+  auto resolved = graph.Resolve(positional[0], error);
+  if (!resolved) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+  const PresetData &data = *resolved;
+  auto toIds = [&data](const std::vector<std::string> &names, std::vector<size_t> &ids) {
+    for (auto &name : names) {
+      auto it = std::find(data.labels.begin(), data.labels.end(), name);
+      if (it == data.labels.end()) {
+        std::cerr << "unknown label " << name << std::endl;
+        return false;
+      }
+      ids.push_back(it - data.labels.begin());
+    }
+    return true;
+  };
+  std::vector<size_t> allIds, anyIds;
+  if (!toIds(all, allIds) || !toIds(any, anyIds)) return 1;
+
+  if (allIds.empty() && anyIds.empty()) {
+    auto counts = data.labelChecked.CountPerLabel();
+    for (size_t l = 0; l < counts.size(); l++) std::cout << data.labels[l] << "\t" << counts[l] << "\n";
+    return 0;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto bits = data.labelChecked.Match(allIds, anyIds);
+  auto rows = LabelStore::RowsOf(bits);
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  // full paths from the depth column
+  std::vector<std::string_view> path;
+  size_t next = 0;
+  for (auto row : rows) {
+    for (; next <= row; next++) {
+      path.resize(data.depths[next]);
+      path.push_back(data.entries[next]);
+    }
+    for (size_t i = 0; i < path.size(); i++) std::cout << (i ? "/" : "") << path[i];
+    std::cout << "\n";
+  }
+  std::cerr << rows.size() << " of " << data.entries.size() << " entries in " << ms << " ms" << std::endl;
+  return rows.empty() ? 1 : 0;
+}
+
+/*
+ * Binary presets
+ */
+static int ConvertCommand(int argc, const char* argv[]) {
+  using namespace fstui;
+  if (argc == 0) return Usage();
+  int failed = 0;
+  for (int i = 0; i < argc; i++) {
+    PresetData data;
+    if (!LoadPreset(argv[i], data) ||
+        !BinaryPreset::Write(argv[i], data.labels, data.entries, data.depths, data.labelChecked)) {
+      std::cerr << "cannot convert " << argv[i] << std::endl;
+      failed++;
+      continue;
+    }
+    std::cout << BinaryPreset::SidecarPath(argv[i]).string() << ": " << data.entries.size() << " entries" << std::endl;
+  }
+  return failed > 0 ? 1 : 0;
+}
+
+/*
+ * Preset catalog
+ */
+static int CatalogCommand(int argc, const char* argv[]) {
+  using namespace fstui;
+  fs::path dir = "presets";
+  size_t limit = 0;
+  std::string query;
+  for (int i = 0; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--dir" && i + 1 < argc) {
+      dir = argv[++i];
+    } else if (arg == "--limit" && i + 1 < argc) {
+      try {
+        limit = std::stoul(argv[++i]);
+      } catch (const std::exception &) {
+        return Usage();
+      }
+    } else if (arg.rfind("--", 0) == 0) {
+      return Usage();
+    } else {
+      query += (query.empty() ? "" : " ") + arg;
+    }
+  }
+  if (query.empty()) return Usage();
+  std::error_code ec;
+  if (!fs::is_directory(dir, ec)) {
+    std::cerr << "no preset directory " << dir.string() << std::endl;
+    return 1;
+  }
+
+  // brings the catalog up to date with the directory first
+  WorkerPool pool;
+  PresetCatalog catalog(pool, dir);
+  std::unordered_set<std::string> present;
+  for (fs::directory_iterator it{dir, ec}, end; !ec && it != end; it.increment(ec)) {
+    if (it->path().extension() != ".df") continue;
+    present.insert(it->path().string());
+    catalog.Refresh(it->path());
+  }
+  catalog.Retain(std::move(present));
+  catalog.Wait();
+
+  auto start = std::chrono::steady_clock::now();
+  auto hits = catalog.Query(query, limit);
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  for (auto &hit : hits) {
+    std::cout << hit.path.string() << "\t" << hit.entries << " entries\tdepth " << hit.maxDepth;
+    for (size_t l = 0; l < hit.labels.size(); l++) std::cout << (l ? "," : "\t") << hit.labels[l];
+    std::cout << "\n";
+  }
+  std::cerr << hits.size() << " of " << catalog.Size() << " presets in " << ms << " ms" << std::endl;
+  return hits.empty() ? 1 : 0;
+}
+
+/*
+ * Archive export
+ */
+static int ExportCommand(int argc, const char* argv[]) {
+  using namespace fstui;
+  std::string format;
+  std::vector<std::string> positional;
+  for (int i = 0; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--format" && i + 1 < argc) {
+      format = argv[++i];
+    } else if (arg.rfind("--", 0) == 0) {
+      return Usage();
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.size() != 2) return Usage();
+  ArchiveExporter::Format kind = ArchiveExporter::FormatFor(positional[1]);
+  if (!format.empty() && !ArchiveExporter::ParseFormat(format, kind)) return Usage();
+
+  PresetGraph graph;
+  std::string error;
+  auto data = graph.Resolve(positional[0], error);
+  if (!data) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+  // label actions from next to the preset, as apply does
+  LabelActions actions;
+  auto actionsFile = LabelActions::FileFor(fs::path(positional[0]).parent_path());
+  std::error_code ec;
+  if (fs::exists(actionsFile, ec)) {
+    if (!actions.Read(actionsFile, error)) {
+      std::cerr << error << std::endl;
+      return 1;
+    }
+    actions.Bind(data->labels, data->labelChecked);
+  }
+
+  ArchiveExporter exporter(kind);
+  auto stats = exporter.Run(data->entries, data->depths, positional[1], nullptr, &actions);
+  std::wcerr << stats.Summary() << std::endl;
+  if (!stats.firstError.empty()) std::cerr << stats.firstError << std::endl;
+  return stats.failed > 0 ? 1 : 0;
+}
+
 int main(int argc, const char* argv[]) {
+  if (argc > 1 && std::string(argv[1]) == "apply") return ApplyCommand(argc - 2, argv + 2);
+  if (argc > 1 && std::string(argv[1]) == "import") return ImportCommand(argc - 2, argv + 2);
+  if (argc > 1 && std::string(argv[1]) == "index") return IndexCommand(argc - 2, argv + 2);
+  if (argc > 1 && std::string(argv[1]) == "search") return SearchCommand(argc - 2, argv + 2);
+  if (argc > 1 && std::string(argv[1]) == "labels") return LabelsCommand(argc - 2, argv + 2);
+  if (argc > 1 && std::string(argv[1]) == "convert") return ConvertCommand(argc - 2, argv + 2);
+  if (argc > 1 && std::string(argv[1]) == "catalog") return CatalogCommand(argc - 2, argv + 2);
+  if (argc > 1 && std::string(argv[1]) == "export") return ExportCommand(argc - 2, argv + 2);
+  // frame timings shown from the start, Ctrl+P toggles them anyway
+  bool hud = argc > 1 && std::string(argv[1]) == "--hud";
+  if (hud) {
+    argc--;
+    argv++;
+  }
+  if (argc > 1 && argv[1][0] == '-') return Usage();
+
   using namespace ftxui;
   using namespace fstui;
   namespace fs = std::filesystem;
   namespace str = stringtoolbox;
 
   // tree
-  std::vector<std::wstring> entries;
-  std::vector<short> depths;
+  DirTree dirTree;
   int selected = 0;
   std::vector<ConstStringRef> labels;
-  std::vector<std::vector<bool>> labelChecked;
-  auto tree = std::make_shared<DirTreeBase>(entries, depths, selected, labels, labelChecked, "Directory Tree");
-
-  auto onSave = [&labels, &entries, &depths, &selected, &labelChecked](fs::path &path) {
-    std::wofstream f(path);
-    if (labels.size() > 0) {
-      f << "|";
-      for (auto l : labels) f << *l << "|";
-      f << std::endl;
-    }
-    for (size_t i = 0; i < entries.size(); i++) {
-      for (auto j = 0; j < depths[i]; j++) f << '\t';
-      f << entries[i];
-      if (labels.size() > 0) {
-        f << " |";
-        for (auto l : labelChecked[i]) f << (l ? '1' : '0');
-        f << "|";
-      }
-      f << std::endl;
-    }
-    f.close();
-  };
+  auto tree = std::make_shared<DirTreeBase>(dirTree, selected, labels, "Directory Tree");
 
-  auto onLoad = [&labels, &entries, &depths, &selected, &labelChecked, &tree](fs::path &path) {
-    labels = std::vector<ConstStringRef>();
-    entries = {};
-    depths = {};
-    selected = 0;
-    labelChecked = {};
+  // the watcher and task threads post to screen until preset and tasks are destroyed, so it is declared first
+  auto screen = ScreenInteractive::Fullscreen();
+  auto post = [&screen] { screen.PostEvent(Event::Custom); };
+  std::shared_ptr<PresetsBase> preset;
 
-    if (!exists(path)) {
-      tree->Init();
-      return;
-    }
+  // parsed presets are kept, and the neighbours of the focused one parsed ahead on the pool
+  WorkerPool pool;
+  PresetCache presetCache(pool);
+  // includes are resolved when materializing, presets they name stay cached until they change
+  PresetGraph graph;
+  // load, save and materialize run here, the tree is exported on the UI thread before handing it over
+  TaskRunner tasks(post);
 
-    std::ifstream file(path.string());
-    std::string line;
-    if (file.is_open()) {
-      // load labels
-      if (getline(file, line)) {
-        auto options = str::split(line,'|');
-        if (options.size() > 2) {
-          for (auto it = options.begin() + 1; it < options.end()-1; it++) labels.push_back({*it});
-        }
-      } else {
-        // no labels used
-        file.clear();
-        file.seekg(0);
-      }
-      // load selection
-      while(getline(file, line) && line.size() > 0) {
-        depths.push_back(std::count(line.begin(), line.end(), '\t'));
-        line = str::ltrim(line);
-        auto labelPos = line.find(" |");
-        auto entry = line.substr(0,labelPos);
-        auto label = line.substr(labelPos+2, labels.size());
-        std::vector<bool> labelVec;
-        for (auto l : label) labelVec.push_back(l == '1');
-        entries.push_back(std::wstring(entry.begin(), entry.end()));
-        labelChecked.push_back(labelVec);
-      }
-      file.close();
+  // collapsed entries are read from the preset as they are expanded, without them the tree is not whole
+  const std::wstring kChangedOnDisk = L"the loaded preset changed on disk, load it again";
+  auto onSave = [&labels, &dirTree, &tasks, &preset, &kChangedOnDisk](fs::path &path) {
+    auto data = std::make_shared<PresetData>();
+    if (!dirTree.Export(*data)) {
+      preset->SetStatus(kChangedOnDisk);
+      return;
     }
+    for (auto &l : labels) data->labels.push_back(ToUtf8(*l));
+    tasks.Run(
+            L"Saving", [data, path](TaskProgress &progress) { SavePreset(path, *data, &progress); },
+            [&preset](bool cancelled) {
+              if (cancelled) preset->SetStatus(L"save cancelled");
+            });
+  };
 
-    tree->Init();
+  auto onLoad = [&labels, &dirTree, &selected, &tree, &presetCache, &tasks](fs::path &path) {
+    auto model = std::make_shared<std::shared_ptr<const PresetModel>>();
+    tasks.Run(
+            L"Loading", [model, path, &presetCache](TaskProgress &) { *model = presetCache.Get(path); },
+            [model, &labels, &dirTree, &selected, &tree](bool cancelled) {
+              if (cancelled) return;
+              labels = std::vector<ConstStringRef>();
+              dirTree.Clear();
+              selected = 0;
+              if (*model) {
+                for (auto &l : (*model)->labels) labels.push_back({l});
+                dirTree = (*model)->tree;
+              }
+              tree->Init();
+            });
   };
+  auto onPrefetch = [&presetCache](fs::path &path) { presetCache.Prefetch(path); };
 
   /*
    * Save to
    */
-  auto onAction = [](fs::path &path) {
+  fs::path targetRoot = argc > 1 ? fs::path(argv[1]) : fs::current_path();
+  auto onAction = [&labels, &dirTree, &targetRoot, &pool, &preset, &tasks, &graph, &kChangedOnDisk](fs::path &path) {
+    auto data = std::make_shared<PresetData>();
+    if (!dirTree.Export(*data)) {
+      preset->SetStatus(kChangedOnDisk);
+      return;
+    }
+    for (auto &l : labels) data->labels.push_back(ToUtf8(*l));
+    // labels.actions in the preset directory, read again on every run
+    auto actions = std::make_shared<LabelActions>();
+    auto actionsFile = LabelActions::FileFor(path.parent_path());
+    std::string error;
+    std::error_code ec;
+    if (fs::exists(actionsFile, ec) && !actions->Read(actionsFile, error)) {
+      preset->SetStatus(FromUtf8(error));
+      return;
+    }
+    auto stats = std::make_shared<MaterializeStats>();
+    auto includeError = std::make_shared<std::string>();
+    tasks.Run(
+            L"Materializing",
+            [data, path, actions, stats, includeError, &targetRoot, &pool, &graph](TaskProgress &progress) {
+              auto resolved = graph.Resolve(data, path, *includeError);
+              if (!resolved) return;
+              actions->Bind(resolved->labels, resolved->labelChecked);
+              Materializer materializer(pool);
+              *stats = materializer.Run(resolved->entries, resolved->depths, targetRoot, &progress, actions.get());
+            },
+            [stats, includeError, &preset](bool) {
+              if (!includeError->empty()) {
+                preset->SetStatus(FromUtf8(*includeError));
+                return;
+              }
+              auto status = stats->Summary();
+              if (!stats->firstError.empty()) status += L" - " + FromUtf8(stats->firstError);
+              preset->SetStatus(status);
+            });
+  };
 
+  /*
+   * Export to target-root/<preset>.tar
+   */
+  auto onExport = [&labels, &dirTree, &targetRoot, &preset, &tasks, &graph, &kChangedOnDisk](fs::path &path) {
+    auto data = std::make_shared<PresetData>();
+    if (!dirTree.Export(*data)) {
+      preset->SetStatus(kChangedOnDisk);
+      return;
+    }
+    for (auto &l : labels) data->labels.push_back(ToUtf8(*l));
+    auto actions = std::make_shared<LabelActions>();
+    auto actionsFile = LabelActions::FileFor(path.parent_path());
+    std::string error;
+    std::error_code ec;
+    if (fs::exists(actionsFile, ec) && !actions->Read(actionsFile, error)) {
+      preset->SetStatus(FromUtf8(error));
+      return;
+    }
+    auto archive = targetRoot / path.filename().replace_extension(".tar");
+    auto stats = std::make_shared<ExportStats>();
+    auto includeError = std::make_shared<std::string>();
+    tasks.Run(
+            L"Exporting",
+            [data, path, actions, archive, stats, includeError, &graph](TaskProgress &progress) {
+              auto resolved = graph.Resolve(data, path, *includeError);
+              if (!resolved) return;
+              actions->Bind(resolved->labels, resolved->labelChecked);
+              ArchiveExporter exporter(ArchiveExporter::TAR);
+              *stats = exporter.Run(resolved->entries, resolved->depths, archive, &progress, actions.get());
+            },
+            [stats, archive, includeError, &preset](bool) {
+              if (!includeError->empty()) {
+                preset->SetStatus(FromUtf8(*includeError));
+                return;
+              }
+              auto status = FromUtf8(archive.filename().string()) + L": " + stats->Summary();
+              if (!stats->firstError.empty()) status += L" - " + FromUtf8(stats->firstError);
+              preset->SetStatus(status);
+            });
   };
 
-  auto preset = std::make_shared<PresetsBase>("presets", "---", "Presets", onSave, onLoad, onAction);
+  preset = std::make_shared<PresetsBase>("presets", "Materialize", "Presets", onSave, onLoad, onAction, post, onPrefetch);
+  preset->SetTasks(&tasks);
+  preset->SetExport("Export", onExport);
+  // presets/.catalog, indexed on the pool as the watcher reports presets
+  PresetCatalog catalog(pool, "presets", post);
+  preset->SetCatalog(&catalog);
 
-  auto screen = ScreenInteractive::Fullscreen();
-  screen.Loop(Container::Horizontal({preset, tree}));
+  // render and event timings of both windows, declared before the components pointing into it
+  FrameStats frameStats(hud);
+  frameStats.SetEntries([&dirTree] { return dirTree.Size(); });
+
+  // finished tasks report back through posted events, Esc cancels whatever is running
+  auto windows = Container::Horizontal({frameStats.Wrap(preset, "Presets"), frameStats.Wrap(tree, "Directory Tree")});
+  auto root = CatchEvent(windows, [&tasks](Event event) {
+    tasks.Poll();
+    if (event == Event::Escape && tasks.Busy()) {
+      tasks.Cancel();
+      tasks.Poll();
+      return true;
+    }
+    return false;
+  });
+  screen.Loop(frameStats.Root(root));
 
   return 0;
 }
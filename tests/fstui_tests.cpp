@@ -0,0 +1,1043 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "ArchiveExporter.hpp"
+#include "BinaryPreset.hpp"
+#include "DirTree.hpp"
+#include "FuzzyFilter.hpp"
+#include "LabelActions.hpp"
+#include "LabelStore.hpp"
+#include "Pattern.hpp"
+#include "PresetCatalog.hpp"
+#include "PresetGraph.hpp"
+#include "PresetIO.hpp"
+#include "Reconciler.hpp"
+#include "TrigramIndex.hpp"
+#include "WorkerPool.hpp"
+#include "stringtoolbox.hpp"
+
+using namespace fstui;
+
+namespace {
+  int failures = 0;
+
+#define CHECK(cond)                                                               \
+  do {                                                                            \
+    if (!(cond)) {                                                                \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": " << #cond << std::endl;     \
+      failures++;                                                                 \
+      return;                                                                     \
+    }                                                                             \
+  } while (0)
+
+  // fresh directory under the system temp, removed by the destructor
+  struct TempDir {
+    fs::path path;
+    explicit TempDir(const std::string &name) {
+      path = fs::temp_directory_path() / ("fstui_tests_" + std::to_string(getpid()) + "_" + name);
+      fs::remove_all(path);
+      fs::create_directories(path);
+    }
+    ~TempDir() {
+      std::error_code ec;
+      fs::remove_all(path, ec);
+    }
+  };
+
+  PresetData Preset(const std::vector<std::string> &names, const std::vector<short> &depths) {
+    PresetData data;
+    for (auto &name : names) data.entries.push_back(data.names->Add(name));
+    data.depths = depths;
+    data.labelChecked.Reset(0, names.size());
+    return data;
+  }
+
+  std::string Contents(const fs::path &file) {
+    std::ifstream in(file);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+  }
+
+  /*
+   * DirTree against plain vectors
+   */
+
+  // the rows a DirTree should show, collapsed children by the name of their parent
+  struct Rows {
+    std::vector<std::string> names;
+    std::vector<short> depths;
+  };
+
+  struct Model {
+    Rows rows;
+    std::map<std::string, Rows> stash;
+
+    size_t Size() const { return rows.names.size(); }
+
+    size_t End(size_t row) const {
+      size_t end = row + 1;
+      while (end < Size() && rows.depths[end] > rows.depths[row]) end++;
+      return end;
+    }
+    size_t Parent(size_t row) const {
+      for (size_t r = row; r-- > 0;) {
+        if (rows.depths[r] < rows.depths[row]) return r;
+      }
+      return DirTree::npos;
+    }
+    size_t Prev(size_t row) const {
+      for (size_t r = row; r-- > 0;) {
+        if (rows.depths[r] <= rows.depths[row]) return rows.depths[r] == rows.depths[row] ? r : DirTree::npos;
+      }
+      return DirTree::npos;
+    }
+    size_t Next(size_t row) const {
+      size_t end = End(row);
+      return end < Size() && rows.depths[end] == rows.depths[row] ? end : DirTree::npos;
+    }
+
+    // levels held below name while it is collapsed
+    short Hidden(const std::string &name) const {
+      auto it = stash.find(name);
+      if (it == stash.end()) return 0;
+      short deepest = 0;
+      for (size_t i = 0; i < it->second.names.size(); i++) {
+        deepest = std::max<short>(deepest, it->second.depths[i] + Hidden(it->second.names[i]));
+      }
+      return deepest;
+    }
+
+    bool Fit(size_t row, short span, short &depth) const {
+      int upper = row > 0 ? rows.depths[row - 1] + 1 : 0;
+      upper = std::min(upper, DirTree::kMaxDepth - span);
+      int lower = row < Size() ? std::max(0, rows.depths[row] - 1) : 0;
+      if (lower > upper) return false;
+      depth = std::max(lower, std::min<int>(depth, upper));
+      return true;
+    }
+
+    void Insert(size_t row, short depth, const std::string &name) {
+      row = std::min(row, Size());
+      Fit(row, 0, depth);
+      rows.names.insert(rows.names.begin() + row, name);
+      rows.depths.insert(rows.depths.begin() + row, depth);
+    }
+
+    void Remove(size_t row) {
+      size_t end = End(row);
+      rows.names.erase(rows.names.begin() + row, rows.names.begin() + end);
+      rows.depths.erase(rows.depths.begin() + row, rows.depths.begin() + end);
+    }
+
+    size_t Move(size_t row, size_t before, short depth) {
+      size_t end = End(row);
+      if (before > row && before < end) return row;
+      short old = rows.depths[row];
+      short span = 0;
+      for (size_t r = row; r < end; r++) span = std::max<short>(span, rows.depths[r] + Hidden(rows.names[r]) - old);
+      Rows block{{rows.names.begin() + row, rows.names.begin() + end}, {rows.depths.begin() + row, rows.depths.begin() + end}};
+      rows.names.erase(rows.names.begin() + row, rows.names.begin() + end);
+      rows.depths.erase(rows.depths.begin() + row, rows.depths.begin() + end);
+      size_t at = before <= row ? before : before - (end - row);
+      if (!Fit(at, span, depth)) {
+        at = row;
+        depth = old;
+      }
+      for (auto &d : block.depths) d += depth - old;
+      rows.names.insert(rows.names.begin() + at, block.names.begin(), block.names.end());
+      rows.depths.insert(rows.depths.begin() + at, block.depths.begin(), block.depths.end());
+      return at;
+    }
+    size_t MoveUp(size_t row) {
+      short depth = rows.depths[row];
+      size_t prev = Prev(row);
+      if (prev != DirTree::npos) return Move(row, prev, depth);
+      if (depth > 0) return Move(row, Parent(row), depth - 1);
+      return row;
+    }
+    size_t MoveDown(size_t row) {
+      short depth = rows.depths[row];
+      size_t next = Next(row);
+      if (next != DirTree::npos) return Move(row, End(next), depth);
+      if (depth > 0) return Move(row, End(row), depth - 1);
+      return row;
+    }
+
+    void Collapse(size_t row) {
+      if (stash.count(rows.names[row])) Expand(row);
+      size_t end = End(row);
+      if (end == row + 1) return;
+      Rows &children = stash[rows.names[row]];
+      for (size_t r = row + 1; r < end; r++) {
+        children.names.push_back(rows.names[r]);
+        children.depths.push_back(rows.depths[r] - rows.depths[row]);
+      }
+      rows.names.erase(rows.names.begin() + row + 1, rows.names.begin() + end);
+      rows.depths.erase(rows.depths.begin() + row + 1, rows.depths.begin() + end);
+    }
+    void Expand(size_t row) {
+      auto it = stash.find(rows.names[row]);
+      if (it == stash.end()) return;
+      for (auto &d : it->second.depths) d += rows.depths[row];
+      rows.names.insert(rows.names.begin() + row + 1, it->second.names.begin(), it->second.names.end());
+      rows.depths.insert(rows.depths.begin() + row + 1, it->second.depths.begin(), it->second.depths.end());
+      stash.erase(it);
+    }
+
+    // what Export gives, collapsed children in place
+    void Flatten(const Rows &from, short base, Rows &out) const {
+      for (size_t i = 0; i < from.names.size(); i++) {
+        out.names.push_back(from.names[i]);
+        out.depths.push_back(from.depths[i] + base);
+        auto it = stash.find(from.names[i]);
+        if (it != stash.end()) Flatten(it->second, from.depths[i] + base, out);
+      }
+    }
+  };
+
+  void TreapMatchesVectors() {
+    std::mt19937 rng(20240611);
+    DirTree tree;
+    Model model;
+    size_t named = 0;
+    auto name = [&] { return "n" + std::to_string(named++); };
+    for (int i = 0; i < 64; i++) {
+      short depth = model.Size() ? rng() % (model.rows.depths.back() + 2) : 0;
+      std::string n = name();
+      tree.Insert(tree.Size(), depth, n);
+      model.Insert(model.Size(), depth, n);
+    }
+
+    for (int step = 0; step < 20000; step++) {
+      size_t size = model.Size();
+      size_t row = rng() % size;
+      short depth = rng() % 8;
+      switch (rng() % 10) {
+        case 0:
+        case 1: {
+          std::string n = name();
+          size_t at = rng() % (size + 1);
+          tree.Insert(at, depth, n);
+          model.Insert(at, depth, n);
+          break;
+        }
+        case 2:
+          // keep a few rows around
+          if (model.End(row) - row < size && size > 16) {
+            tree.Remove(row);
+            model.Remove(row);
+          }
+          break;
+        case 3: {
+          size_t before = rng() % (size + 1);
+          CHECK(tree.Move(row, before, depth) == model.Move(row, before, depth));
+          break;
+        }
+        case 4:
+          CHECK(tree.MoveUp(row) == model.MoveUp(row));
+          break;
+        case 5:
+          CHECK(tree.MoveDown(row) == model.MoveDown(row));
+          break;
+        case 6: {
+          int delta = rng() % 2 ? 1 : -1;
+          short old = model.rows.depths[row];
+          model.Move(row, row, old + delta);
+          CHECK(tree.Indent(row, delta) == (model.rows.depths[row] != old));
+          break;
+        }
+        case 7:
+          tree.Collapse(row);
+          model.Collapse(row);
+          break;
+        case 8:
+          CHECK(tree.Expand(row));
+          model.Expand(row);
+          break;
+        case 9: {
+          CHECK(tree.SubtreeEnd(row) == model.End(row));
+          CHECK(tree.Parent(row) == model.Parent(row));
+          CHECK(tree.PrevSibling(row) == model.Prev(row));
+          CHECK(tree.NextSibling(row) == model.Next(row));
+          break;
+        }
+      }
+
+      CHECK(tree.Size() == model.Size());
+      for (size_t r = 0; r < model.Size(); r++) {
+        CHECK(tree.DepthAt(r) == model.rows.depths[r]);
+        CHECK(tree.Name(tree.At(r)) == model.rows.names[r]);
+        CHECK(tree.Row(tree.At(r)) == r);
+        CHECK(tree.Collapsed(tree.At(r)) == (model.stash.count(model.rows.names[r]) > 0));
+      }
+      if (step % 500 == 0) {
+        PresetData data;
+        CHECK(tree.Export(data));
+        Rows flat;
+        model.Flatten(model.rows, 0, flat);
+        CHECK(data.entries.size() == flat.names.size());
+        for (size_t r = 0; r < flat.names.size(); r++) {
+          CHECK(data.entries[r] == flat.names[r]);
+          CHECK(data.depths[r] == flat.depths[r]);
+        }
+      }
+    }
+  }
+
+  // a snapshot keeps its rows and labels while the copy is edited
+  void SnapshotsKeepTheirRows() {
+    PresetData data = Preset({"a", "b", "c", "d"}, {0, 1, 1, 0});
+    data.labelChecked.Reset(2, 4);
+    data.labelChecked.Set(1, 1, true);
+    DirTree tree;
+    tree.Assign(std::move(data));
+    DirTree snapshot = tree;
+    tree.ToggleLabel(tree.At(2), 0);
+    tree.SetLabel(tree.At(1), 1, false);
+    tree.Remove(0);
+    CHECK(tree.Size() == 1 && snapshot.Size() == 4);
+    CHECK(snapshot.Label(snapshot.At(1), 1) && !snapshot.Label(snapshot.At(2), 0));
+    CHECK(snapshot.Name(snapshot.At(2)) == "c");
+  }
+
+  /*
+   * LabelStore against a row per vector
+   */
+
+  // rows shift across word boundaries and through column growth, queries run the picked kernels on every tail length
+  void LabelsMatchVectors() {
+    const size_t labels = 3;
+    std::mt19937 rng(11);
+    std::vector<std::vector<bool>> model;
+    LabelStore store(labels, 0);
+    auto check = [&]() {
+      CHECK(store.Rows() == model.size());
+      for (size_t row = 0; row < model.size(); row++) {
+        for (size_t l = 0; l < labels; l++) CHECK(store.Get(row, l) == model[row][l]);
+      }
+      std::vector<size_t> counts(labels, 0), all, any;
+      for (size_t row = 0; row < model.size(); row++) {
+        for (size_t l = 0; l < labels; l++) counts[l] += model[row][l];
+        if (model[row][0] && model[row][1]) all.push_back(row);
+        if (model[row][0] && (model[row][1] || model[row][2])) any.push_back(row);
+      }
+      CHECK(store.CountPerLabel() == counts);
+      auto both = store.Match({0, 1});
+      CHECK(LabelStore::RowsOf(both) == all && LabelStore::Count(both) == all.size());
+      auto either = store.Match({0}, {1, 2});
+      CHECK(LabelStore::RowsOf(either) == any && LabelStore::Count(either) == any.size());
+      CHECK(LabelStore::Count(store.Match({})) == model.size() && store.Match({labels}) == std::vector<uint64_t>(both.size(), 0));
+    };
+    for (int step = 0; step < 1500; step++) {
+      size_t n = model.size();
+      // inserts win until past the first column growth, then the sizes wander
+      bool insert = n < 600 ? rng() % 4 != 0 : rng() % 2 == 0;
+      size_t at = rng() % (n + 1);
+      // the edges of a word more often than chance
+      if (rng() % 3 == 0) {
+        size_t edge = 64 * (1 + rng() % 10) + rng() % 3;
+        at = std::min(n, edge - 1);
+      }
+      if (insert) {
+        store.InsertRow(at);
+        model.insert(model.begin() + at, std::vector<bool>(labels, false));
+        for (size_t l = 0; l < labels; l++) {
+          bool value = rng() % 2;
+          store.Set(at, l, value);
+          model[at][l] = value;
+        }
+      } else if (at < n) {
+        store.EraseRow(at);
+        model.erase(model.begin() + at);
+      }
+      if (step % 25 == 0 || model.size() % 64 < 2) check();
+      if (failures) return;
+    }
+    check();
+  }
+
+  /*
+   * TrigramIndex
+   */
+
+  // names over a small alphabet, so trigram postings run over many blocks
+  void IndexRoundTrips() {
+    TempDir dir("index");
+    std::mt19937 rng(7);
+    std::vector<std::string> names;
+    std::vector<short> depths;
+    std::set<std::string> unique;
+    short depth = 0;
+    while (names.size() < 20000) {
+      std::string name;
+      for (size_t k = 3 + rng() % 6; k > 0; k--) name.push_back("abcdE"[rng() % 5]);
+      name += "_" + std::to_string(names.size());
+      names.push_back(name);
+      depths.push_back(depth);
+      depth = std::max(0, std::min<int>(depth + int(rng() % 3) - 1, 6));
+    }
+    PresetData data = Preset(names, depths);
+    std::vector<IndexEntry> entries;
+    TrigramIndex::FromPreset(data.entries, data.depths, entries);
+
+    WorkerPool pool;
+    std::string error;
+    fs::path file = dir.path / "names.idx";
+    CHECK(TrigramIndex::Write(file, "", entries, pool, error));
+    TrigramIndex index;
+    CHECK(index.Open(file));
+    CHECK(index.Size() == entries.size());
+
+    // paths of the model entries whose name holds query
+    auto expected = [&](const std::string &query, bool ignoreCase) {
+      std::multiset<std::string> out;
+      std::vector<std::string> paths(entries.size());
+      auto lower = [](std::string s) {
+        for (auto &c : s) c = std::tolower((unsigned char) c);
+        return s;
+      };
+      for (size_t i = 1; i < entries.size(); i++) {
+        auto &e = entries[i];
+        paths[i] = e.parent == 0 ? e.name : paths[e.parent] + "/" + e.name;
+        bool hit = ignoreCase ? lower(e.name).find(lower(query)) != std::string::npos : e.name.find(query) != std::string::npos;
+        if (hit) out.insert(paths[i]);
+      }
+      return out;
+    };
+
+    for (std::string query : {"abc", "dEa", "ddd", "_19", "ab_1", "Ed", "cdEab", "zzz", "ABC"}) {
+      for (bool ignoreCase : {false, true}) {
+        auto ids = index.Search(query, ignoreCase, 0);
+        CHECK(std::is_sorted(ids.begin(), ids.end()));
+        CHECK(std::adjacent_find(ids.begin(), ids.end()) == ids.end());
+        std::multiset<std::string> got;
+        for (auto id : ids) got.insert(index.Path(id));
+        CHECK(got == expected(query, ignoreCase));
+      }
+    }
+    CHECK(index.Search("abc", false, 5).size() == 5);
+  }
+
+  // escapes spelling a character by code are no literals, the candidates must not be narrowed by them
+  void RegexEscapesKeepCandidates() {
+    TempDir dir("regex");
+    PresetData data = Preset({"Abcdef.txt", "foo.bar", "other"}, {0, 0, 0});
+    std::vector<IndexEntry> entries;
+    TrigramIndex::FromPreset(data.entries, data.depths, entries);
+    WorkerPool pool;
+    std::string error;
+    fs::path file = dir.path / "names.idx";
+    CHECK(TrigramIndex::Write(file, "", entries, pool, error));
+    TrigramIndex index;
+    CHECK(index.Open(file));
+    for (std::string pattern : {"Abcdef", "\\x41bcdef", "\\u0041bcdef", "foo\\.bar", "foo\\x2ebar", "\\cJ?Abcdef",
+                                "(A)\\1?bcdef", "\\w\\x62cdef\\.txt"}) {
+      CHECK(index.SearchRegex(pattern, false, 0).size() == 1);
+    }
+  }
+
+  // header fields and records as Write lays them out
+  struct IndexLayout {
+    uint64_t entryCount, dirCount, trigramCount, entriesOff, dirsOff, mtimesOff, namesOff, namesSize;
+    uint64_t trigramsOff, postingsOff, postingsSize, rootOff, rootSize;
+  };
+
+  template<typename T>
+  T ReadAt(const std::string &bytes, size_t at) {
+    T value;
+    std::memcpy(&value, bytes.data() + at, sizeof(value));
+    return value;
+  }
+
+  template<typename T>
+  void PutAt(std::string &bytes, size_t at, T value) {
+    std::memcpy(&bytes[at], &value, sizeof(value));
+  }
+
+  // damaged indexes are refused by Open or Update, queries over a damaged posting list stop early
+  void DamagedIndexesAreRefused() {
+    TempDir dir("index_damaged");
+    fs::create_directories(dir.path / "tree");
+    std::vector<std::string> names;
+    for (int i = 0; i < 300; i++) names.push_back(std::string("aaa") + char('a' + i / 26) + char('a' + i % 26));
+    PresetData data = Preset(names, std::vector<short>(names.size(), 0));
+    std::vector<IndexEntry> entries;
+    TrigramIndex::FromPreset(data.entries, data.depths, entries);
+    WorkerPool pool;
+    std::string error;
+    fs::path file = dir.path / "names.idx";
+    CHECK(TrigramIndex::Write(file, (dir.path / "tree").string(), entries, pool, error));
+    std::string good = Contents(file);
+    auto h = ReadAt<IndexLayout>(good, 16);
+    auto opens = [&file](const std::string &bytes) {
+      std::ofstream(file, std::ios::binary | std::ios::trunc) << bytes;
+      TrigramIndex index;
+      return index.Open(file);
+    };
+    CHECK(opens(good));
+
+    std::vector<std::string> damaged(8, good);
+    PutAt<uint64_t>(damaged[0], 16, UINT64_MAX);                          // entry count
+    PutAt<uint64_t>(damaged[1], 40, UINT64_MAX - 7);                      // entries wrapping the address space
+    PutAt<uint64_t>(damaged[2], 112, good.size());                        // root past the end
+    PutAt<uint32_t>(damaged[3], h.entriesOff + 16 * 2 + 8, 7);            // a parent after its child
+    PutAt<uint64_t>(damaged[4], h.entriesOff + 16 * 5, h.namesSize);      // a name past the names
+    PutAt<uint64_t>(damaged[5], h.trigramsOff + 16 + 8, h.postingsSize);  // postings past the section
+    PutAt<uint32_t>(damaged[6], h.postingsOff, uint32_t(h.entryCount));   // a skip table id past the entries
+    damaged[7].resize(h.postingsOff + h.postingsSize / 2);
+    for (auto &bytes : damaged) CHECK(!opens(bytes));
+
+    // the first trigram is "aaa", in every entry: its varints turned into one that never ends
+    std::string bytes = good;
+    uint32_t count = ReadAt<uint32_t>(good, h.trigramsOff + 4);
+    uint64_t next = h.trigramCount > 1 ? ReadAt<uint64_t>(good, h.trigramsOff + 16 + 8) : h.postingsSize;
+    uint64_t blocks = (count + 127) / 128;
+    CHECK(count == names.size() && blocks > 1);
+    std::fill(bytes.begin() + h.postingsOff + blocks * 8, bytes.begin() + h.postingsOff + next, char(0xFF));
+    CHECK(opens(bytes));
+    {
+      TrigramIndex index;
+      CHECK(index.Open(file));
+      auto ids = index.Search("aaa", false, 0);
+      CHECK(!ids.empty() && ids.size() < names.size() && ids.back() < index.Size());
+    }
+
+    // dirs are only read by Update
+    bytes = good;
+    CHECK(h.dirCount > 0);
+    PutAt<uint32_t>(bytes, h.dirsOff, uint32_t(h.entryCount));
+    CHECK(opens(bytes));
+    CHECK(!TrigramIndex::Update(file, pool, error) && error.find("damaged") != std::string::npos);
+    CHECK(opens(good) && TrigramIndex::Update(file, pool, error));
+  }
+
+  /*
+   * PresetCatalog
+   */
+
+  // a record cut short by a crash drops that record only, the log is rewritten whole
+  void CatalogLoadsPastTornTail() {
+    TempDir dir("catalog");
+    WorkerPool pool;
+    std::vector<std::string> words{"alpha", "beta", "gamma"};
+    for (auto &word : words) {
+      PresetData data = Preset({word + "_root", word}, {0, 1});
+      CHECK(SavePreset(dir.path / (word + ".df"), data));
+    }
+    {
+      PresetCatalog catalog(pool, dir.path);
+      // one record after another, gamma's last in the log
+      for (auto &word : words) {
+        catalog.Refresh(dir.path / (word + ".df"));
+        catalog.Wait();
+      }
+      CHECK(catalog.Query("gamma").size() == 1);
+    }
+    fs::path log = PresetCatalog::FileFor(dir.path);
+    size_t full = fs::file_size(log);
+    fs::resize_file(log, full - 3);
+    {
+      PresetCatalog catalog(pool, dir.path);
+      catalog.Wait();
+      CHECK(catalog.Query("alpha").size() == 1);
+      CHECK(catalog.Query("beta_root/beta").size() == 1);
+      CHECK(catalog.Query("gamma").empty());
+      CHECK(fs::file_size(log) < full - 3);
+      catalog.Refresh(dir.path / "gamma.df");
+      catalog.Wait();
+      CHECK(catalog.Query("gamma").size() == 1);
+    }
+    PresetCatalog catalog(pool, dir.path);
+    catalog.Wait();
+    CHECK(catalog.Size() == 3);
+  }
+
+  // brace entries are found by what they expand to, as in the trigram index
+  void CatalogExpandsPatterns() {
+    TempDir dir("catalog_patterns");
+    WorkerPool pool;
+    PresetData data = Preset({"renders", "shot_{0001..0003}", "final"}, {0, 1, 2});
+    data.labels = {"backup"};
+    data.labelChecked.Reset(1, 3);
+    data.labelChecked.Set(1, 0, true);
+    CHECK(SavePreset(dir.path / "shots.df", data));
+    PresetCatalog catalog(pool, dir.path);
+    catalog.Refresh(dir.path / "shots.df");
+    catalog.Wait();
+    for (std::string query : {"shot_0001", "renders/shot_0002", "shot_0*", "shot_0003/final", "shot_0002@backup"}) {
+      CHECK(catalog.Query(query).size() == 1);
+    }
+    CHECK(catalog.Query("shot_0004").empty());
+    auto hits = catalog.Query("final");
+    CHECK(hits.size() == 1 && hits[0].entries == 7 && hits[0].maxDepth == 2);
+  }
+
+  /*
+   * Pattern
+   */
+
+  std::vector<std::string> Expand(const std::string &name) {
+    Pattern pattern(name);
+    std::vector<std::string> names;
+    for (size_t i = 0; i < pattern.Count(); i++) names.push_back(pattern.At(i));
+    return names;
+  }
+
+  void PatternsExpand() {
+    using Names = std::vector<std::string>;
+    CHECK(Expand("shot_{08..10}") == Names({"shot_08", "shot_09", "shot_10"}));
+    CHECK(Expand("{8..10}") == Names({"8", "9", "10"}));
+    CHECK(Expand("{-1..1}") == Names({"-1", "0", "1"}));
+    CHECK(Expand("{-05..5..5}") == Names({"-05", "000", "005"}));
+    CHECK(Expand("{1..9..4}") == Names({"1", "5", "9"}));
+    CHECK(Expand("{9..1..3}") == Names({"9", "6", "3"}));
+    CHECK(Expand("take_{a..e..2}") == Names({"take_a", "take_c", "take_e"}));
+    CHECK(Expand("{red,green}_{1..2}") == Names({"red_1", "red_2", "green_1", "green_2"}));
+
+    // escaped or malformed braces stay literal
+    CHECK(!Pattern("a\\{1..2\\}").IsPattern() && Expand("a\\{1..2\\}") == Names({"a{1..2}"}));
+    CHECK(Pattern::Escape("a{b}c") == "a\\{b\\}c" && Expand(Pattern::Escape("{1..2}")) == Names({"{1..2}"}));
+    for (auto name : {"{1..2", "{}", "{x}", "{1..x}"}) CHECK(!Pattern(name).IsPattern() && Expand(name) == Names({name}));
+
+    // counts saturate instead of wrapping
+    std::string huge = "{0..4000000000}";
+    CHECK(Pattern(huge + huge + huge).Count() == SIZE_MAX);
+    PresetData data = Preset({"r", "{1..3}", "x"}, {0, 1, 2});
+    CHECK(ExpandedCount(data.entries, data.depths) == 7);
+    data = Preset({huge, huge, huge}, {0, 1, 2});
+    size_t count = ExpandedCount(data.entries, data.depths);
+    CHECK(count == SIZE_MAX && count > kMaxExpanded && !ExpandedError(count).empty());
+  }
+
+  /*
+   * Reconciler
+   */
+
+  void ReconcilerFixesWhatDiffers() {
+    TempDir dir("reconcile");
+    fs::path root = dir.path / "root";
+    fs::create_directories(root / "a" / "b");
+    fs::create_directories(root / "old" / "empty");
+    fs::create_directories(root / "keep");
+    std::ofstream(root / "keep" / "notes.txt") << "notes";
+    std::ofstream(root / "a" / "file.txt") << "file";
+    PresetData data = Preset({"a", "b", "c", "d"}, {0, 1, 1, 0});
+    WorkerPool pool;
+    Reconciler reconciler(pool);
+
+    auto stats = reconciler.Run(data.entries, data.depths, root);
+    CHECK(stats.failed == 0 && stats.nodes == 4 && stats.present == 2 && stats.created == 2);
+    CHECK(fs::is_directory(root / "a" / "c") && fs::is_directory(root / "d") && stats.extras.empty());
+
+    // files are content, only directories count as extras
+    ReconcileOptions options;
+    options.extras = true;
+    stats = reconciler.Run(data.entries, data.depths, root, options);
+    CHECK(stats.present == 4 && stats.created == 0 && stats.pruned == 0);
+    CHECK(stats.extras == std::vector<std::string>({"keep", "old"}) && fs::exists(root / "old"));
+
+    // pruning leaves extras holding files
+    options.prune = true;
+    stats = reconciler.Run(data.entries, data.depths, root, options);
+    CHECK(stats.pruned == 1 && stats.extras.size() == 2);
+    CHECK(!fs::exists(root / "old") && fs::exists(root / "keep" / "notes.txt") && fs::exists(root / "a" / "file.txt"));
+    stats = reconciler.Run(data.entries, data.depths, root, options);
+    CHECK(stats.extras == std::vector<std::string>({"keep"}) && stats.pruned == 0);
+  }
+
+  /*
+   * LabelActions
+   */
+
+  void LabelActionsSeedEntries() {
+    TempDir dir("actions");
+    std::ofstream(dir.path / "readme.tmpl") << "hello";
+    std::ofstream(dir.path / "labels.actions") << "# per label\n"
+                                                  "docs copy readme.tmpl README\n"
+                                                  "keep touch .gitkeep\n"
+                                                  "locked mode 0750\n"
+                                                  "unused touch never\n";
+    LabelActions actions;
+    std::string error;
+    CHECK(actions.Read(dir.path / "labels.actions", error));
+
+    PresetData data = Preset({"proj", "a", "b"}, {0, 1, 1});
+    data.labels = {"locked", "keep", "docs"};
+    data.labelChecked.Reset(3, 3);
+    data.labelChecked.Set(0, 2, true);
+    data.labelChecked.Set(0, 0, true);
+    data.labelChecked.Set(1, 1, true);
+    data.labelChecked.Set(2, 2, true);
+    actions.Bind(data.labels, data.labelChecked);
+    CHECK(actions.Has(0) && actions.Has(1) && actions.Has(2));
+
+    fs::create_directories(dir.path / "root" / "proj" / "a");
+    fs::create_directories(dir.path / "root" / "proj" / "b");
+    // a file already there is left as it is
+    std::ofstream(dir.path / "root" / "proj" / "b" / "README") << "mine";
+    int rootFd = open((dir.path / "root").c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    CHECK(rootFd >= 0);
+    ActionStats stats;
+    int err = actions.Seed(0, rootFd, "proj", stats);
+    err = err ? err : actions.Seed(1, rootFd, "proj/a", stats);
+    err = err ? err : actions.Seed(2, rootFd, "proj/b", stats);
+    err = err ? err : actions.Seed(1, rootFd, "proj/a", stats);
+    err = err ? err : actions.Chmod(0, rootFd, "proj");
+    close(rootFd);
+    CHECK(err == 0 && stats.files == 2 && stats.existed == 2);
+    CHECK(Contents(dir.path / "root" / "proj" / "README") == "hello");
+    CHECK(Contents(dir.path / "root" / "proj" / "b" / "README") == "mine");
+    CHECK(fs::exists(dir.path / "root" / "proj" / "a" / ".gitkeep") && !fs::exists(dir.path / "root" / "proj" / "a" / "never"));
+    struct stat st {};
+    CHECK(stat((dir.path / "root" / "proj").c_str(), &st) == 0 && (st.st_mode & 07777) == 0750);
+    mode_t mode;
+    CHECK(actions.ModeOf(0, mode) && mode == 0750 && !actions.ModeOf(1, mode));
+
+    for (std::string line : {"x copy missing.tmpl", "x mode 9", "x mode", "x touch a/b", "x move y"}) {
+      std::ofstream(dir.path / "bad.actions") << line << "\n";
+      LabelActions bad;
+      CHECK(!bad.Read(dir.path / "bad.actions", error) && !error.empty());
+    }
+  }
+
+  /*
+   * BinaryPreset
+   */
+
+  void WriteAt(const fs::path &file, size_t at, const void *bytes, size_t size) {
+    std::fstream f(file, std::ios::binary | std::ios::in | std::ios::out);
+    f.seekp(at);
+    f.write(static_cast<const char *>(bytes), size);
+  }
+
+  void SidecarsFollowTheirSource() {
+    TempDir dir("sidecar");
+    fs::path df = dir.path / "p.df";
+    PresetData data = Preset({"alpha", "beta", "gamma"}, {0, 1, 1});
+    data.labels = {"x", "y"};
+    data.labelChecked.Reset(2, 3);
+    data.labelChecked.Set(1, 0, true);
+    data.labelChecked.Set(2, 1, true);
+    CHECK(SavePreset(df, data));
+    auto binary = BinaryPreset::For(df);
+    CHECK(binary && binary->Size() == 3 && binary->Labels() == data.labels);
+    PresetData read;
+    binary->Read(read);
+    CHECK(read.entries == data.entries && read.depths == data.depths);
+    for (size_t row = 0; row < 3; row++) {
+      for (size_t l = 0; l < 2; l++) CHECK(read.labelChecked.Get(row, l) == data.labelChecked.Get(row, l));
+    }
+
+    // rewritten in place to the same size, and the mtime put back
+    struct stat before {};
+    CHECK(stat(df.c_str(), &before) == 0);
+    std::string text = Contents(df);
+    auto at = text.find("alpha");
+    CHECK(at != std::string::npos);
+    text[at] = 'A';
+    usleep(20000);
+    std::ofstream(df, std::ios::binary) << text;
+    struct timespec times[2] = {before.st_atim, before.st_mtim};
+    CHECK(utimensat(AT_FDCWD, df.c_str(), times, 0) == 0);
+    CHECK(fs::file_size(df) == size_t(before.st_size) && !BinaryPreset::For(df));
+    CHECK(LoadPreset(df, read) && read.entries[0] == "Alpha");
+
+    // damaged sidecars are refused, not read
+    fs::path dfb = BinaryPreset::SidecarPath(df);
+    CHECK(SavePreset(df, data) && BinaryPreset::For(df));
+    std::string good = Contents(dfb);
+    BinaryPreset open;
+    // count sits after magic, version and label count
+    uint64_t huge = UINT64_MAX;
+    WriteAt(dfb, 16, &huge, sizeof(huge));
+    CHECK(!open.Open(dfb));
+    // label names after the count and the four source fields, an offset that wraps when the size is added
+    std::ofstream(dfb, std::ios::binary) << good;
+    uint64_t wrap[2] = {UINT64_MAX - 1, 4};
+    WriteAt(dfb, 56, wrap, sizeof(wrap));
+    CHECK(!open.Open(dfb));
+    std::ofstream(dfb, std::ios::binary) << good.substr(0, good.size() / 2);
+    CHECK(!open.Open(dfb) && !BinaryPreset::For(df));
+    std::ofstream(dfb, std::ios::binary) << good;
+    CHECK(open.Open(dfb) && open.Size() == 3);
+  }
+
+  /*
+   * FuzzyFilter
+   */
+
+  // view rows as name:m for matches, name:a for ancestors
+  std::vector<std::string> View(const DirTree &tree, const FuzzyFilter &filter) {
+    std::vector<std::string> view;
+    for (size_t i = 0; i < filter.Size(); i++) {
+      view.push_back(std::string(tree.Name(tree.At(filter.Row(i)))) + (filter.Matched(i) ? ":m" : ":a"));
+    }
+    return view;
+  }
+
+  void FilterShowsMatchesInPlace() {
+    using Names = std::vector<std::string>;
+    DirTree tree;
+    tree.Assign(Preset({"src", "main", "deep", "target", "docs", "Makefile", "test", "mock"}, {0, 1, 1, 2, 0, 0, 0, 1}));
+    FuzzyFilter filter;
+    filter.Build(tree);
+    filter.SetQuery(L"ma");
+    CHECK(View(tree, filter) == Names({"src:a", "main:m", "Makefile:m"}) && filter.Matches() == 2);
+    CHECK(filter.Best() != FuzzyFilter::npos && filter.Matched(filter.Best()));
+    filter.SetQuery(L"MaK");
+    CHECK(View(tree, filter) == Names({"Makefile:m"}) && filter.Best() == 0);
+    // backspace goes back to the matches before
+    filter.SetQuery(L"ma");
+    CHECK(View(tree, filter) == Names({"src:a", "main:m", "Makefile:m"}));
+    filter.SetQuery(L"trgt");
+    CHECK(View(tree, filter) == Names({"src:a", "deep:a", "target:m"}));
+    filter.SetQuery(L"zz");
+    CHECK(filter.Size() == 0 && filter.Best() == FuzzyFilter::npos);
+    filter.Clear();
+    CHECK(!filter.Active());
+    CHECK(FuzzyFilter::Positions(L"Makefile", L"mf") == std::vector<size_t>({0, 4}));
+  }
+
+  // enough rows for the wide bloom compare, against a plain subsequence test
+  void FilterMatchesSubsequences() {
+    std::mt19937 rng(7);
+    std::vector<std::string> names;
+    std::vector<short> depths;
+    for (int i = 0; i < 1000; i++) {
+      std::string name;
+      for (int c = 1 + rng() % 10; c > 0; c--) name.push_back("abcdeFGH_1"[rng() % 10]);
+      names.push_back(name);
+      depths.push_back(i == 0 ? 0 : std::min<short>(depths.back() + 1, rng() % 4));
+    }
+    DirTree tree;
+    tree.Assign(Preset(names, depths));
+    FuzzyFilter filter;
+    filter.Build(tree);
+    std::wstring query;
+    for (wchar_t c : std::wstring(L"agh1")) {
+      query.push_back(c);
+      filter.SetQuery(query);
+      std::vector<size_t> expected, got;
+      for (size_t row = 0; row < names.size(); row++) {
+        size_t k = 0;
+        for (char n : names[row]) {
+          if (k < query.size() && std::tolower(n) == query[k]) k++;
+        }
+        if (k == query.size()) expected.push_back(row);
+      }
+      for (size_t i = 0; i < filter.Size(); i++) {
+        if (filter.Matched(i)) got.push_back(filter.Row(i));
+        // every row in the view is a match or leads to one
+        if (i > 0) CHECK(filter.Depth(i) <= filter.Depth(i - 1) + 1 && filter.Row(i) > filter.Row(i - 1));
+      }
+      CHECK(!expected.empty() && got == expected && filter.Matches() == expected.size());
+    }
+  }
+
+  /*
+   * Includes
+   */
+
+  void GraphFollowsIncludes() {
+    TempDir dir("graph");
+    CHECK(SavePreset(dir.path / "common.df", Preset({"src", "lib"}, {0, 0})));
+    CHECK(SavePreset(dir.path / "a.df", Preset({"project", "@include common.df"}, {0, 1})));
+    PresetGraph graph;
+    std::string error;
+    std::vector<PresetGraph::Stamp> files;
+    auto data = graph.Resolve(dir.path / "a.df", error, &files);
+    CHECK(data && data->entries.size() == 3 && data->entries[2] == "lib" && data->depths[2] == 1);
+    CHECK(files.size() == 2 && graph.Cached() == 2);
+    CHECK(graph.Resolve(dir.path / "a.df", error) == data);
+
+    // a changed include resolves its includers again
+    CHECK(SavePreset(dir.path / "common.df", Preset({"src", "lib", "docs"}, {0, 0, 0})));
+    CHECK(!PresetGraph::Fresh(files));
+    auto changed = graph.Resolve(dir.path / "a.df", error);
+    CHECK(changed && changed != data && changed->entries.size() == 4 && changed->entries[3] == "docs");
+
+    CHECK(SavePreset(dir.path / "x.df", Preset({"@include y.df"}, {0})));
+    CHECK(SavePreset(dir.path / "y.df", Preset({"@include x.df"}, {0})));
+    CHECK(!graph.Resolve(dir.path / "x.df", error) && error.find("include cycle") == 0);
+  }
+
+  void CatalogFollowsIncludes() {
+    TempDir dir("catalog_includes");
+    WorkerPool pool;
+    CHECK(SavePreset(dir.path / "common.df", Preset({"src", "lib"}, {0, 0})));
+    CHECK(SavePreset(dir.path / "a.df", Preset({"project", "@include common.df"}, {0, 1})));
+    CHECK(SavePreset(dir.path / "b.df", Preset({"docs", "@include later.df"}, {0, 1})));
+    {
+      PresetCatalog catalog(pool, dir.path);
+      for (auto name : {"common.df", "a.df", "b.df"}) catalog.Refresh(dir.path / name);
+      catalog.Wait();
+      auto hits = catalog.Query("project/lib");
+      CHECK(hits.size() == 1 && hits[0].path.filename() == "a.df" && hits[0].entries == 3);
+      CHECK(catalog.Query("src").size() == 2);
+
+      // only the included presets are refreshed, their includers follow
+      CHECK(SavePreset(dir.path / "common.df", Preset({"src", "lib", "tools"}, {0, 0, 0})));
+      CHECK(SavePreset(dir.path / "later.df", Preset({"notes"}, {0})));
+      catalog.Refresh(dir.path / "common.df");
+      catalog.Refresh(dir.path / "later.df");
+      catalog.Wait();
+      CHECK(catalog.Query("project/tools").size() == 1);
+      CHECK(catalog.Query("docs/notes").size() == 1);
+    }
+    PresetCatalog reloaded(pool, dir.path);
+    reloaded.Wait();
+    CHECK(reloaded.Query("project/tools").size() == 1 && reloaded.Query("docs/notes").size() == 1);
+  }
+
+  /*
+   * ArchiveExporter
+   */
+
+  unsigned long long Octal(const char *field, size_t size) {
+    unsigned long long value = 0;
+    for (size_t i = 0; i < size && field[i] >= '0' && field[i] <= '7'; i++) value = value * 8 + (field[i] - '0');
+    return value;
+  }
+
+  // every header sums right, and names too long for ustar come back whole through prefix or pax
+  void TarHeadersCheckOut() {
+    TempDir dir("tar");
+    std::string mid(60, 'm'), wide(120, 'w');
+    PresetData data = Preset({"top", "short", mid, mid + "2", mid + "3", wide, "leaf"}, {0, 1, 1, 2, 3, 1, 2});
+    fs::path archive = dir.path / "out.tar";
+    ArchiveExporter exporter(ArchiveExporter::TAR);
+    auto stats = exporter.Run(data.entries, data.depths, archive);
+    CHECK(stats.failed == 0);
+
+    std::set<std::string> expected;
+    std::vector<std::string> stack;
+    for (size_t i = 0; i < data.entries.size(); i++) {
+      stack.resize(data.depths[i]);
+      std::string path;
+      for (auto &s : stack) path += s + "/";
+      path += std::string(data.entries[i]);
+      stack.push_back(std::string(data.entries[i]));
+      expected.insert(path + "/");
+    }
+
+    std::ifstream in(archive, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    CHECK(bytes.size() % 512 == 0);
+    std::set<std::string> paths;
+    std::string paxPath;
+    bool prefixed = false, paxed = false;
+    for (size_t at = 0; at + 512 <= bytes.size(); at += 512) {
+      const char *block = bytes.data() + at;
+      if (std::all_of(block, block + 512, [](char c) { return c == 0; })) break;
+      unsigned sum = 0;
+      for (size_t i = 0; i < 512; i++) sum += i >= 148 && i < 156 ? ' ' : (unsigned char) block[i];
+      CHECK(Octal(block + 148, 8) == sum);
+      CHECK(std::memcmp(block + 257, "ustar", 6) == 0);
+      size_t size = Octal(block + 124, 12);
+      if (block[156] == 'x') {
+        // "len path=value\n" records
+        std::string records(block + 512, size);
+        size_t key = records.find(" path=");
+        CHECK(key != std::string::npos);
+        paxPath = records.substr(key + 6, records.find('\n', key) - key - 6);
+        paxed = true;
+        at += (size + 511) / 512 * 512;
+        continue;
+      }
+      CHECK(block[156] == '5');
+      std::string name(block, strnlen(block, 100)), prefix(block + 345, strnlen(block + 345, 155));
+      std::string path = prefix.empty() ? name : prefix + "/" + name;
+      if (!prefix.empty()) prefixed = true;
+      if (!paxPath.empty()) path = paxPath;
+      paxPath.clear();
+      paths.insert(path);
+      at += (size + 511) / 512 * 512;
+    }
+    CHECK(prefixed && paxed);
+    CHECK(paths == expected);
+  }
+
+  /*
+   * stringtoolbox
+   */
+
+  // lengths around the 16 and 32 byte blocks of the scanners, delimiters at the ends and doubled
+  void SplitViewMatchesSplit() {
+    namespace str = stringtoolbox;
+    std::mt19937 rng(5);
+    std::vector<std::string> inputs{"", ",", ",,", "a", "a,", ",a", "a,,b", std::string(40, ',')};
+    for (int i = 0; i < 500; i++) {
+      std::string s(rng() % 80, 'x');
+      for (auto &c : s) c = "ab,"[rng() % 3];
+      inputs.push_back(s);
+    }
+    for (auto &input : inputs) {
+      std::vector<std::string> viewed;
+      for (auto field : str::splitView(input, ',')) viewed.emplace_back(field);
+      CHECK(viewed == str::split(input, ','));
+      CHECK(str::countChar(input, ',') == size_t(std::count(input.begin(), input.end(), ',')));
+      for (size_t from = 0; from <= input.size(); from += 7) {
+        auto tail = std::string_view(input).substr(from);
+        CHECK(str::findChar(tail, ',') == tail.find(','));
+      }
+    }
+  }
+
+  struct Test {
+    const char *name;
+    std::function<void()> run;
+  };
+}// namespace
+
+int main(int argc, const char *argv[]) {
+  std::vector<Test> tests{
+          {"treap_matches_vectors", TreapMatchesVectors},
+          {"snapshots_keep_their_rows", SnapshotsKeepTheirRows},
+          {"labels_match_vectors", LabelsMatchVectors},
+          {"index_round_trips", IndexRoundTrips},
+          {"regex_escapes_keep_candidates", RegexEscapesKeepCandidates},
+          {"damaged_indexes_are_refused", DamagedIndexesAreRefused},
+          {"catalog_loads_past_torn_tail", CatalogLoadsPastTornTail},
+          {"catalog_expands_patterns", CatalogExpandsPatterns},
+          {"patterns_expand", PatternsExpand},
+          {"reconciler_fixes_what_differs", ReconcilerFixesWhatDiffers},
+          {"label_actions_seed_entries", LabelActionsSeedEntries},
+          {"sidecars_follow_their_source", SidecarsFollowTheirSource},
+          {"filter_shows_matches_in_place", FilterShowsMatchesInPlace},
+          {"filter_matches_subsequences", FilterMatchesSubsequences},
+          {"graph_follows_includes", GraphFollowsIncludes},
+          {"catalog_follows_includes", CatalogFollowsIncludes},
+          {"tar_headers_check_out", TarHeadersCheckOut},
+          {"split_view_matches_split", SplitViewMatchesSplit},
+  };
+  // names given run only those
+  int run = 0;
+  for (auto &test : tests) {
+    bool wanted = argc < 2;
+    for (int i = 1; i < argc; i++) wanted = wanted || test.name == std::string(argv[i]);
+    if (!wanted) continue;
+    int before = failures;
+    test.run();
+    std::cout << (failures == before ? "ok   " : "FAIL ") << test.name << std::endl;
+    run++;
+  }
+  if (run == 0) {
+    std::cerr << "no such test" << std::endl;
+    return 2;
+  }
+  return failures == 0 ? 0 : 1;
+}